@@ -0,0 +1,76 @@
+#pragma once
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Module: PROFILE (host build)
+Register access profiler on top of the peripheral models: counts, per bracketed API call, the register reads, writes,
+read-modify-write sequences and polling iterations, plus the simulated cycles, and reports them as CSV or JSON
+
+Classification (per register, by aligned word address):
+read-modify-write - a write to the register read by the previous access (REG |= x), or a single instruction read and write
+poll - a read of the register read by the previous access, with no write in between (each extra iteration of while (!(REG & FLAG)))
+
+NOTE: Brackets may be nested (e.g. a whole workload around the calls it makes), every open call counts the access (inclusive figures)
+but not the profiler's own bookkeeping for the inner brackets (which is stepped, and would grow with the number of functions, when instruction stepping)
+Only bracketed calls are recorded: functions called from inside the library (spiTransmitFrame inside eepromWrite) are part of their caller
+NOTE: Accesses made by interrupt handlers during a call are counted for that call
+NOTE: The profiler owns the simulator access hook (simAccessHook) while initialised, call profileInit after simInit/simReset (which remove the hook)
+
+*/
+
+/* INCLUDES */
+
+#ifndef STM32F0_SIM_H
+#include "STM32F0_SIM.h"
+#define STM32F0_SIM_H
+#endif
+
+#ifndef STDIO_H
+#include <stdio.h>
+#define STDIO_H
+#endif
+
+/* CONSTANT DEFINITIONS */
+
+#define PROFILE_MAX_FUNCTIONS 128 // Distinct function names recorded
+#define PROFILE_MAX_DEPTH 8 // Nesting depth of profiled calls
+
+#define PROFILE_FORMAT_CSV 0 // One line per function: function,calls,reads,writes,rmw,polls,cycles
+#define PROFILE_FORMAT_JSON 1 // {"functions": [{"function": ..., "calls": ..., ...}, ...]}
+
+#define PROFILE_CALL(name, call) do { profileBegin(name); call; profileEnd(); } while (0) // Profiles one call, e.g. PROFILE_CALL("analogRead", value = analogRead(POT0))
+
+typedef struct {
+	// A type definition for the profile counters
+	uint64_t reads; // Register reads
+	uint64_t writes; // Register writes
+	uint64_t rmw; // Read-modify-write sequences
+	uint64_t polls; // Polling iterations (repeated reads of a register)
+	uint64_t cycles; // Simulated core cycles
+} ProfileCounters_TypeDef;
+
+typedef struct {
+	// A type definition for the results of one function
+	const char* name; // Function name
+	uint32_t calls; // Number of profiled calls
+	ProfileCounters_TypeDef total; // Counters summed over all calls
+} ProfileFunction_TypeDef;
+
+/* FUNCTIONS */
+
+void profileInit(); // Installs the register access hook and clears the results
+void profileStop(); // Removes the register access hook (results are kept)
+
+void profileBegin(const char* name); // Starts counting a call (name must stay valid, functions are reported in first call order)
+void profileEnd(); // Ends the innermost call and adds its counts to its function
+
+uint8_t profileFunctionCount(); // Returns the number of functions recorded
+const ProfileFunction_TypeDef* profileFunction(uint8_t index); // Returns the results of a function by index
+const ProfileFunction_TypeDef* profileFind(const char* name); // Returns the results of a function by name (0 if never called)
+
+void profileReport(FILE* file, uint8_t format); // Writes the results of every function (PROFILE_FORMAT_CSV/JSON)
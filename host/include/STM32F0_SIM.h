@@ -0,0 +1,124 @@
+#pragma once
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Module: SIM (host build)
+Host-side peripheral models, so the unmodified library sources run on a Linux x86-64 host
+
+The peripheral address ranges of the STM32F051 (APB, AHB, GPIO and the NVIC) are mapped into host memory at their real addresses,
+so GPIOx, DMA1_Channelx, SPIx, I2Cx, TIMx, ADC1, DAC, RCC, EXTI, SYSCFG and NVIC resolve exactly as they do on the target
+The pages are kept inaccessible: every register access traps, is single-stepped, and is handed to the behavioural model of the peripheral
+(FIFO levels, RXNE/TXE/STOPF/EOC flags, CNDTR countdown, timer updates, triggers, DMA requests and interrupts)
+
+Time is counted in core clock cycles (48 MHz), and only advances on register accesses (estimated bus cycles), simAdvance(), and,
+while instruction stepping is on, once per executed host instruction
+Interrupts are taken after a register access (or a stepped instruction) once their NVIC line is enabled and the source is pending
+
+NOTE: Build with -no-pie (see host/Makefile): the library casts pointers to uint32_t for DMA addresses, so buffers handed to the DMA
+must be static (below 4 GB), not on the stack
+NOTE: Device callbacks run inside the access trap, they must not access peripheral registers themselves
+
+*/
+
+/* INCLUDES */
+
+#ifndef STM32F0XX_H
+#include "stm32f0xx.h"
+#define STM32F0XX_H
+#endif
+
+#ifndef STDINT_H
+#include <stdint.h>
+#define STDINT_H
+#endif
+
+#ifndef STM32F0_INTERRUPTS_H
+#include "STM32F0_INTERRUPTS.h"
+#define STM32F0_INTERRUPTS_H
+#endif
+
+/* CONSTANT DEFINITIONS */
+
+#define SIM_CORE_CLOCK 48000000 // Simulated core/peripheral clock (Hz)
+
+// Estimated cost of a register access in core cycles (Cortex-M0 load/store plus bus wait states)
+#define SIM_AHB_ACCESS_CYCLES 2 // DMA, RCC, FLASH, CRC, GPIO and the NVIC
+#define SIM_APB_ACCESS_CYCLES 4 // Everything on the APB (through the AHB-APB bridge)
+#define SIM_CPU_CYCLES_PER_ACCESS 3 // Estimated instructions between register accesses when not instruction stepping (loop/branch overhead)
+#define SIM_IRQ_ENTRY_CYCLES 16 // Cortex-M0 exception entry
+#define SIM_IRQ_EXIT_CYCLES 12 // Cortex-M0 exception return
+#define SIM_DMA_TRANSFER_CYCLES 5 // DMA single transfer (arbitration, read, write)
+
+#define SIM_ACCESS_READ 0x1 // The access reads the register
+#define SIM_ACCESS_WRITE 0x2 // The access writes the register (both bits: single instruction read-modify-write)
+
+#define SIM_GPIO_RELEASE -1 // simGpioInput level that stops driving a pin (it floats to its pull-up/pull-down)
+
+typedef struct {
+	// A type definition for the simulator counters (since simInit/simReset)
+	uint64_t cycles; // Simulated core cycles
+	uint64_t reads; // CPU register reads
+	uint64_t writes; // CPU register writes
+	uint64_t instructions; // Host instructions executed while instruction stepping
+	uint64_t interrupts; // Interrupt handlers entered
+	uint64_t dmaTransfers; // DMA data items moved
+} SimStats_TypeDef;
+
+typedef void (*SimAccessHook_TypeDef)(uint32_t address, uint8_t size, uint8_t access); // Called on every CPU register access (SIM_ACCESS_*), before a read is served
+typedef uint16_t (*SimSPIDevice_TypeDef)(SPI_TypeDef* spi, uint16_t mosi, uint8_t bits); // Exchanges one SPI frame (MOSI in, MISO returned)
+typedef void (*SimDACListener_TypeDef)(uint8_t channel, uint16_t value, uint64_t cycle); // Called when a DAC output register changes
+
+typedef struct {
+	// A type definition for a simulated I2C slave (all callbacks optional, a missing device NACKs its address)
+	int (*start)(I2C_TypeDef* i2c, uint8_t address, int read); // (Repeated) start with a 7 bit address, returns whether the address is ACKed
+	int (*write)(I2C_TypeDef* i2c, uint8_t data); // Byte written by the master, returns whether it is ACKed
+	uint8_t (*read)(I2C_TypeDef* i2c); // Byte read by the master
+	void (*stop)(I2C_TypeDef* i2c); // Stop condition
+} SimI2CDevice_TypeDef;
+
+/* FUNCTIONS */
+
+void simInit(); // Maps the peripheral address ranges, installs the access traps and resets every model (call once before using the library)
+void simReset(); // Resets every register, model, device binding and counter to its power-on state
+
+void simAdvance(uint32_t cycles); // Lets simulated time pass (peripherals run and pending interrupts are taken)
+uint64_t simCycles(); // Returns the simulated core cycles since simInit/simReset
+SimStats_TypeDef simStats(); // Returns the simulator counters
+
+void simInstructionStepping(int enable); // Counts (and charges one cycle for) every host instruction by single-stepping, for cycle estimates of code that busy-waits without touching registers (interrupt handlers included, simAdvance itself excluded)
+void simAccessHook(SimAccessHook_TypeDef hook); // Installs a hook called on every CPU register access (0 to remove)
+
+void simGpioInput(GPIO_TypeDef* port, uint8_t pin, int level); // Drives an input pin high (1)/low (0) from outside, or releases it (SIM_GPIO_RELEASE), edges reach the EXTI
+uint16_t simGpioOutput(GPIO_TypeDef* port); // Returns the output data register of a port
+void simAdcInput(uint8_t channel, uint16_t value); // Sets the 12 bit value an ADC channel converts to (channel 16 temperature, 17 VREFINT and 18 VBAT have defaults)
+void simSPIDevice(SPI_TypeDef* spi, SimSPIDevice_TypeDef device); // Attaches a device to an SPI bus (no device: MISO reads 0xFF/0xFFFF)
+void simI2CDevice(I2C_TypeDef* i2c, SimI2CDevice_TypeDef* device); // Attaches a slave to an I2C bus
+void simDACListener(SimDACListener_TypeDef listener); // Installs a listener for DAC output changes (0 to remove)
+uint16_t simDACOutput(uint8_t channel); // Returns the DAC output register of a channel (1 or 2)
+uint32_t simUnhandledInterrupts(); // Returns the enabled interrupt lines that fired without a handler linked in (bit per IRQn)
+
+// UCT development board devices (see STM32F0_SIM_BOARD.c)
+void simBoardDevices(); // Attaches the SPI EEPROM (SPI2, chip select PB12) and the TC74 temperature sensor (I2C2, 25 degrees), call again after simReset
+uint8_t* simBoardEEPROM(); // Returns the EEPROM memory (EEPROM_MEM_SIZE bytes, blank is 0xFF)
+void simBoardTemperature(int8_t temperature); // Sets the temperature the TC74 reports (degrees)
+
+// Internal, shared by the simulator core and the peripheral models
+void* __simRegister(uint32_t address); // Returns the backing store of a peripheral register (accessing it does not trap)
+int __simMapped(uint32_t address); // Returns whether an address is inside a simulated peripheral range
+void __simElapse(uint32_t cycles); // Advances simulated time and runs the models (no interrupt delivery)
+void __simCountDmaTransfer(); // Counts a data item moved by a DMA channel
+
+void __simModelReset(); // Loads the power-on register values and resets the model state
+void __simModelRead(uint32_t address, uint8_t size); // Updates a register before the CPU (or the DMA) reads it
+void __simModelWrite(uint32_t address, uint8_t size, uint32_t previous); // Applies the side effects of a write (previous - the aligned word before the write)
+void __simModelAdvance(uint32_t cycles); // Runs the peripherals for a number of core cycles
+uint32_t __simModelInterrupts(); // Returns the interrupt lines currently requested by the peripherals (bit per IRQn)
+void __simModelDevices(); // Removes every device/listener binding
+
+int __simIrqEntry(); // Takes pending interrupts (called from the interrupt trampoline), returns whether instruction stepping must resume
+void __simIrqTrampoline(); // Saves the interrupted context, calls __simIrqEntry and resumes (see STM32F0_SIM_IRQ.S)
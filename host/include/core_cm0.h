@@ -0,0 +1,73 @@
+#pragma once
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Module: SIM (host build)
+Host stand-in for the CMSIS Cortex-M0 core header, only what stm32f0xx.h and the library need
+The peripheral structs are not redefined, stm32f0xx.h maps them to their real addresses which the simulator backs with RAM (see STM32F0_SIM.h)
+
+*/
+
+/* INCLUDES */
+
+#ifndef STDINT_H
+#include <stdint.h>
+#define STDINT_H
+#endif
+
+/* CONSTANT DEFINITIONS */
+
+#define __I volatile const // Read only register
+#define __O volatile // Write only register
+#define __IO volatile // Read/write register
+
+#define __INLINE inline
+#define __STATIC_INLINE static inline
+
+/* FUNCTIONS */
+
+void __simSetPrimask(uint32_t primask); // Masks (1) or unmasks (0) simulated interrupt delivery
+uint32_t __simGetPrimask(); // Returns the simulated PRIMASK
+
+static inline void __enable_irq() {
+	// Enables interrupts (clears PRIMASK)
+	__simSetPrimask(0);
+}
+
+static inline void __disable_irq() {
+	// Disables interrupts (sets PRIMASK)
+	__simSetPrimask(1);
+}
+
+static inline uint32_t __get_PRIMASK() {
+	// Returns the PRIMASK
+	return __simGetPrimask();
+}
+
+static inline void __set_PRIMASK(uint32_t priMask) {
+	// Sets the PRIMASK
+	__simSetPrimask(priMask & 1);
+}
+
+static inline void __NOP() {
+	// No operation
+}
+
+static inline void __WFI() {
+	// Wait for interrupt (returns immediately on the host)
+}
+
+static inline void __DSB() {
+	// Data synchronisation barrier
+	__sync_synchronize();
+}
+
+static inline void __ISB() {
+	// Instruction synchronisation barrier
+	__sync_synchronize();
+}
@@ -0,0 +1,29 @@
+#pragma once
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Module: SIM (host build)
+Host stand-in for the CMSIS system header (the simulated core always runs at 48 MHz)
+
+*/
+
+/* INCLUDES */
+
+#ifndef STDINT_H
+#include <stdint.h>
+#define STDINT_H
+#endif
+
+/* GLOBAL VARIABLES */
+
+extern uint32_t SystemCoreClock; // System clock frequency (core clock) in Hz
+
+/* FUNCTIONS */
+
+void SystemInit(); // Sets up the system clock (nothing to do on the host)
+void SystemCoreClockUpdate(); // Updates SystemCoreClock (fixed on the host)
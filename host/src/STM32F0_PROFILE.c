@@ -0,0 +1,185 @@
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Module: PROFILE (host build)
+
+*/
+
+/* INCLUDES */
+
+#ifndef STM32F0_PROFILE_H
+#include "STM32F0_PROFILE.h"
+#define STM32F0_PROFILE_H
+#endif
+
+#include <string.h>
+
+/* CONSTANT DEFINITIONS */
+
+typedef struct {
+	// A type definition for an open profiled call
+	uint8_t function; // Index of the function
+	ProfileCounters_TypeDef start; // Counters when the call started
+} ProfileFrame_TypeDef;
+
+/* GLOBAL VARIABLES */
+
+static ProfileFunction_TypeDef profileFunctions[PROFILE_MAX_FUNCTIONS];
+static uint8_t profileFunctionsUsed = 0;
+static ProfileFrame_TypeDef profileStack[PROFILE_MAX_DEPTH];
+static uint8_t profileDepth = 0;
+
+static ProfileCounters_TypeDef profileCounters; // Running totals (cycles are taken from the simulator when needed)
+static uint32_t profileLastAddress = 0; // Register of the previous access
+static uint8_t profileLastAccess = 0; // Direction of the previous access (0 if none)
+
+/* FUNCTIONS */
+
+static void __profileAccess(uint32_t address, uint8_t size, uint8_t access) {
+	// Simulator access hook: counts and classifies a register access
+	address &= ~0x3; // Byte/halfword accesses belong to the register word
+	uint8_t sameRegister = (profileLastAccess == SIM_ACCESS_READ) && (profileLastAddress == address);
+	if (access == (SIM_ACCESS_READ | SIM_ACCESS_WRITE)) {
+		profileCounters.reads++; // Single instruction read-modify-write
+		profileCounters.writes++;
+		profileCounters.rmw++;
+	}
+	else if (access & SIM_ACCESS_READ) {
+		profileCounters.reads++;
+		if (sameRegister) {
+			profileCounters.polls++; // Read again without anything in between
+		}
+	}
+	else {
+		profileCounters.writes++;
+		if (sameRegister) {
+			profileCounters.rmw++; // Written back after being read
+		}
+	}
+	profileLastAddress = address;
+	profileLastAccess = access;
+}
+
+static ProfileCounters_TypeDef __profileNow() {
+	// Returns the running totals with the current cycle count
+	ProfileCounters_TypeDef now = profileCounters;
+	now.cycles = simCycles();
+	return now;
+}
+
+static void __profileExclude(uint64_t cycles) {
+	// Leaves cycles spent in the profiler out of every open call (while instruction stepping its own instructions are counted too)
+	for (uint8_t i = 0; i < profileDepth; i++) {
+		profileStack[i].start.cycles += cycles;
+	}
+}
+
+void profileInit() {
+	// Installs the register access hook and clears the results
+	memset(profileFunctions, 0, sizeof(profileFunctions));
+	memset(&profileCounters, 0, sizeof(profileCounters));
+	profileFunctionsUsed = 0;
+	profileDepth = 0;
+	profileLastAccess = 0;
+	simAccessHook(__profileAccess);
+}
+
+void profileStop() {
+	// Removes the register access hook
+	simAccessHook(0);
+}
+
+void profileBegin(const char* name) {
+	// Starts counting a call
+	uint64_t entry = simCycles();
+	if (profileDepth >= PROFILE_MAX_DEPTH) {
+		fprintf(stderr, "profile: calls nested deeper than %d at %s\n", PROFILE_MAX_DEPTH, name);
+		return;
+	}
+	uint8_t function;
+	for (function = 0; function < profileFunctionsUsed; function++) {
+		if (strcmp(profileFunctions[function].name, name) == 0) {
+			break;
+		}
+	}
+	if (function == profileFunctionsUsed) {
+		if (profileFunctionsUsed >= PROFILE_MAX_FUNCTIONS) {
+			fprintf(stderr, "profile: more than %d functions, %s is not recorded\n", PROFILE_MAX_FUNCTIONS, name);
+			return;
+		}
+		profileFunctions[profileFunctionsUsed++].name = name;
+	}
+	profileStack[profileDepth].function = function;
+	profileLastAccess = 0; // Accesses before the call do not make the first ones polls or read-modify-writes
+	__profileExclude(simCycles() - entry); // The name lookup is not part of the enclosing calls
+	profileStack[profileDepth++].start = __profileNow(); // Last, so the profiler itself is not counted
+}
+
+void profileEnd() {
+	// Ends the innermost call and adds its counts to its function
+	ProfileCounters_TypeDef end = __profileNow(); // First, so the profiler itself is not counted
+	if (profileDepth == 0) {
+		return; // No call open
+	}
+	ProfileFrame_TypeDef* frame = &profileStack[--profileDepth];
+	ProfileFunction_TypeDef* function = &profileFunctions[frame->function];
+	function->calls++;
+	function->total.reads += end.reads - frame->start.reads;
+	function->total.writes += end.writes - frame->start.writes;
+	function->total.rmw += end.rmw - frame->start.rmw;
+	function->total.polls += end.polls - frame->start.polls;
+	function->total.cycles += end.cycles - frame->start.cycles;
+	profileLastAccess = 0;
+	__profileExclude(simCycles() - end.cycles); // Nor is the bookkeeping above
+}
+
+uint8_t profileFunctionCount() {
+	// Returns the number of functions recorded
+	return profileFunctionsUsed;
+}
+
+const ProfileFunction_TypeDef* profileFunction(uint8_t index) {
+	// Returns the results of a function by index
+	return (index < profileFunctionsUsed) ? &profileFunctions[index] : 0;
+}
+
+const ProfileFunction_TypeDef* profileFind(const char* name) {
+	// Returns the results of a function by name
+	for (uint8_t i = 0; i < profileFunctionsUsed; i++) {
+		if (strcmp(profileFunctions[i].name, name) == 0) {
+			return &profileFunctions[i];
+		}
+	}
+	return 0;
+}
+
+void profileReport(FILE* file, uint8_t format) {
+	// Writes the results of every function
+	if (format == PROFILE_FORMAT_JSON) {
+		fprintf(file, "{\n\t\"functions\": [");
+	}
+	else {
+		fprintf(file, "function,calls,reads,writes,rmw,polls,cycles\n");
+	}
+	for (uint8_t i = 0; i < profileFunctionsUsed; i++) {
+		const ProfileFunction_TypeDef* function = &profileFunctions[i];
+		if (format == PROFILE_FORMAT_JSON) {
+			fprintf(file, "%s\n\t\t{\"function\": \"%s\", \"calls\": %u, \"reads\": %llu, \"writes\": %llu, \"rmw\": %llu, \"polls\": %llu, \"cycles\": %llu}",
+				(i ? "," : ""), function->name, function->calls, (unsigned long long)function->total.reads, (unsigned long long)function->total.writes,
+				(unsigned long long)function->total.rmw, (unsigned long long)function->total.polls, (unsigned long long)function->total.cycles);
+		}
+		else {
+			fprintf(file, "%s,%u,%llu,%llu,%llu,%llu,%llu\n", function->name, function->calls, (unsigned long long)function->total.reads,
+				(unsigned long long)function->total.writes, (unsigned long long)function->total.rmw, (unsigned long long)function->total.polls,
+				(unsigned long long)function->total.cycles);
+		}
+	}
+	if (format == PROFILE_FORMAT_JSON) {
+		fprintf(file, "\n\t]\n}\n");
+	}
+}
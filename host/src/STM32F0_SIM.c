@@ -0,0 +1,563 @@
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Module: SIM (host build)
+Simulator core: peripheral address ranges, access traps, simulated time and interrupt delivery
+
+Every peripheral range is a shared memory object mapped twice: at the real address with no access rights (what the library sees),
+and at a host chosen address with full rights (what the models use)
+An access to the real address raises SIGSEGV: the instruction is decoded for its size and direction, the model updates the register
+for a read, the page is opened and the trap flag set. After the single instruction SIGTRAP closes the page again, the model applies
+the side effects of a write, time advances, and a pending interrupt is delivered by redirecting the interrupted context to
+__simIrqTrampoline (STM32F0_SIM_IRQ.S)
+
+*/
+
+/* INCLUDES */
+
+#define _GNU_SOURCE
+
+#ifndef STM32F0_SIM_H
+#include "STM32F0_SIM.h"
+#define STM32F0_SIM_H
+#endif
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+/* CONSTANT DEFINITIONS */
+
+#define SIM_PAGE_SIZE 0x1000
+#define SIM_TRAP_FLAG 0x100 // x86 EFLAGS.TF
+#define SIM_PAGEFAULT_WRITE 0x2 // Page fault error code: the faulting access was a write
+#define SIM_SIGNAL_STACK_SIZE 0x10000
+#define SIM_ADVANCE_STEP 16 // Largest time step of simAdvance between interrupt checks (cycles)
+#define SIM_IRQ_STORM 100000 // Consecutive handler entries without the source clearing before the run is aborted
+
+typedef struct {
+	// A type definition for a simulated peripheral address range
+	uint32_t base; // Real (target) address
+	uint32_t size; // Size in bytes (whole pages)
+	uint8_t accessCycles; // Estimated cycles per access
+	uint8_t* store; // Host mapping with full access rights
+} SimRegion_TypeDef;
+
+/* GLOBAL VARIABLES */
+
+uint32_t SystemCoreClock = SIM_CORE_CLOCK; // System clock frequency (core clock) in Hz
+
+static SimRegion_TypeDef simRegions[] = {
+	{APBPERIPH_BASE, 0x16000, SIM_APB_ACCESS_CYCLES, 0}, // TIM2 - DBGMCU
+	{AHBPERIPH_BASE, 0x5000, SIM_AHB_ACCESS_CYCLES, 0}, // DMA1/DMA2, RCC, FLASH, CRC, TSC
+	{AHB2PERIPH_BASE, 0x2000, SIM_AHB_ACCESS_CYCLES, 0}, // GPIOA - GPIOF (rounded up to whole pages)
+	{0xE000E000, 0x1000, SIM_AHB_ACCESS_CYCLES, 0}, // System control space (NVIC)
+};
+#define SIM_REGION_COUNT (sizeof(simRegions) / sizeof(simRegions[0]))
+
+static struct {
+	uint8_t active; // An access is being single-stepped
+	uint8_t size; // Access size in bytes
+	uint8_t access; // SIM_ACCESS_* flags
+	uint32_t address; // Accessed address
+	uint32_t previous; // Aligned word before the access
+	SimRegion_TypeDef* region; // Region of the access
+} simAccess;
+
+static int simInitialised = 0;
+static volatile int simStepping = 0; // Instruction stepping enabled
+static volatile int simStepPaused = 0; // Stepped instructions are not counted (simulated time passing in simAdvance: the models' host instructions are not the program's)
+static volatile int simInIrq = 0; // An interrupt handler is running (no nesting)
+static volatile uint32_t simPrimask = 0; // Simulated PRIMASK
+static uint32_t simUnhandled = 0; // Lines that fired without a handler
+static SimStats_TypeDef simCounters;
+static SimAccessHook_TypeDef simHook = 0;
+static uint8_t simSignalStack[SIM_SIGNAL_STACK_SIZE];
+
+// Interrupt handlers of the STM32F051 vector table, weak so only the ones linked in are called
+#define SIM_WEAK_HANDLER(name) extern void name() __attribute__((weak));
+SIM_WEAK_HANDLER(WWDG_IRQHandler)
+SIM_WEAK_HANDLER(PVD_IRQHandler)
+SIM_WEAK_HANDLER(RTC_IRQHandler)
+SIM_WEAK_HANDLER(FLASH_IRQHandler)
+SIM_WEAK_HANDLER(RCC_IRQHandler)
+SIM_WEAK_HANDLER(EXTI0_1_IRQHandler)
+SIM_WEAK_HANDLER(EXTI2_3_IRQHandler)
+SIM_WEAK_HANDLER(EXTI4_15_IRQHandler)
+SIM_WEAK_HANDLER(TS_IRQHandler)
+SIM_WEAK_HANDLER(DMA1_Channel1_IRQHandler)
+SIM_WEAK_HANDLER(DMA1_Channel2_3_IRQHandler)
+SIM_WEAK_HANDLER(DMA1_Channel4_5_IRQHandler)
+SIM_WEAK_HANDLER(ADC1_COMP_IRQHandler)
+SIM_WEAK_HANDLER(TIM1_BRK_UP_TRG_COM_IRQHandler)
+SIM_WEAK_HANDLER(TIM1_CC_IRQHandler)
+SIM_WEAK_HANDLER(TIM2_IRQHandler)
+SIM_WEAK_HANDLER(TIM3_IRQHandler)
+SIM_WEAK_HANDLER(TIM6_DAC_IRQHandler)
+SIM_WEAK_HANDLER(TIM14_IRQHandler)
+SIM_WEAK_HANDLER(TIM15_IRQHandler)
+SIM_WEAK_HANDLER(TIM16_IRQHandler)
+SIM_WEAK_HANDLER(TIM17_IRQHandler)
+SIM_WEAK_HANDLER(I2C1_IRQHandler)
+SIM_WEAK_HANDLER(I2C2_IRQHandler)
+SIM_WEAK_HANDLER(SPI1_IRQHandler)
+SIM_WEAK_HANDLER(SPI2_IRQHandler)
+SIM_WEAK_HANDLER(USART1_IRQHandler)
+SIM_WEAK_HANDLER(USART2_IRQHandler)
+SIM_WEAK_HANDLER(CEC_IRQHandler)
+
+static void (*const simVectors[32])() = {
+	WWDG_IRQHandler, PVD_IRQHandler, RTC_IRQHandler, FLASH_IRQHandler, // 0-3
+	RCC_IRQHandler, EXTI0_1_IRQHandler, EXTI2_3_IRQHandler, EXTI4_15_IRQHandler, // 4-7
+	TS_IRQHandler, DMA1_Channel1_IRQHandler, DMA1_Channel2_3_IRQHandler, DMA1_Channel4_5_IRQHandler, // 8-11
+	ADC1_COMP_IRQHandler, TIM1_BRK_UP_TRG_COM_IRQHandler, TIM1_CC_IRQHandler, TIM2_IRQHandler, // 12-15
+	TIM3_IRQHandler, TIM6_DAC_IRQHandler, 0, TIM14_IRQHandler, // 16-19
+	TIM15_IRQHandler, TIM16_IRQHandler, TIM17_IRQHandler, I2C1_IRQHandler, // 20-23
+	I2C2_IRQHandler, SPI1_IRQHandler, SPI2_IRQHandler, USART1_IRQHandler, // 24-27
+	USART2_IRQHandler, 0, CEC_IRQHandler, 0 // 28-31
+};
+
+/* FUNCTIONS */
+
+static SimRegion_TypeDef* __simRegion(uint64_t address) {
+	// Returns the simulated range containing an address (0 if none)
+	for (unsigned int i = 0; i < SIM_REGION_COUNT; i++) {
+		if ((address >= simRegions[i].base) && (address < ((uint64_t)simRegions[i].base + simRegions[i].size))) {
+			return &simRegions[i];
+		}
+	}
+	return 0;
+}
+
+void* __simRegister(uint32_t address) {
+	// Returns the backing store of a peripheral register (accessing it does not trap)
+	SimRegion_TypeDef* region = __simRegion(address);
+	if (region == 0) {
+		return 0;
+	}
+	return region->store + (address - region->base);
+}
+
+int __simMapped(uint32_t address) {
+	// Returns whether an address is inside a simulated peripheral range
+	return (__simRegion(address) != 0);
+}
+
+static void __simDecode(const uint8_t* code, uint8_t* size, uint8_t* access) {
+	// Decodes the memory operand size and direction of the x86-64 instruction that trapped
+	// Covers what compilers emit for volatile accesses (mov/movzx/movsx loads and stores, ALU/test/cmp with a memory operand)
+	uint8_t operandSize = 4;
+	for (;;) {
+		uint8_t prefix = *code;
+		if (prefix == 0x66) {
+			operandSize = 2; // Operand size override
+		}
+		else if ((prefix & 0xF0) == 0x40) {
+			if (prefix & 0x08) {
+				operandSize = 8; // REX.W
+			}
+		}
+		else if ((prefix != 0x67) && (prefix != 0xF0) && (prefix != 0xF2) && (prefix != 0xF3) && (prefix != 0x2E) && (prefix != 0x36) && (prefix != 0x3E) && (prefix != 0x26) && (prefix != 0x64) && (prefix != 0x65)) {
+			break; // Not a prefix
+		}
+		code++;
+	}
+
+	uint8_t opcode = code[0];
+	uint8_t reg = (code[1] >> 3) & 0x7; // ModRM reg field (opcode extension of the group instructions)
+	*size = operandSize;
+	*access = SIM_ACCESS_READ;
+	if (opcode == 0x0F) {
+		switch (code[1]) {
+			case 0xB6: case 0xBE: // movzx/movsx r, r/m8
+				*size = 1;
+				break;
+			case 0xB7: case 0xBF: // movzx/movsx r, r/m16
+				*size = 2;
+				break;
+			case 0x11: case 0x29: case 0x7F: case 0xE7: // SSE stores
+				*size = 16;
+				*access = SIM_ACCESS_WRITE;
+				break;
+			case 0xD6: // movq store
+				*size = 8;
+				*access = SIM_ACCESS_WRITE;
+				break;
+			case 0x10: case 0x28: case 0x6F: // SSE loads
+				*size = 16;
+				break;
+			case 0x7E: // movd/movq load
+				break;
+		}
+		return;
+	}
+	switch (opcode) {
+		case 0x88: case 0xC6: // mov r/m8, r8 / imm8
+			*size = 1;
+			*access = SIM_ACCESS_WRITE;
+			break;
+		case 0x89: case 0xC7: // mov r/m, r / imm
+			*access = SIM_ACCESS_WRITE;
+			break;
+		case 0xA2: case 0xAA: // mov moffs8, al / stosb
+			*size = 1;
+			*access = SIM_ACCESS_WRITE;
+			break;
+		case 0xA3: case 0xAB: // mov moffs, eax / stos
+			*access = SIM_ACCESS_WRITE;
+			break;
+		case 0x8A: case 0xA0: case 0x84: // 8 bit loads/test
+			*size = 1;
+			break;
+		case 0x63: // movsxd
+			*size = 4;
+			break;
+		case 0x80: case 0xC0: case 0xD0: case 0xD2: // 8 bit group 1/group 2 (ALU/shift with immediate)
+			*size = 1;
+			*access = ((opcode == 0x80) && (reg == 7)) ? SIM_ACCESS_READ : (SIM_ACCESS_READ | SIM_ACCESS_WRITE); // cmp only reads
+			break;
+		case 0x81: case 0x83: case 0xC1: case 0xD1: case 0xD3:
+			*access = (((opcode == 0x81) || (opcode == 0x83)) && (reg == 7)) ? SIM_ACCESS_READ : (SIM_ACCESS_READ | SIM_ACCESS_WRITE);
+			break;
+		case 0xF6: case 0xF7: // group 3: test/mul/div read, not/neg read-modify-write
+			if (opcode == 0xF6) {
+				*size = 1;
+			}
+			if ((reg == 2) || (reg == 3)) {
+				*access = SIM_ACCESS_READ | SIM_ACCESS_WRITE;
+			}
+			break;
+		case 0xFE: case 0xFF: // group 4/5: inc/dec read-modify-write
+			if (opcode == 0xFE) {
+				*size = 1;
+			}
+			if (reg <= 1) {
+				*access = SIM_ACCESS_READ | SIM_ACCESS_WRITE;
+			}
+			break;
+		case 0x86: case 0x87: // xchg
+			if (opcode == 0x86) {
+				*size = 1;
+			}
+			*access = SIM_ACCESS_READ | SIM_ACCESS_WRITE;
+			break;
+		default:
+			if ((opcode < 0x40) && ((opcode & 0x7) < 4)) {
+				// ALU operations (add/or/adc/sbb/and/sub/xor/cmp)
+				if (!(opcode & 0x1)) {
+					*size = 1;
+				}
+				if (((opcode & 0x7) < 2) && ((opcode & 0x38) != 0x38)) {
+					*access = SIM_ACCESS_READ | SIM_ACCESS_WRITE; // Memory destination (cmp only reads)
+				}
+			}
+			break;
+	}
+}
+
+static uint32_t __simWord(SimRegion_TypeDef* region, uint32_t address) {
+	// Returns the aligned word containing an address from the backing store
+	return *((uint32_t*)(region->store + ((address & ~0x3) - region->base)));
+}
+
+void __simElapse(uint32_t cycles) {
+	// Advances simulated time and runs the models (no interrupt delivery)
+	simCounters.cycles += cycles;
+	__simModelAdvance(cycles);
+}
+
+void __simCountDmaTransfer() {
+	// Counts a data item moved by a DMA channel
+	simCounters.dmaTransfers++;
+}
+
+static int __simNextIrq() {
+	// Returns the highest priority pending and enabled interrupt line (-1 if none)
+	NVIC_TypeDef* nvic = (NVIC_TypeDef*)__simRegister((uint32_t)NVIC);
+	uint32_t pending = (__simModelInterrupts() | nvic->ISPR[0]) & nvic->ISER[0];
+	int next = -1;
+	uint32_t nextPriority = 0x100;
+	for (int irqn = 0; irqn < 32; irqn++) {
+		if (pending & (1u << irqn)) {
+			uint32_t priority = (nvic->IP[irqn / 4] >> ((irqn % 4) * 8)) & 0xFF;
+			if (priority < nextPriority) {
+				next = irqn; // Lowest priority value wins, ties go to the lowest IRQn
+				nextPriority = priority;
+			}
+		}
+	}
+	return next;
+}
+
+static void __simStepTrapFlag() {
+	// Sets the trap flag if stepped instructions are being counted (the trap handler keeps it set from then on)
+	if (simStepping && !simStepPaused) {
+		__asm__ volatile ("pushfq\n\torq $0x100, (%%rsp)\n\tpopfq" ::: "memory", "cc"); // Traps after the next instruction
+	}
+}
+
+static void __simIrqDispatch() {
+	// Runs the handlers of every pending interrupt until none is left (they are level sensitive, like the NVIC inputs)
+	// Handlers are part of the program: while stepping, their instructions are counted, the dispatching around them is not
+	int paused = simStepPaused;
+	int previous = -1;
+	uint32_t repeats = 0;
+	simInIrq = 1;
+	int irqn;
+	while ((simPrimask == 0) && ((irqn = __simNextIrq()) >= 0)) {
+		NVIC_TypeDef* nvic = (NVIC_TypeDef*)__simRegister((uint32_t)NVIC);
+		nvic->ISPR[0] &= ~(1u << irqn); // Entering the handler clears the pending bit
+		nvic->ICPR[0] = nvic->ISPR[0];
+		repeats = (irqn == previous) ? (repeats + 1) : 0;
+		previous = irqn;
+		if (repeats >= SIM_IRQ_STORM) {
+			fprintf(stderr, "sim: interrupt %d keeps firing, its handler never clears the source\n", irqn);
+			abort();
+		}
+		__simElapse(SIM_IRQ_ENTRY_CYCLES);
+		simCounters.interrupts++;
+		if (simVectors[irqn]) {
+			simStepPaused = 0;
+			__simStepTrapFlag();
+			simVectors[irqn]();
+			simStepPaused = 1; // The next trap clears the trap flag
+		}
+		else {
+			// Default handler: on the target this hangs, here the line is reported and disabled
+			simUnhandled |= (1u << irqn);
+			nvic->ISER[0] &= ~(1u << irqn);
+			nvic->ICER[0] = nvic->ISER[0];
+		}
+		__simElapse(SIM_IRQ_EXIT_CYCLES);
+	}
+	simInIrq = 0;
+	simStepPaused = paused;
+}
+
+static int __simIrqReady() {
+	// Returns whether an interrupt can be taken now
+	return (!simInIrq) && (simPrimask == 0) && (__simNextIrq() >= 0);
+}
+
+int __simIrqEntry() {
+	// Takes pending interrupts (called from the interrupt trampoline), returns whether instruction stepping must resume
+	__simIrqDispatch();
+	return (simStepping && !simStepPaused);
+}
+
+static void __simDeliver(ucontext_t* context) {
+	// Redirects the interrupted context to the interrupt trampoline
+	greg_t* registers = context->uc_mcontext.gregs;
+	uint64_t stack = (uint64_t)registers[REG_RSP] - 128 - 8; // Keep the red zone of the interrupted function
+	*((uint64_t*)stack) = (uint64_t)registers[REG_RIP]; // Return address for the trampoline (ret $128 restores the stack pointer)
+	registers[REG_RSP] = (greg_t)stack;
+	registers[REG_RIP] = (greg_t)__simIrqTrampoline;
+	registers[REG_EFL] &= ~SIM_TRAP_FLAG; // The trampoline restores stepping when it returns
+}
+
+static void __simSegvHandler(int signal, siginfo_t* info, void* ucontext) {
+	// Access to a peripheral page: decode the access, serve a read, and single-step the instruction with the page opened
+	ucontext_t* context = (ucontext_t*)ucontext;
+	uint64_t address = (uint64_t)info->si_addr;
+	SimRegion_TypeDef* region = __simRegion(address);
+	if ((region == 0) || simAccess.active) {
+		fprintf(stderr, "sim: invalid memory access at 0x%lx (rip 0x%lx)\n", (unsigned long)address, (unsigned long)context->uc_mcontext.gregs[REG_RIP]);
+		abort();
+	}
+
+	uint8_t size;
+	uint8_t access;
+	__simDecode((const uint8_t*)context->uc_mcontext.gregs[REG_RIP], &size, &access);
+	if (context->uc_mcontext.gregs[REG_ERR] & SIM_PAGEFAULT_WRITE) {
+		access |= SIM_ACCESS_WRITE;
+	}
+
+	if (simHook) {
+		simHook((uint32_t)address, size, access);
+	}
+	if (access & SIM_ACCESS_READ) {
+		simCounters.reads++;
+		__simModelRead((uint32_t)address, size);
+	}
+	if (access & SIM_ACCESS_WRITE) {
+		simCounters.writes++;
+	}
+
+	simAccess.active = 1;
+	simAccess.size = size;
+	simAccess.access = access;
+	simAccess.address = (uint32_t)address;
+	simAccess.previous = __simWord(region, (uint32_t)address);
+	simAccess.region = region;
+	mprotect((void*)(address & ~(uint64_t)(SIM_PAGE_SIZE - 1)), SIM_PAGE_SIZE, PROT_READ | PROT_WRITE);
+	context->uc_mcontext.gregs[REG_EFL] |= SIM_TRAP_FLAG;
+}
+
+static void __simTrapHandler(int signal, siginfo_t* info, void* ucontext) {
+	// After a single-stepped instruction: close the page, apply the write, advance time, and take interrupts
+	ucontext_t* context = (ucontext_t*)ucontext;
+	uint32_t cycles;
+	if (simAccess.active) {
+		simAccess.active = 0;
+		mprotect((void*)((uint64_t)simAccess.address & ~(uint64_t)(SIM_PAGE_SIZE - 1)), SIM_PAGE_SIZE, PROT_NONE);
+		if (simAccess.access & SIM_ACCESS_WRITE) {
+			__simModelWrite(simAccess.address, simAccess.size, simAccess.previous);
+		}
+		cycles = simAccess.region->accessCycles;
+		if (!simStepping || simStepPaused) {
+			cycles += SIM_CPU_CYCLES_PER_ACCESS;
+		}
+	}
+	else {
+		cycles = (simStepping && !simStepPaused) ? 1 : 0; // Stepped instruction without a register access (the last trap after stepping stops is free)
+	}
+	if (simStepping && !simStepPaused) {
+		simCounters.instructions++;
+		context->uc_mcontext.gregs[REG_EFL] |= SIM_TRAP_FLAG;
+	}
+	else {
+		context->uc_mcontext.gregs[REG_EFL] &= ~SIM_TRAP_FLAG;
+	}
+	__simElapse(cycles);
+	if (__simIrqReady()) {
+		__simDeliver(context);
+	}
+}
+
+void simInit() {
+	// Maps the peripheral address ranges, installs the access traps and resets every model
+	if (simInitialised) {
+		simReset();
+		return;
+	}
+
+	uint32_t total = 0;
+	for (unsigned int i = 0; i < SIM_REGION_COUNT; i++) {
+		total += simRegions[i].size;
+	}
+	int fd = memfd_create("stm32f0-sim", 0);
+	if ((fd < 0) || (ftruncate(fd, total) != 0)) {
+		perror("sim: memfd_create");
+		exit(1);
+	}
+	uint32_t offset = 0;
+	for (unsigned int i = 0; i < SIM_REGION_COUNT; i++) {
+		void* target = mmap((void*)(uint64_t)simRegions[i].base, simRegions[i].size, PROT_NONE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, offset);
+		void* store = mmap(0, simRegions[i].size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+		if ((target != (void*)(uint64_t)simRegions[i].base) || (store == MAP_FAILED)) {
+			fprintf(stderr, "sim: can not map the peripheral range at 0x%08x (is the program linked with -no-pie?)\n", simRegions[i].base);
+			exit(1);
+		}
+		simRegions[i].store = (uint8_t*)store;
+		offset += simRegions[i].size;
+	}
+
+	// The handlers run on their own stack, so the interrupt trampoline can safely push onto the interrupted one
+	stack_t signalStack;
+	signalStack.ss_sp = simSignalStack;
+	signalStack.ss_size = sizeof(simSignalStack);
+	signalStack.ss_flags = 0;
+	sigaltstack(&signalStack, 0);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+	sigemptyset(&action.sa_mask);
+	sigaddset(&action.sa_mask, SIGSEGV);
+	sigaddset(&action.sa_mask, SIGTRAP);
+	action.sa_sigaction = __simSegvHandler;
+	sigaction(SIGSEGV, &action, 0);
+	action.sa_sigaction = __simTrapHandler;
+	sigaction(SIGTRAP, &action, 0);
+
+	simInitialised = 1;
+	simReset();
+}
+
+void simReset() {
+	// Resets every register, model, device binding and counter to its power-on state
+	for (unsigned int i = 0; i < SIM_REGION_COUNT; i++) {
+		memset(simRegions[i].store, 0, simRegions[i].size);
+	}
+	__simModelDevices();
+	__simModelReset();
+	memset(&simCounters, 0, sizeof(simCounters));
+	simHook = 0;
+	simPrimask = 0;
+	simUnhandled = 0;
+}
+
+void simAdvance(uint32_t cycles) {
+	// Lets simulated time pass (peripherals run and pending interrupts are taken)
+	int paused = simStepPaused;
+	simStepPaused = 1; // The time passing is simulated, only interrupt handlers run as part of the program
+	while (cycles) {
+		uint32_t step = (cycles > SIM_ADVANCE_STEP) ? SIM_ADVANCE_STEP : cycles;
+		__simElapse(step);
+		cycles -= step;
+		if (__simIrqReady()) {
+			__simIrqDispatch();
+		}
+	}
+	simStepPaused = paused;
+	__simStepTrapFlag();
+}
+
+uint64_t simCycles() {
+	// Returns the simulated core cycles since simInit/simReset
+	return simCounters.cycles;
+}
+
+SimStats_TypeDef simStats() {
+	// Returns the simulator counters
+	return simCounters;
+}
+
+void simInstructionStepping(int enable) {
+	// Counts (and charges one cycle for) every host instruction by single-stepping
+	simStepping = !!enable;
+	__simStepTrapFlag();
+	// Stepping stops at the next trap once the flag is cleared
+}
+
+void simAccessHook(SimAccessHook_TypeDef hook) {
+	// Installs a hook called on every CPU register access
+	simHook = hook;
+}
+
+uint32_t simUnhandledInterrupts() {
+	// Returns the enabled interrupt lines that fired without a handler linked in
+	return simUnhandled;
+}
+
+void __simSetPrimask(uint32_t primask) {
+	// Masks (1) or unmasks (0) simulated interrupt delivery
+	simPrimask = primask;
+	if ((primask == 0) && __simIrqReady()) {
+		__simIrqDispatch(); // Pending interrupts are taken as soon as they are unmasked
+		__simStepTrapFlag(); // Keep stepping the program after the handlers
+	}
+}
+
+uint32_t __simGetPrimask() {
+	// Returns the simulated PRIMASK
+	return simPrimask;
+}
+
+void SystemInit() {
+	// Sets up the system clock (nothing to do on the host)
+}
+
+void SystemCoreClockUpdate() {
+	// Updates SystemCoreClock (fixed on the host)
+	SystemCoreClock = SIM_CORE_CLOCK;
+}
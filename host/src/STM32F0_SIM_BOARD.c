@@ -0,0 +1,136 @@
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Module: SIM (host build)
+Devices of the UCT development board: the SPI EEPROM on SPI2 (chip select PB12) and the TC74 temperature sensor on I2C2
+
+The device callbacks only see SPI frames, not chip select edges, so an EEPROM instruction ends after its length in frames
+(1 for WREN/WRDI, 2 for RDSR/WRSR, 4 for single byte READ/WRITE as used by eepromRead/eepromWrite)
+
+*/
+
+/* INCLUDES */
+
+#ifndef STM32F0_SIM_H
+#include "STM32F0_SIM.h"
+#define STM32F0_SIM_H
+#endif
+
+#ifndef STM32F0_UCTDEV_H
+#include "STM32F0_UCTDEV.h"
+#define STM32F0_UCTDEV_H
+#endif
+
+#include <string.h>
+
+/* GLOBAL VARIABLES */
+
+static uint8_t simEepromMemory[EEPROM_MEM_SIZE];
+static uint8_t simEepromStatus = 0; // Status register (WEL)
+static uint8_t simEepromCommand = 0; // Instruction being received
+static uint8_t simEepromPhase = 0; // Frames of the instruction received so far
+static uint16_t simEepromAddress = 0;
+
+static int8_t simTemperature = 25; // TC74 temperature register (degrees)
+static uint8_t simTemperatureRegister = 0; // TC74 register pointer (0: temperature, 1: configuration)
+
+/* FUNCTIONS */
+
+static uint16_t __simEepromFrame(SPI_TypeDef* spi, uint16_t mosi, uint8_t bits) {
+	// Exchanges one frame with the EEPROM
+	if (simGpioOutput(GPIOB) & (1 << 12)) {
+		return 0xFF; // Not selected
+	}
+	uint16_t miso = 0xFF;
+	uint8_t length = 4; // Frames in the current instruction
+	if (simEepromPhase == 0) {
+		simEepromCommand = (uint8_t)mosi;
+	}
+	switch (simEepromCommand) {
+	case EEPROM_WREN:
+		simEepromStatus |= EEPROM_SR_WEL;
+		length = 1;
+		break;
+	case EEPROM_WRDI:
+		simEepromStatus &= ~EEPROM_SR_WEL;
+		length = 1;
+		break;
+	case EEPROM_RDSR:
+		miso = simEepromStatus;
+		length = 2;
+		break;
+	case EEPROM_WRSR:
+		length = 2;
+		break;
+	case EEPROM_READ:
+	case EEPROM_WRITE:
+		if (simEepromPhase == 1) {
+			simEepromAddress = (mosi << 8);
+		}
+		else if (simEepromPhase == 2) {
+			simEepromAddress |= (mosi & 0xFF);
+		}
+		else if (simEepromPhase == 3) {
+			if (simEepromCommand == EEPROM_READ) {
+				miso = simEepromMemory[simEepromAddress % EEPROM_MEM_SIZE];
+			}
+			else if (simEepromStatus & EEPROM_SR_WEL) {
+				simEepromMemory[simEepromAddress % EEPROM_MEM_SIZE] = (uint8_t)mosi;
+				simEepromStatus &= ~EEPROM_SR_WEL; // The latch resets after a write
+			}
+		}
+		break;
+	default:
+		length = 1; // Unknown instruction, ignored
+		break;
+	}
+	simEepromPhase++;
+	if (simEepromPhase >= length) {
+		simEepromPhase = 0; // Instruction complete
+	}
+	return miso;
+}
+
+static int __simTemperatureStart(I2C_TypeDef* i2c, uint8_t address, int read) {
+	// TC74 address match
+	return address == TS_READ_ADDRESS;
+}
+
+static int __simTemperatureWrite(I2C_TypeDef* i2c, uint8_t data) {
+	// TC74 register pointer
+	simTemperatureRegister = data;
+	return 1;
+}
+
+static uint8_t __simTemperatureRead(I2C_TypeDef* i2c) {
+	// TC74 temperature (or configuration) register
+	return (simTemperatureRegister == 0) ? (uint8_t)simTemperature : 0x00;
+}
+
+static SimI2CDevice_TypeDef simTemperatureSensor = {__simTemperatureStart, __simTemperatureWrite, __simTemperatureRead, 0};
+
+void simBoardDevices() {
+	// Attaches the devices of the UCT development board (blank EEPROM, 25 degrees)
+	memset(simEepromMemory, 0xFF, sizeof(simEepromMemory));
+	simEepromStatus = 0;
+	simEepromPhase = 0;
+	simTemperature = 25;
+	simTemperatureRegister = 0;
+	simSPIDevice(SPI2, __simEepromFrame);
+	simI2CDevice(I2C2, &simTemperatureSensor);
+}
+
+uint8_t* simBoardEEPROM() {
+	// Returns the EEPROM memory
+	return simEepromMemory;
+}
+
+void simBoardTemperature(int8_t temperature) {
+	// Sets the temperature the TC74 reports
+	simTemperature = temperature;
+}
@@ -0,0 +1,1419 @@
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Module: SIM (host build)
+Behavioural peripheral models of the STM32F051 (register semantics as in RM0091)
+
+Modelled: RCC ready flags, GPIO (BSRR/BRR, IDR from outputs/pulls/driven inputs), EXTI/SYSCFG edge detection, NVIC enable/pending,
+DMA1 channels 1-5 (CNDTR countdown, circular mode, HT/TC/TE flags, peripheral requests and memory-to-memory), timers (prescaler/auto-reload
+shadows, update events, one-pulse, TRGO, update DMA requests), ADC (calibration, ready, sequences, EOC/EOSEQ/OVR, triggers, DMA),
+DAC (data holding formats, triggers, DMA requests and underrun), SPI (4 byte FIFOs, FRLVL/FTLVL/RXNE/TXE/BSY, frame timing, DMA)
+and I2C master transfers (START/address/NBYTES/AUTOEND/RELOAD, TXIS/TXE/RXNE/TC/NACKF/STOPF)
+Not modelled: USART, RTC, watchdogs, comparators, timer capture/compare outputs and the DAC noise/triangle generator (absent on the STM32F051)
+
+*/
+
+/* INCLUDES */
+
+#ifndef STM32F0_SIM_H
+#include "STM32F0_SIM.h"
+#define STM32F0_SIM_H
+#endif
+
+#include <string.h>
+
+/* CONSTANT DEFINITIONS */
+
+#define SIM_REG(periph) ((__typeof__(periph))__simRegister((uint32_t)(uintptr_t)(periph))) // Backing store view of a peripheral
+#define SIM_IN(address, base) (((uint32_t)(address) - (uint32_t)(base)) < 0x400) // Address inside a 1 KB peripheral block
+
+#define SIM_GPIO_PORTS 6
+#define SIM_DMA_CHANNELS 5 // DMA1 channels on the STM32F051
+#define SIM_ADC_CHANNELS 19
+#define SIM_ADC_CALIBRATION_CYCLES 285 // 83 ADC clocks at 14 MHz
+#define SIM_I2C_HSI_SCALE 6 // I2C1 runs from HSI (8 MHz), I2C2 from PCLK (48 MHz)
+
+#define SIM_TRIGGER_NONE -1
+
+// DMA request lines (channel numbers) of the STM32F051
+#define SIM_DMA_ADC 1 // Channel 2 with SYSCFG_CFGR1_ADC_DMA_RMP
+#define SIM_DMA_DAC1 3 // Shared with TIM6_UP
+#define SIM_DMA_DAC2 4
+
+typedef struct {
+	// A type definition for the state of a timer model
+	uint32_t base; // Timer base address
+	uint8_t irqn; // Update interrupt line
+	int8_t dacTrigger; // DAC TSEL value of its TRGO (SIM_TRIGGER_NONE if not connected)
+	int8_t adcTrigger; // ADC EXTSEL value of its TRGO (SIM_TRIGGER_NONE if not connected)
+	uint8_t wide; // 32 bit counter
+	uint32_t prescaler; // Active (shadow) prescaler
+	uint32_t reload; // Active (shadow) auto-reload value
+	uint32_t prescaleCount; // Core cycles counted towards the next timer tick
+	uint16_t repetition; // Repetition down counter
+} SimTimer_TypeDef;
+
+typedef struct {
+	// A type definition for the state of a DMA channel model
+	uint32_t count; // Number of data latched when the channel was enabled
+	uint32_t peripheral; // Current peripheral address
+	uint32_t memory; // Current memory address
+	uint32_t budget; // Memory-to-memory cycles not yet spent
+	uint8_t pending; // A request arrived that could not be served
+} SimDMAChannel_TypeDef;
+
+typedef struct {
+	// A type definition for the state of an SPI model
+	uint8_t tx[4]; // TX FIFO
+	uint8_t txCount;
+	uint8_t rx[4]; // RX FIFO
+	uint8_t rxCount;
+	uint8_t shifting; // A frame is on the wire
+	uint8_t servicing; // DMA requests are being served (no recursion)
+	uint16_t frame; // Frame being shifted out
+	uint32_t remaining; // Cycles until the frame is done
+	SimSPIDevice_TypeDef device;
+} SimSPI_TypeDef;
+
+enum {
+	SIM_I2C_IDLE,
+	SIM_I2C_ADDRESS, // Start condition and address on the wire
+	SIM_I2C_TX_WAIT, // Waiting for TXDR (clock stretched)
+	SIM_I2C_TX, // Byte on the wire
+	SIM_I2C_RX, // Byte on the wire
+	SIM_I2C_HOLD, // Transfer complete (TC/TCR), waiting for START/STOP
+	SIM_I2C_STOP // Stop condition on the wire
+};
+
+typedef struct {
+	// A type definition for the state of an I2C model
+	uint8_t state;
+	uint8_t address; // 7 bit slave address
+	uint8_t read; // Transfer direction
+	uint8_t count; // Bytes left to start
+	uint8_t shift; // Byte in the shift register
+	uint32_t remaining; // Cycles until the current wire phase is done
+	SimI2CDevice_TypeDef* device;
+} SimI2C_TypeDef;
+
+/* GLOBAL VARIABLES */
+
+static SimTimer_TypeDef simTimers[] = {
+	{TIM1_BASE, TIM1_BRK_UP_TRG_COM_IRQn, SIM_TRIGGER_NONE, 0, 0},
+	{TIM2_BASE, TIM2_IRQn, 4, 2, 1},
+	{TIM3_BASE, TIM3_IRQn, 1, 3, 0},
+	{TIM6_BASE, TIM6_DAC_IRQn, 0, SIM_TRIGGER_NONE, 0},
+	{TIM7_BASE, 18, 2, SIM_TRIGGER_NONE, 0},
+	{TIM14_BASE, TIM14_IRQn, SIM_TRIGGER_NONE, SIM_TRIGGER_NONE, 0},
+	{TIM15_BASE, TIM15_IRQn, 3, 4, 0},
+	{TIM16_BASE, TIM16_IRQn, SIM_TRIGGER_NONE, SIM_TRIGGER_NONE, 0},
+	{TIM17_BASE, TIM17_IRQn, SIM_TRIGGER_NONE, SIM_TRIGGER_NONE, 0},
+};
+#define SIM_TIMER_COUNT (sizeof(simTimers) / sizeof(simTimers[0]))
+
+static uint16_t simGpioLevels[SIM_GPIO_PORTS]; // Levels driven from outside
+static uint16_t simGpioDriven[SIM_GPIO_PORTS]; // Pins driven from outside
+static SimDMAChannel_TypeDef simDma[SIM_DMA_CHANNELS + 1]; // Indexed by channel number
+static SimSPI_TypeDef simSpi[2];
+static SimI2C_TypeDef simI2c[2];
+static struct {
+	uint16_t inputs[SIM_ADC_CHANNELS]; // 12 bit value each channel converts to
+	uint8_t sequence[SIM_ADC_CHANNELS]; // Channels of the running sequence
+	uint8_t length;
+	uint8_t index;
+	uint8_t converting;
+	uint32_t remaining; // Cycles until the conversion is done
+	uint32_t calibration; // Cycles until the calibration is done
+} simAdc;
+static struct {
+	uint16_t dhr[2]; // Data holding registers (12 bit right aligned)
+	SimDACListener_TypeDef listener;
+} simDac;
+
+/* FUNCTIONS */
+
+static uint32_t* __simWord(uint32_t address) {
+	// Returns the aligned backing store word containing an address
+	return (uint32_t*)__simRegister(address & ~0x3);
+}
+
+static void __simRestore(uint32_t address, uint32_t previous) {
+	// Undoes a write to a read only register
+	*__simWord(address) = previous;
+}
+
+static uint32_t __simFifoLevel(uint8_t count) {
+	// Returns the SPI FRLVL/FTLVL encoding of a FIFO fill level (bytes)
+	if (count == 0) {
+		return 0; // Empty
+	}
+	else if (count == 1) {
+		return 1; // 1/4
+	}
+	else if (count < 4) {
+		return 2; // 1/2
+	}
+	return 3; // Full
+}
+
+static int __simDmaRequest(uint8_t channel);
+
+// GPIO and EXTI
+
+static GPIO_TypeDef* __simGpio(uint8_t port) {
+	// Returns the backing store of a GPIO port
+	return (GPIO_TypeDef*)__simRegister(GPIOA_BASE + (0x400 * port));
+}
+
+static void __simExtiEdges(uint8_t port, uint16_t changed, uint16_t level) {
+	// Sets the EXTI pending bits of the lines mapped to a port that saw a selected edge
+	SYSCFG_TypeDef* syscfg = SIM_REG(SYSCFG);
+	EXTI_TypeDef* exti = SIM_REG(EXTI);
+	for (uint8_t line = 0; line < 16; line++) {
+		uint16_t bit = (1 << line);
+		if (!(changed & bit) || (((syscfg->EXTICR[line / 4] >> (4 * (line % 4))) & 0xF) != port)) {
+			continue;
+		}
+		if (((level & bit) && (exti->RTSR & bit)) || (!(level & bit) && (exti->FTSR & bit))) {
+			exti->PR |= (exti->IMR & bit);
+		}
+	}
+}
+
+static void __simGpioUpdate(uint8_t port) {
+	// Recomputes the input data register of a port from its outputs, pulls and driven inputs
+	GPIO_TypeDef* gpio = __simGpio(port);
+	uint16_t idr = 0;
+	for (uint8_t pin = 0; pin < 16; pin++) {
+		uint16_t bit = (1 << pin);
+		uint8_t mode = (gpio->MODER >> (2 * pin)) & 0x3;
+		uint8_t pull = (gpio->PUPDR >> (2 * pin)) & 0x3;
+		int external = (simGpioDriven[port] & bit) ? !!(simGpioLevels[port] & bit) : (pull == 1); // Floating pins read low
+		int level;
+		if (mode == 1) {
+			// Output (open drain only pulls low)
+			level = (gpio->OTYPER & bit) ? ((gpio->ODR & bit) && external) : !!(gpio->ODR & bit);
+		}
+		else if (mode == 3) {
+			level = 0; // Analog, the Schmitt trigger is off
+		}
+		else {
+			level = external; // Input or alternate function
+		}
+		if (level) {
+			idr |= bit;
+		}
+	}
+	uint16_t changed = gpio->IDR ^ idr;
+	gpio->IDR = idr;
+	if (changed) {
+		__simExtiEdges(port, changed, idr);
+	}
+}
+
+static void __simGpioWrite(uint8_t port, uint32_t offset, uint32_t address, uint32_t previous) {
+	// Side effects of a GPIO register write
+	GPIO_TypeDef* gpio = __simGpio(port);
+	if (offset == 0x18) {
+		// BSRR: set bits win over reset bits, reads as 0
+		uint32_t bsrr = gpio->BSRR;
+		gpio->ODR = (gpio->ODR & ~(bsrr >> 16)) | (bsrr & 0xFFFF);
+		gpio->BSRR = 0;
+	}
+	else if (offset == 0x28) {
+		// BRR: reset bits, reads as 0
+		gpio->ODR &= ~gpio->BRR;
+		gpio->BRR = 0;
+	}
+	else if (offset == 0x10) {
+		__simRestore(address, previous); // IDR is read only
+	}
+	__simGpioUpdate(port);
+}
+
+static void __simExtiWrite(uint32_t offset, uint32_t previous) {
+	// Side effects of an EXTI register write
+	EXTI_TypeDef* exti = SIM_REG(EXTI);
+	if (offset == 0x14) {
+		// PR: write 1 to clear (also clears the matching software interrupt bits)
+		uint32_t cleared = exti->PR;
+		exti->PR = previous & ~cleared;
+		exti->SWIER &= ~cleared;
+	}
+	else if (offset == 0x10) {
+		// SWIER: a 0 to 1 transition sets the pending bit of an unmasked line
+		exti->PR |= (exti->SWIER & ~previous) & exti->IMR;
+	}
+}
+
+static void __simRccWrite(uint32_t offset) {
+	// Clocks are ready as soon as they are switched on
+	RCC_TypeDef* rcc = SIM_REG(RCC);
+	if (offset == 0x00) {
+		uint32_t cr = rcc->CR & ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY);
+		rcc->CR = cr | ((cr & RCC_CR_HSION) << 1) | ((cr & RCC_CR_HSEON) << 1) | ((cr & RCC_CR_PLLON) << 1);
+	}
+	else if (offset == 0x04) {
+		rcc->CFGR = (rcc->CFGR & ~RCC_CFGR_SWS) | ((rcc->CFGR & RCC_CFGR_SW) << 2);
+	}
+	else if (offset == 0x34) {
+		rcc->CR2 = (rcc->CR2 & ~RCC_CR2_HSI14RDY) | ((rcc->CR2 & RCC_CR2_HSI14ON) << 1);
+	}
+}
+
+static void __simNvicWrite(uint32_t address, uint32_t previous) {
+	// Set/clear register pairs share one state
+	NVIC_TypeDef* nvic = SIM_REG(NVIC);
+	uint32_t written = *__simWord(address);
+	if (address == (uint32_t)(uintptr_t)&NVIC->ISER[0]) {
+		nvic->ISER[0] = previous | written;
+		nvic->ICER[0] = nvic->ISER[0];
+	}
+	else if (address == (uint32_t)(uintptr_t)&NVIC->ICER[0]) {
+		nvic->ISER[0] = previous & ~written;
+		nvic->ICER[0] = nvic->ISER[0];
+	}
+	else if (address == (uint32_t)(uintptr_t)&NVIC->ISPR[0]) {
+		nvic->ISPR[0] = previous | written;
+		nvic->ICPR[0] = nvic->ISPR[0];
+	}
+	else if (address == (uint32_t)(uintptr_t)&NVIC->ICPR[0]) {
+		nvic->ISPR[0] = previous & ~written;
+		nvic->ICPR[0] = nvic->ISPR[0];
+	}
+}
+
+// DMA
+
+static DMA_Channel_TypeDef* __simDmaChannel(uint8_t channel) {
+	// Returns the backing store of a DMA1 channel (1-7)
+	return (DMA_Channel_TypeDef*)__simRegister(DMA1_Channel1_BASE + (0x14 * (channel - 1)));
+}
+
+static int __simBusRead(uint32_t address, uint8_t size, uint32_t* value) {
+	// DMA read of a peripheral register or memory, returns 0 on a bus error
+	uint8_t* source;
+	if (__simMapped(address)) {
+		__simModelRead(address, size);
+		source = (uint8_t*)__simRegister(address);
+	}
+	else if (address >= 0x1000) {
+		source = (uint8_t*)(uintptr_t)address;
+	}
+	else {
+		return 0;
+	}
+	*value = (size == 1) ? *source : ((size == 2) ? *((uint16_t*)source) : *((uint32_t*)source));
+	return 1;
+}
+
+static int __simBusWrite(uint32_t address, uint8_t size, uint32_t value) {
+	// DMA write of a peripheral register or memory, returns 0 on a bus error
+	uint8_t* destination;
+	uint32_t previous = 0;
+	int mapped = __simMapped(address);
+	if (mapped) {
+		previous = *__simWord(address);
+		destination = (uint8_t*)__simRegister(address);
+	}
+	else if (address >= 0x1000) {
+		destination = (uint8_t*)(uintptr_t)address;
+	}
+	else {
+		return 0;
+	}
+	if (size == 1) {
+		*destination = (uint8_t)value;
+	}
+	else if (size == 2) {
+		*((uint16_t*)destination) = (uint16_t)value;
+	}
+	else {
+		*((uint32_t*)destination) = value;
+	}
+	if (mapped) {
+		__simModelWrite(address, size, previous);
+	}
+	return 1;
+}
+
+static void __simDmaFlags(uint8_t channel, uint32_t flags) {
+	// Sets channel flags in the DMA ISR (with the global flag)
+	DMA_TypeDef* dma = SIM_REG(DMA1);
+	dma->ISR |= ((flags | DMA_ISR_GIF1) << (4 * (channel - 1)));
+}
+
+static int __simDmaTransfer(uint8_t channel) {
+	// Moves one data item on a channel, returns whether a transfer happened
+	DMA_Channel_TypeDef* registers = __simDmaChannel(channel);
+	SimDMAChannel_TypeDef* state = &simDma[channel];
+	if (!(registers->CCR & DMA_CCR_EN) || (registers->CNDTR == 0)) {
+		return 0;
+	}
+
+	uint8_t peripheralSize = 1 << ((registers->CCR >> 8) & 0x3);
+	uint8_t memorySize = 1 << ((registers->CCR >> 10) & 0x3);
+	uint32_t value;
+	int ok;
+	if (registers->CCR & DMA_CCR_DIR) {
+		// Memory to peripheral (also the source side of memory-to-memory)
+		ok = __simBusRead(state->memory, memorySize, &value) && __simBusWrite(state->peripheral, peripheralSize, value);
+	}
+	else {
+		ok = __simBusRead(state->peripheral, peripheralSize, &value) && __simBusWrite(state->memory, memorySize, value);
+	}
+	if (!ok) {
+		registers->CCR &= ~DMA_CCR_EN; // A bus error disables the channel
+		__simDmaFlags(channel, DMA_ISR_TEIF1);
+		return 0;
+	}
+
+	__simCountDmaTransfer();
+	if (registers->CCR & DMA_CCR_PINC) {
+		state->peripheral += peripheralSize;
+	}
+	if (registers->CCR & DMA_CCR_MINC) {
+		state->memory += memorySize;
+	}
+	registers->CNDTR--;
+	if (registers->CNDTR == (state->count / 2)) {
+		__simDmaFlags(channel, DMA_ISR_HTIF1);
+	}
+	if (registers->CNDTR == 0) {
+		__simDmaFlags(channel, DMA_ISR_TCIF1);
+		if (registers->CCR & DMA_CCR_CIRC) {
+			// Circular mode reloads the count and addresses
+			registers->CNDTR = state->count;
+			state->peripheral = registers->CPAR;
+			state->memory = registers->CMAR;
+		}
+	}
+	return 1;
+}
+
+static int __simDmaRequest(uint8_t channel) {
+	// A peripheral requests a transfer on a channel, returns whether it was served
+	if ((channel == 0) || (channel > SIM_DMA_CHANNELS)) {
+		return 0;
+	}
+	DMA_Channel_TypeDef* registers = __simDmaChannel(channel);
+	if ((registers->CCR & DMA_CCR_MEM2MEM) || !__simDmaTransfer(channel)) {
+		simDma[channel].pending = 1; // Served once the channel is enabled
+		return 0;
+	}
+	return 1;
+}
+
+static void __simDmaWrite(uint32_t address, uint32_t previous) {
+	// Side effects of a DMA1 register write
+	DMA_TypeDef* dma = SIM_REG(DMA1);
+	if (address == DMA1_BASE) {
+		__simRestore(address, previous); // ISR is read only
+		return;
+	}
+	if (address == (DMA1_BASE + 0x04)) {
+		// IFCR: write 1 to clear, a global clear bit clears every flag of its channel
+		uint32_t clear = dma->IFCR;
+		for (uint8_t channel = 0; channel < 7; channel++) {
+			if (clear & (DMA_IFCR_CGIF1 << (4 * channel))) {
+				clear |= (0xF << (4 * channel));
+			}
+		}
+		dma->ISR &= ~clear;
+		for (uint8_t channel = 0; channel < 7; channel++) {
+			if (!(dma->ISR & (0xE << (4 * channel)))) {
+				dma->ISR &= ~(DMA_ISR_GIF1 << (4 * channel)); // No flag left, no global flag
+			}
+		}
+		dma->IFCR = 0;
+		return;
+	}
+	if ((address < DMA1_Channel1_BASE) || (address >= (DMA1_Channel1_BASE + (0x14 * SIM_DMA_CHANNELS)))) {
+		return;
+	}
+
+	uint8_t channel = ((address - DMA1_Channel1_BASE) / 0x14) + 1;
+	uint32_t offset = ((address - DMA1_Channel1_BASE) % 0x14) & ~0x3;
+	DMA_Channel_TypeDef* registers = __simDmaChannel(channel);
+	if (offset == 0x0) {
+		if ((registers->CCR & DMA_CCR_EN) && !(previous & DMA_CCR_EN)) {
+			// Enabling latches the count and addresses
+			simDma[channel].count = registers->CNDTR & 0xFFFF;
+			simDma[channel].peripheral = registers->CPAR;
+			simDma[channel].memory = registers->CMAR;
+			simDma[channel].budget = 0;
+			if (simDma[channel].pending && !(registers->CCR & DMA_CCR_MEM2MEM)) {
+				simDma[channel].pending = 0;
+				__simDmaTransfer(channel); // A request was waiting for the channel
+			}
+		}
+	}
+	else if (previous != *__simWord(address)) {
+		if (registers->CCR & DMA_CCR_EN) {
+			__simRestore(address, previous); // CNDTR, CPAR and CMAR are locked while the channel is enabled
+		}
+	}
+}
+
+static void __simDmaAdvance(uint32_t cycles) {
+	// Memory-to-memory channels run on their own, one data item per SIM_DMA_TRANSFER_CYCLES
+	for (uint8_t channel = 1; channel <= SIM_DMA_CHANNELS; channel++) {
+		DMA_Channel_TypeDef* registers = __simDmaChannel(channel);
+		if ((registers->CCR & (DMA_CCR_EN | DMA_CCR_MEM2MEM)) != (DMA_CCR_EN | DMA_CCR_MEM2MEM)) {
+			continue;
+		}
+		simDma[channel].budget += cycles;
+		while ((simDma[channel].budget >= SIM_DMA_TRANSFER_CYCLES) && __simDmaTransfer(channel)) {
+			simDma[channel].budget -= SIM_DMA_TRANSFER_CYCLES;
+		}
+		if (registers->CNDTR == 0) {
+			simDma[channel].budget = 0;
+		}
+	}
+}
+
+// Timers
+
+static uint8_t __simTimerDmaChannel(uint32_t base) {
+	// Returns the DMA channel of a timer's update request (0 if it has none)
+	uint32_t remap = SIM_REG(SYSCFG)->CFGR1;
+	switch (base) {
+		case TIM1_BASE: return 5;
+		case TIM2_BASE: return 2;
+		case TIM3_BASE: return 3;
+		case TIM6_BASE: return 3;
+		case TIM15_BASE: return 5;
+		case TIM16_BASE: return (remap & SYSCFG_CFGR1_TIM16_DMA_RMP) ? 4 : 3;
+		case TIM17_BASE: return (remap & SYSCFG_CFGR1_TIM17_DMA_RMP) ? 2 : 1;
+	}
+	return 0;
+}
+
+static void __simAdcTrigger(int8_t source);
+static void __simDacTrigger(int8_t source);
+
+static void __simTimerTrigger(SimTimer_TypeDef* timer) {
+	// A TRGO pulse reaches the DAC and ADC trigger inputs
+	if (timer->dacTrigger != SIM_TRIGGER_NONE) {
+		__simDacTrigger(timer->dacTrigger);
+	}
+	if (timer->adcTrigger != SIM_TRIGGER_NONE) {
+		__simAdcTrigger(timer->adcTrigger);
+	}
+}
+
+static void __simTimerUpdate(SimTimer_TypeDef* timer, int software) {
+	// Update event: shadow registers are loaded, UIF/DMA request (not for UG with URS set), TRGO
+	TIM_TypeDef* registers = (TIM_TypeDef*)__simRegister(timer->base);
+	timer->prescaler = registers->PSC;
+	timer->reload = timer->wide ? registers->ARR : (registers->ARR & 0xFFFF);
+	timer->repetition = registers->RCR;
+	if (!software || !(registers->CR1 & TIM_CR1_URS)) {
+		registers->SR |= TIM_SR_UIF;
+		if (registers->DIER & TIM_DIER_UDE) {
+			__simDmaRequest(__simTimerDmaChannel(timer->base));
+		}
+	}
+	uint8_t mms = (registers->CR2 & TIM_CR2_MMS) >> 4;
+	if ((mms == 2) || (software && (mms == 0))) {
+		__simTimerTrigger(timer); // Update (or reset by UG) drives TRGO
+	}
+}
+
+static SimTimer_TypeDef* __simTimer(uint32_t address) {
+	// Returns the timer model of an address (0 if none)
+	for (unsigned int i = 0; i < SIM_TIMER_COUNT; i++) {
+		if (SIM_IN(address, simTimers[i].base)) {
+			return &simTimers[i];
+		}
+	}
+	return 0;
+}
+
+static void __simTimerWrite(SimTimer_TypeDef* timer, uint32_t offset, uint32_t address, uint32_t previous) {
+	// Side effects of a timer register write
+	TIM_TypeDef* registers = (TIM_TypeDef*)__simRegister(timer->base);
+	if (offset == 0x00) {
+		if ((registers->CR1 & TIM_CR1_CEN) && !(previous & TIM_CR1_CEN) && (((registers->CR2 & TIM_CR2_MMS) >> 4) == 1)) {
+			__simTimerTrigger(timer); // Enable drives TRGO
+		}
+	}
+	else if (offset == 0x10) {
+		registers->SR = previous & registers->SR; // Write 0 to clear
+	}
+	else if (offset == 0x14) {
+		uint16_t egr = registers->EGR;
+		registers->EGR = 0;
+		registers->SR |= (egr & 0x5E); // CCxG, COMG, TG set their flags
+		if (egr & TIM_EGR_UG) {
+			registers->CNT = 0;
+			timer->prescaleCount = 0;
+			__simTimerUpdate(timer, 1);
+		}
+	}
+	else if (offset == 0x2C) {
+		if (!(registers->CR1 & TIM_CR1_ARPE)) {
+			timer->reload = timer->wide ? registers->ARR : (registers->ARR & 0xFFFF); // Not preloaded, takes effect at once
+		}
+	}
+}
+
+static void __simTimerAdvance(uint32_t cycles) {
+	// Counts every enabled timer up, with update events on overflow
+	for (unsigned int i = 0; i < SIM_TIMER_COUNT; i++) {
+		SimTimer_TypeDef* timer = &simTimers[i];
+		TIM_TypeDef* registers = (TIM_TypeDef*)__simRegister(timer->base);
+		if (!(registers->CR1 & TIM_CR1_CEN)) {
+			continue;
+		}
+		timer->prescaleCount += cycles;
+		uint64_t ticks = timer->prescaleCount / (timer->prescaler + 1);
+		timer->prescaleCount %= (timer->prescaler + 1);
+		uint64_t top = timer->wide ? 0x100000000ULL : 0x10000ULL;
+		while (ticks && (registers->CR1 & TIM_CR1_CEN)) {
+			uint64_t count = timer->wide ? registers->CNT : (registers->CNT & 0xFFFF);
+			if (count > timer->reload) {
+				// Auto-reload lowered below the counter without preload: count to the top and wrap without an update
+				uint64_t toWrap = top - count;
+				if (ticks < toWrap) {
+					registers->CNT = (uint32_t)(count + ticks);
+					break;
+				}
+				ticks -= toWrap;
+				registers->CNT = 0;
+				continue;
+			}
+			uint64_t toOverflow = (uint64_t)timer->reload - count + 1;
+			if (ticks < toOverflow) {
+				registers->CNT = (uint32_t)(count + ticks);
+				break;
+			}
+			ticks -= toOverflow;
+			registers->CNT = 0;
+			if (timer->repetition) {
+				timer->repetition--;
+				continue;
+			}
+			__simTimerUpdate(timer, 0);
+			if (registers->CR1 & TIM_CR1_OPM) {
+				registers->CR1 &= ~TIM_CR1_CEN; // One-pulse mode stops at the update
+			}
+		}
+	}
+}
+
+// ADC
+
+static uint8_t __simAdcDmaChannel() {
+	// Returns the DMA channel of the ADC
+	return (SIM_REG(SYSCFG)->CFGR1 & SYSCFG_CFGR1_ADC_DMA_RMP) ? 2 : SIM_DMA_ADC;
+}
+
+static uint32_t __simAdcConversionCycles() {
+	// Returns the core cycles of one conversion (sampling + successive approximation)
+	static const uint16_t sampling[8] = {15, 75, 135, 285, 415, 555, 715, 2395}; // ADC clocks x10
+	static const uint16_t conversion[4] = {125, 115, 95, 75}; // 12/10/8/6 bit, ADC clocks x10
+	ADC_TypeDef* adc = SIM_REG(ADC1);
+	uint32_t adcClock = 14000000; // HSI14
+	uint32_t mode = adc->CFGR2 >> 30;
+	if (mode == 1) {
+		adcClock = SIM_CORE_CLOCK / 2;
+	}
+	else if (mode == 2) {
+		adcClock = SIM_CORE_CLOCK / 4;
+	}
+	uint64_t clocks = sampling[adc->SMPR & 0x7] + conversion[(adc->CFGR1 >> 3) & 0x3];
+	return (uint32_t)(((clocks * SIM_CORE_CLOCK) + ((uint64_t)adcClock * 10) - 1) / ((uint64_t)adcClock * 10));
+}
+
+static void __simAdcStartSequence() {
+	// Starts a conversion sequence over the selected channels
+	ADC_TypeDef* adc = SIM_REG(ADC1);
+	simAdc.length = 0;
+	for (uint8_t i = 0; i < SIM_ADC_CHANNELS; i++) {
+		uint8_t channel = (adc->CFGR1 & ADC_CFGR1_SCANDIR) ? (SIM_ADC_CHANNELS - 1 - i) : i;
+		if (adc->CHSELR & (1 << channel)) {
+			simAdc.sequence[simAdc.length++] = channel;
+		}
+	}
+	simAdc.index = 0;
+	simAdc.converting = (simAdc.length != 0);
+	simAdc.remaining = __simAdcConversionCycles();
+}
+
+static void __simAdcComplete() {
+	// End of a conversion: data, flags, DMA request and the next conversion
+	ADC_TypeDef* adc = SIM_REG(ADC1);
+	uint8_t resolution = 12 - (2 * ((adc->CFGR1 >> 3) & 0x3));
+	uint32_t data = simAdc.inputs[simAdc.sequence[simAdc.index]] >> (12 - resolution);
+	if (adc->CFGR1 & ADC_CFGR1_ALIGN) {
+		data = (resolution == 6) ? (data << 2) : (data << (16 - resolution));
+	}
+	if (adc->ISR & ADC_ISR_EOC) {
+		adc->ISR |= ADC_ISR_OVR; // The previous result was not read
+		if (adc->CFGR1 & ADC_CFGR1_OVRMOD) {
+			adc->DR = data;
+		}
+	}
+	else {
+		adc->DR = data;
+	}
+	adc->ISR |= (ADC_ISR_EOC | ADC_ISR_EOSMP);
+	if (adc->CFGR1 & ADC_CFGR1_DMAEN) {
+		__simDmaRequest(__simAdcDmaChannel());
+	}
+
+	simAdc.index++;
+	if (simAdc.index < simAdc.length) {
+		simAdc.remaining = __simAdcConversionCycles();
+		return;
+	}
+	adc->ISR |= ADC_ISR_EOSEQ;
+	simAdc.index = 0;
+	if (adc->CFGR1 & ADC_CFGR1_CONT) {
+		simAdc.remaining = __simAdcConversionCycles();
+		return;
+	}
+	simAdc.converting = 0;
+	if (!(adc->CFGR1 & ADC_CFGR1_EXTEN)) {
+		adc->CR &= ~ADC_CR_ADSTART; // Software started sequences end here, triggered ones wait for the next trigger
+	}
+}
+
+static void __simAdcTrigger(int8_t source) {
+	// A timer TRGO pulse starts a sequence if it is the selected external trigger
+	ADC_TypeDef* adc = SIM_REG(ADC1);
+	if ((adc->CR & ADC_CR_ADSTART) && (adc->CFGR1 & ADC_CFGR1_EXTEN) && (((adc->CFGR1 & ADC_CFGR1_EXTSEL) >> 6) == (uint32_t)source) && !simAdc.converting) {
+		__simAdcStartSequence();
+	}
+}
+
+static void __simAdcWrite(uint32_t offset, uint32_t address, uint32_t previous) {
+	// Side effects of an ADC register write
+	ADC_TypeDef* adc = SIM_REG(ADC1);
+	if (offset == 0x00) {
+		adc->ISR = previous & ~adc->ISR; // Write 1 to clear
+	}
+	else if (offset == 0x08) {
+		// CR: every control bit is set by software and cleared by hardware
+		uint32_t written = adc->CR;
+		uint32_t cr = previous | written;
+		if ((written & ADC_CR_ADCAL) && !(previous & ADC_CR_ADCAL) && !(cr & ADC_CR_ADEN)) {
+			simAdc.calibration = SIM_ADC_CALIBRATION_CYCLES;
+		}
+		if ((cr & ADC_CR_ADEN) && !(previous & ADC_CR_ADEN)) {
+			adc->ISR |= ADC_ISR_ADRDY;
+		}
+		if ((written & ADC_CR_ADSTP) && (cr & ADC_CR_ADSTART)) {
+			simAdc.converting = 0;
+			cr &= ~(ADC_CR_ADSTART | ADC_CR_ADSTP);
+		}
+		cr &= ~ADC_CR_ADSTP;
+		if ((written & ADC_CR_ADDIS) && (cr & ADC_CR_ADEN)) {
+			simAdc.converting = 0;
+			cr &= ~(ADC_CR_ADEN | ADC_CR_ADDIS | ADC_CR_ADSTART);
+		}
+		if (!(cr & ADC_CR_ADEN)) {
+			cr &= ~ADC_CR_ADSTART; // Conversions need the ADC enabled
+		}
+		adc->CR = cr;
+		if ((cr & ADC_CR_ADSTART) && !(previous & ADC_CR_ADSTART) && !(adc->CFGR1 & ADC_CFGR1_EXTEN)) {
+			__simAdcStartSequence();
+			if (!simAdc.converting) {
+				adc->CR &= ~ADC_CR_ADSTART; // No channel selected
+			}
+		}
+	}
+	else if (offset == 0x40) {
+		__simRestore(address, previous); // DR is read only
+	}
+}
+
+static void __simAdcAdvance(uint32_t cycles) {
+	// Runs the calibration and conversions
+	ADC_TypeDef* adc = SIM_REG(ADC1);
+	if (simAdc.calibration) {
+		if (simAdc.calibration > cycles) {
+			simAdc.calibration -= cycles;
+		}
+		else {
+			simAdc.calibration = 0;
+			adc->CR &= ~ADC_CR_ADCAL;
+			adc->DR = 0x40; // Calibration factor
+		}
+	}
+	while (simAdc.converting && cycles) {
+		if (simAdc.remaining > cycles) {
+			simAdc.remaining -= cycles;
+			break;
+		}
+		cycles -= simAdc.remaining;
+		simAdc.remaining = 0;
+		__simAdcComplete();
+	}
+}
+
+// DAC
+
+static void __simDacLoad(uint8_t channel) {
+	// Transfers a data holding register to the output
+	DAC_TypeDef* dac = SIM_REG(DAC);
+	if (channel == 0) {
+		dac->DOR1 = simDac.dhr[0];
+	}
+	else {
+		dac->DOR2 = simDac.dhr[1];
+	}
+	if (simDac.listener) {
+		simDac.listener(channel + 1, simDac.dhr[channel], simCycles());
+	}
+}
+
+static void __simDacTrigger(int8_t source) {
+	// A trigger loads DHR into DOR on the channels that select it, then requests the next sample from the DMA
+	DAC_TypeDef* dac = SIM_REG(DAC);
+	for (uint8_t channel = 0; channel < 2; channel++) {
+		uint32_t cr = dac->CR >> (16 * channel);
+		if (!(cr & DAC_CR_EN1) || !(cr & DAC_CR_TEN1) || (((cr & DAC_CR_TSEL1) >> 3) != (uint32_t)source)) {
+			continue;
+		}
+		__simDacLoad(channel);
+		if (cr & DAC_CR_DMAEN1) {
+			uint8_t dmaChannel = (channel == 0) ? SIM_DMA_DAC1 : SIM_DMA_DAC2;
+			if (simDma[dmaChannel].pending) {
+				dac->SR |= (DAC_SR_DMAUDR1 << (16 * channel)); // The previous request was never served
+			}
+			else {
+				__simDmaRequest(dmaChannel);
+			}
+		}
+	}
+}
+
+static void __simDacWrite(uint32_t offset, uint32_t address, uint32_t previous) {
+	// Side effects of a DAC register write
+	DAC_TypeDef* dac = SIM_REG(DAC);
+	uint32_t value = *__simWord(address);
+	uint8_t updated = 0; // Channels whose DHR was written (bit per channel)
+	switch (offset) {
+		case 0x04:
+			// SWTRIGR: self clearing
+			dac->SWTRIGR = 0;
+			for (uint8_t channel = 0; channel < 2; channel++) {
+				if (value & (1 << channel)) {
+					uint32_t cr = dac->CR >> (16 * channel);
+					if (((cr & DAC_CR_TSEL1) >> 3) == 7) {
+						uint32_t others = dac->CR;
+						dac->CR &= ~(DAC_CR_TEN1 << (16 * (1 - channel))); // Only this channel sees the software trigger
+						__simDacTrigger(7);
+						dac->CR = others;
+					}
+				}
+			}
+			return;
+		case 0x08: simDac.dhr[0] = value & 0xFFF; updated = 0x1; break;
+		case 0x0C: simDac.dhr[0] = (value >> 4) & 0xFFF; updated = 0x1; break;
+		case 0x10: simDac.dhr[0] = (value & 0xFF) << 4; updated = 0x1; break;
+		case 0x14: simDac.dhr[1] = value & 0xFFF; updated = 0x2; break;
+		case 0x18: simDac.dhr[1] = (value >> 4) & 0xFFF; updated = 0x2; break;
+		case 0x1C: simDac.dhr[1] = (value & 0xFF) << 4; updated = 0x2; break;
+		case 0x20: simDac.dhr[0] = value & 0xFFF; simDac.dhr[1] = (value >> 16) & 0xFFF; updated = 0x3; break;
+		case 0x24: simDac.dhr[0] = (value >> 4) & 0xFFF; simDac.dhr[1] = (value >> 20) & 0xFFF; updated = 0x3; break;
+		case 0x28: simDac.dhr[0] = (value & 0xFF) << 4; simDac.dhr[1] = ((value >> 8) & 0xFF) << 4; updated = 0x3; break;
+		case 0x2C: case 0x30:
+			__simRestore(address, previous); // DOR is read only
+			return;
+		case 0x34:
+			dac->SR = previous & ~value; // Write 1 to clear
+			return;
+	}
+	for (uint8_t channel = 0; channel < 2; channel++) {
+		if ((updated & (1 << channel)) && !((dac->CR >> (16 * channel)) & DAC_CR_TEN1)) {
+			__simDacLoad(channel); // Without a trigger the output follows DHR
+		}
+	}
+}
+
+// SPI
+
+static uint8_t __simSpiIndex(uint32_t address) {
+	// Returns the model index of an SPI address
+	return SIM_IN(address, SPI1_BASE) ? 0 : 1;
+}
+
+static SPI_TypeDef* __simSpiRegisters(uint8_t index) {
+	// Returns the backing store of an SPI peripheral
+	return (SPI_TypeDef*)__simRegister((index == 0) ? SPI1_BASE : SPI2_BASE);
+}
+
+static uint8_t __simSpiFrameBits(SPI_TypeDef* spi) {
+	// Returns the frame size in bits (DS + 1, invalid settings read as 8 bit)
+	uint8_t bits = ((spi->CR2 & SPI_CR2_DS) >> 8) + 1;
+	return (bits < 4) ? 8 : bits;
+}
+
+static void __simSpiStatus(uint8_t index) {
+	// Recomputes the FIFO/busy bits of SR
+	SPI_TypeDef* spi = __simSpiRegisters(index);
+	SimSPI_TypeDef* state = &simSpi[index];
+	uint16_t sr = spi->SR & (SPI_SR_OVR | SPI_SR_MODF | SPI_SR_CRCERR | SPI_SR_FRE);
+	if (state->txCount <= 2) {
+		sr |= SPI_SR_TXE; // TX FIFO at most half full
+	}
+	if (state->rxCount >= ((spi->CR2 & SPI_CR2_FRXTH) ? 1 : 2)) {
+		sr |= SPI_SR_RXNE;
+	}
+	sr |= (__simFifoLevel(state->rxCount) << 9) | (__simFifoLevel(state->txCount) << 11);
+	if (state->shifting || state->txCount) {
+		sr |= SPI_SR_BSY;
+	}
+	spi->SR = sr;
+}
+
+static void __simSpiStart(uint8_t index) {
+	// Starts the next frame from the TX FIFO (master mode)
+	SPI_TypeDef* spi = __simSpiRegisters(index);
+	SimSPI_TypeDef* state = &simSpi[index];
+	uint8_t bits = __simSpiFrameBits(spi);
+	uint8_t bytes = (bits > 8) ? 2 : 1;
+	if (state->shifting || !(spi->CR1 & SPI_CR1_SPE) || !(spi->CR1 & SPI_CR1_MSTR) || (state->txCount < bytes)) {
+		return;
+	}
+	state->frame = state->tx[0] | ((bytes == 2) ? (state->tx[1] << 8) : 0);
+	state->txCount -= bytes;
+	memmove(state->tx, state->tx + bytes, state->txCount);
+	state->shifting = 1;
+	state->remaining = bits * (2u << ((spi->CR1 & SPI_CR1_BR) >> 3)); // fPCLK / 2^(BR + 1) per bit
+}
+
+static void __simSpiService(uint8_t index) {
+	// Serves the FIFO DMA requests (RX: SPI1 channel 2, SPI2 channel 4, TX: SPI1 channel 3, SPI2 channel 5)
+	SPI_TypeDef* spi = __simSpiRegisters(index);
+	SimSPI_TypeDef* state = &simSpi[index];
+	if (state->servicing) {
+		return;
+	}
+	state->servicing = 1;
+	while ((spi->CR2 & SPI_CR2_RXDMAEN) && (spi->SR & SPI_SR_RXNE) && __simDmaRequest((index == 0) ? 2 : 4));
+	while ((spi->CR2 & SPI_CR2_TXDMAEN) && (spi->SR & SPI_SR_TXE) && __simDmaRequest((index == 0) ? 3 : 5));
+	state->servicing = 0;
+}
+
+static void __simSpiRead(uint8_t index, uint32_t offset, uint8_t size) {
+	// Reading DR pops the RX FIFO (one byte for 8 bit accesses, two otherwise)
+	if (offset != 0x0C) {
+		return;
+	}
+	SPI_TypeDef* spi = __simSpiRegisters(index);
+	SimSPI_TypeDef* state = &simSpi[index];
+	uint8_t bytes = (size == 1) ? 1 : 2;
+	uint16_t value = 0;
+	for (uint8_t i = 0; (i < bytes) && state->rxCount; i++) {
+		value |= (state->rx[0] << (8 * i));
+		state->rxCount--;
+		memmove(state->rx, state->rx + 1, state->rxCount);
+	}
+	spi->DR = value;
+	spi->SR &= ~SPI_SR_OVR;
+	__simSpiStatus(index);
+	__simSpiService(index);
+}
+
+static void __simSpiWrite(uint8_t index, uint32_t offset, uint8_t size, uint32_t address, uint32_t previous) {
+	// Side effects of an SPI register write
+	SPI_TypeDef* spi = __simSpiRegisters(index);
+	SimSPI_TypeDef* state = &simSpi[index];
+	if (offset == 0x0C) {
+		// Writing DR pushes the TX FIFO (one byte for 8 bit accesses, two otherwise)
+		uint16_t value = spi->DR;
+		uint8_t bytes = (size == 1) ? 1 : 2;
+		for (uint8_t i = 0; (i < bytes) && (state->txCount < 4); i++) {
+			state->tx[state->txCount++] = (value >> (8 * i)) & 0xFF;
+		}
+	}
+	else if (offset == 0x08) {
+		__simRestore(address, (previous & ~SPI_SR_CRCERR) | (previous & *__simWord(address) & SPI_SR_CRCERR)); // Only CRCERR is writable (write 0 to clear)
+	}
+	__simSpiStart(index);
+	__simSpiStatus(index);
+	__simSpiService(index);
+}
+
+static void __simSpiAdvance(uint8_t index, uint32_t cycles) {
+	// Shifts frames out and the device's answers in
+	SPI_TypeDef* spi = __simSpiRegisters(index);
+	SimSPI_TypeDef* state = &simSpi[index];
+	while (state->shifting && cycles) {
+		if (state->remaining > cycles) {
+			state->remaining -= cycles;
+			return;
+		}
+		cycles -= state->remaining;
+		state->shifting = 0;
+		uint8_t bits = __simSpiFrameBits(spi);
+		uint8_t bytes = (bits > 8) ? 2 : 1;
+		uint16_t miso = state->device ? state->device((index == 0) ? SPI1 : SPI2, state->frame, bits) : ((bits > 8) ? 0xFFFF : 0xFF);
+		if ((state->rxCount + bytes) > 4) {
+			spi->SR |= SPI_SR_OVR; // RX FIFO full, the frame is lost
+		}
+		else {
+			for (uint8_t i = 0; i < bytes; i++) {
+				state->rx[state->rxCount++] = (miso >> (8 * i)) & 0xFF;
+			}
+		}
+		__simSpiStart(index);
+		__simSpiStatus(index);
+		__simSpiService(index);
+	}
+}
+
+// I2C
+
+static uint8_t __simI2cIndex(uint32_t address) {
+	// Returns the model index of an I2C address
+	return SIM_IN(address, I2C1_BASE) ? 0 : 1;
+}
+
+static I2C_TypeDef* __simI2cRegisters(uint8_t index) {
+	// Returns the backing store of an I2C peripheral
+	return (I2C_TypeDef*)__simRegister((index == 0) ? I2C1_BASE : I2C2_BASE);
+}
+
+static I2C_TypeDef* __simI2cPeripheral(uint8_t index) {
+	// Returns the peripheral pointer handed to the device callbacks
+	return (index == 0) ? I2C1 : I2C2;
+}
+
+static uint32_t __simI2cBitCycles(uint8_t index) {
+	// Returns the core cycles of one SCL period from TIMINGR
+	I2C_TypeDef* i2c = __simI2cRegisters(index);
+	uint32_t timing = i2c->TIMINGR;
+	uint32_t bit = ((timing >> 28) + 1) * ((timing & 0xFF) + 1 + ((timing >> 8) & 0xFF) + 1);
+	return bit * ((index == 0) ? SIM_I2C_HSI_SCALE : 1);
+}
+
+static void __simI2cStop(uint8_t index) {
+	// Puts a stop condition on the wire
+	simI2c[index].state = SIM_I2C_STOP;
+	simI2c[index].remaining = __simI2cBitCycles(index);
+}
+
+static void __simI2cEnd(uint8_t index) {
+	// NBYTES are done: reload (TCR), automatic stop, or software end (TC)
+	I2C_TypeDef* i2c = __simI2cRegisters(index);
+	if (i2c->CR2 & I2C_CR2_RELOAD) {
+		i2c->ISR |= I2C_ISR_TCR;
+		simI2c[index].state = SIM_I2C_HOLD;
+	}
+	else if (i2c->CR2 & I2C_CR2_AUTOEND) {
+		__simI2cStop(index);
+	}
+	else {
+		i2c->ISR |= I2C_ISR_TC;
+		simI2c[index].state = SIM_I2C_HOLD;
+	}
+}
+
+static void __simI2cTransmit(uint8_t index) {
+	// Moves TXDR into the shift register and puts the byte on the wire
+	I2C_TypeDef* i2c = __simI2cRegisters(index);
+	SimI2C_TypeDef* state = &simI2c[index];
+	state->shift = i2c->TXDR & 0xFF;
+	state->count--;
+	state->state = SIM_I2C_TX;
+	state->remaining = 9 * __simI2cBitCycles(index);
+	i2c->ISR |= I2C_ISR_TXE;
+	if (state->count) {
+		i2c->ISR |= I2C_ISR_TXIS; // Room for the next byte
+	}
+}
+
+static void __simI2cRead(uint8_t index, uint32_t offset) {
+	// Reading RXDR clears RXNE
+	if (offset == 0x24) {
+		__simI2cRegisters(index)->ISR &= ~I2C_ISR_RXNE;
+	}
+}
+
+static void __simI2cWrite(uint8_t index, uint32_t offset, uint32_t address, uint32_t previous) {
+	// Side effects of an I2C register write
+	I2C_TypeDef* i2c = __simI2cRegisters(index);
+	SimI2C_TypeDef* state = &simI2c[index];
+	uint32_t value = *__simWord(address);
+	switch (offset) {
+		case 0x00:
+			if (!(value & I2C_CR1_PE)) {
+				// Disabling the peripheral resets the transfer state
+				state->state = SIM_I2C_IDLE;
+				i2c->ISR = I2C_ISR_TXE;
+				i2c->CR2 &= ~(I2C_CR2_START | I2C_CR2_STOP);
+			}
+			break;
+		case 0x04:
+			if (!(i2c->CR1 & I2C_CR1_PE)) {
+				break;
+			}
+			if ((value & I2C_CR2_START) && !(previous & I2C_CR2_START) && ((state->state == SIM_I2C_IDLE) || (state->state == SIM_I2C_HOLD))) {
+				// (Repeated) start: latch the address, direction and byte count
+				state->address = (value >> 1) & 0x7F;
+				state->read = !!(value & I2C_CR2_RD_WRN);
+				state->count = (value & I2C_CR2_NBYTES) >> 16;
+				state->state = SIM_I2C_ADDRESS;
+				state->remaining = 10 * __simI2cBitCycles(index);
+				i2c->ISR &= ~(I2C_ISR_TC | I2C_ISR_TCR | I2C_ISR_TXIS);
+				i2c->ISR |= (I2C_ISR_BUSY | I2C_ISR_TXE); // TXDR is flushed
+			}
+			else if ((value & I2C_CR2_STOP) && (state->state == SIM_I2C_HOLD)) {
+				__simI2cStop(index);
+			}
+			break;
+		case 0x18:
+			// ISR: only TXE can be written (1 flushes TXDR)
+			__simRestore(address, previous | (value & I2C_ISR_TXE));
+			break;
+		case 0x1C:
+			i2c->ISR &= ~(value & (I2C_ICR_ADDRCF | I2C_ICR_NACKCF | I2C_ICR_STOPCF | I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF));
+			i2c->ICR = 0;
+			break;
+		case 0x24:
+			__simRestore(address, previous); // RXDR is read only
+			break;
+		case 0x28:
+			i2c->ISR &= ~(I2C_ISR_TXE | I2C_ISR_TXIS);
+			if (state->state == SIM_I2C_TX_WAIT) {
+				__simI2cTransmit(index);
+			}
+			break;
+	}
+}
+
+static void __simI2cAdvance(uint8_t index, uint32_t cycles) {
+	// Runs the wire phases of a master transfer
+	I2C_TypeDef* i2c = __simI2cRegisters(index);
+	SimI2C_TypeDef* state = &simI2c[index];
+	I2C_TypeDef* peripheral = __simI2cPeripheral(index);
+	while (cycles && ((state->state == SIM_I2C_ADDRESS) || (state->state == SIM_I2C_TX) || (state->state == SIM_I2C_RX) || (state->state == SIM_I2C_STOP))) {
+		if (state->remaining > cycles) {
+			state->remaining -= cycles;
+			return;
+		}
+		cycles -= state->remaining;
+		state->remaining = 0;
+		switch (state->state) {
+			case SIM_I2C_ADDRESS:
+				i2c->CR2 &= ~I2C_CR2_START;
+				if (!(state->device && state->device->start && state->device->start(peripheral, state->address, state->read))) {
+					i2c->ISR |= I2C_ISR_NACKF; // Address not acknowledged, a stop follows
+					__simI2cStop(index);
+				}
+				else if (state->count == 0) {
+					__simI2cEnd(index);
+				}
+				else if (state->read) {
+					state->state = SIM_I2C_RX;
+					state->remaining = 9 * __simI2cBitCycles(index);
+				}
+				else {
+					state->state = SIM_I2C_TX_WAIT;
+					i2c->ISR |= I2C_ISR_TXIS;
+				}
+				break;
+			case SIM_I2C_TX:
+				if (!(state->device && state->device->write && state->device->write(peripheral, state->shift))) {
+					i2c->ISR |= I2C_ISR_NACKF;
+					i2c->ISR &= ~I2C_ISR_TXIS;
+					__simI2cStop(index);
+				}
+				else if (state->count == 0) {
+					__simI2cEnd(index);
+				}
+				else if (!(i2c->ISR & I2C_ISR_TXE)) {
+					__simI2cTransmit(index); // The next byte is already waiting in TXDR
+				}
+				else {
+					state->state = SIM_I2C_TX_WAIT; // Clock stretched until TXDR is written
+				}
+				break;
+			case SIM_I2C_RX:
+				if (i2c->ISR & I2C_ISR_RXNE) {
+					state->remaining = __simI2cBitCycles(index); // RXDR not read yet, the clock is stretched
+					break;
+				}
+				i2c->RXDR = (state->device && state->device->read) ? state->device->read(peripheral) : 0xFF;
+				i2c->ISR |= I2C_ISR_RXNE;
+				state->count--;
+				if (state->count == 0) {
+					__simI2cEnd(index);
+				}
+				else {
+					state->remaining = 9 * __simI2cBitCycles(index);
+				}
+				break;
+			case SIM_I2C_STOP:
+				i2c->ISR |= I2C_ISR_STOPF;
+				i2c->ISR &= ~I2C_ISR_BUSY;
+				i2c->CR2 &= ~I2C_CR2_STOP;
+				state->state = SIM_I2C_IDLE;
+				if (state->device && state->device->stop) {
+					state->device->stop(peripheral);
+				}
+				break;
+		}
+	}
+}
+
+// Model interface
+
+void __simModelReset() {
+	// Loads the power-on register values and resets the model state
+	RCC_TypeDef* rcc = SIM_REG(RCC);
+	rcc->CR = 0x00000083; // HSI on and ready
+	rcc->AHBENR = 0x00000014; // SRAM and flash interface clocks
+	rcc->CR2 = 0x00000080;
+	rcc->CSR = 0x0C000000;
+
+	GPIO_TypeDef* gpioa = SIM_REG(GPIOA);
+	gpioa->MODER = 0x28000000; // SWD pins
+	gpioa->OSPEEDR = 0x0C000000;
+	gpioa->PUPDR = 0x24000000;
+	memset(simGpioLevels, 0, sizeof(simGpioLevels));
+	memset(simGpioDriven, 0, sizeof(simGpioDriven));
+	for (uint8_t port = 0; port < SIM_GPIO_PORTS; port++) {
+		__simGpioUpdate(port);
+	}
+
+	for (unsigned int i = 0; i < SIM_TIMER_COUNT; i++) {
+		TIM_TypeDef* timer = (TIM_TypeDef*)__simRegister(simTimers[i].base);
+		timer->ARR = simTimers[i].wide ? 0xFFFFFFFF : 0xFFFF;
+		simTimers[i].prescaler = 0;
+		simTimers[i].reload = timer->ARR;
+		simTimers[i].prescaleCount = 0;
+		simTimers[i].repetition = 0;
+	}
+
+	memset(simDma, 0, sizeof(simDma));
+
+	memset(&simAdc, 0, sizeof(simAdc));
+	simAdc.inputs[16] = 0x6B0; // Temperature sensor (around 30 degrees)
+	simAdc.inputs[17] = 0x5F0; // VREFINT (1.23 V at VDDA = 3.3 V)
+	simAdc.inputs[18] = 0x800; // VBAT / 2
+
+	simDac.dhr[0] = 0;
+	simDac.dhr[1] = 0;
+
+	for (uint8_t i = 0; i < 2; i++) {
+		SimSPIDevice_TypeDef device = simSpi[i].device;
+		memset(&simSpi[i], 0, sizeof(simSpi[i]));
+		simSpi[i].device = device;
+		SPI_TypeDef* spi = __simSpiRegisters(i);
+		spi->CR2 = 0x0700; // 8 bit frames
+		spi->SR = SPI_SR_TXE;
+
+		SimI2CDevice_TypeDef* slave = simI2c[i].device;
+		memset(&simI2c[i], 0, sizeof(simI2c[i]));
+		simI2c[i].device = slave;
+		__simI2cRegisters(i)->ISR = I2C_ISR_TXE;
+	}
+
+	DBGMCU_TypeDef* dbgmcu = SIM_REG(DBGMCU);
+	dbgmcu->IDCODE = 0x20000440; // STM32F051, revision 2.0
+}
+
+void __simModelDevices() {
+	// Removes every device/listener binding
+	simSpi[0].device = 0;
+	simSpi[1].device = 0;
+	simI2c[0].device = 0;
+	simI2c[1].device = 0;
+	simDac.listener = 0;
+}
+
+void __simModelRead(uint32_t address, uint8_t size) {
+	// Updates a register before the CPU (or the DMA) reads it
+	if (SIM_IN(address, SPI1_BASE) || SIM_IN(address, SPI2_BASE)) {
+		__simSpiRead(__simSpiIndex(address), (address & 0x3FF) & ~0x1, size);
+	}
+	else if (SIM_IN(address, I2C1_BASE) || SIM_IN(address, I2C2_BASE)) {
+		__simI2cRead(__simI2cIndex(address), (address & 0x3FF) & ~0x3);
+	}
+	else if ((address & ~0x3) == (uint32_t)(uintptr_t)&ADC1->DR) {
+		SIM_REG(ADC1)->ISR &= ~ADC_ISR_EOC; // Reading the data clears EOC
+	}
+}
+
+void __simModelWrite(uint32_t address, uint8_t size, uint32_t previous) {
+	// Applies the side effects of a write
+	uint32_t offset = (address & 0x3FF) & ~0x3;
+	SimTimer_TypeDef* timer;
+	if ((address >= GPIOA_BASE) && (address < (GPIOA_BASE + (0x400 * SIM_GPIO_PORTS)))) {
+		__simGpioWrite((address - GPIOA_BASE) / 0x400, offset, address, previous);
+	}
+	else if ((timer = __simTimer(address)) != 0) {
+		__simTimerWrite(timer, offset, address, previous);
+	}
+	else if (SIM_IN(address, DMA1_BASE)) {
+		__simDmaWrite(address & ~0x3, previous);
+	}
+	else if (SIM_IN(address, ADC1_BASE)) {
+		__simAdcWrite(offset, address, previous);
+	}
+	else if (SIM_IN(address, DAC_BASE)) {
+		__simDacWrite(offset, address, previous);
+	}
+	else if (SIM_IN(address, SPI1_BASE) || SIM_IN(address, SPI2_BASE)) {
+		__simSpiWrite(__simSpiIndex(address), offset, size, address, previous);
+	}
+	else if (SIM_IN(address, I2C1_BASE) || SIM_IN(address, I2C2_BASE)) {
+		__simI2cWrite(__simI2cIndex(address), offset, address, previous);
+	}
+	else if (SIM_IN(address, EXTI_BASE)) {
+		__simExtiWrite(offset, previous);
+	}
+	else if (SIM_IN(address, SYSCFG_BASE)) {
+		for (uint8_t port = 0; port < SIM_GPIO_PORTS; port++) {
+			__simGpioUpdate(port);
+		}
+	}
+	else if (SIM_IN(address, RCC_BASE)) {
+		__simRccWrite(offset);
+	}
+	else if ((address >= (uint32_t)(uintptr_t)NVIC) && (address < ((uint32_t)(uintptr_t)NVIC + sizeof(NVIC_TypeDef)))) {
+		__simNvicWrite(address & ~0x3, previous);
+	}
+}
+
+void __simModelAdvance(uint32_t cycles) {
+	// Runs the peripherals for a number of core cycles
+	__simTimerAdvance(cycles);
+	__simDmaAdvance(cycles);
+	__simAdcAdvance(cycles);
+	__simSpiAdvance(0, cycles);
+	__simSpiAdvance(1, cycles);
+	__simI2cAdvance(0, cycles);
+	__simI2cAdvance(1, cycles);
+}
+
+uint32_t __simModelInterrupts() {
+	// Returns the interrupt lines currently requested by the peripherals
+	uint32_t lines = 0;
+
+	EXTI_TypeDef* exti = SIM_REG(EXTI);
+	uint32_t exti_pending = exti->PR & exti->IMR;
+	if (exti_pending & 0x0003) {
+		lines |= (1 << EXTI0_1_IRQn);
+	}
+	if (exti_pending & 0x000C) {
+		lines |= (1 << EXTI2_3_IRQn);
+	}
+	if (exti_pending & 0xFFF0) {
+		lines |= (1 << EXTI4_15_IRQn);
+	}
+
+	DMA_TypeDef* dma = SIM_REG(DMA1);
+	for (uint8_t channel = 1; channel <= SIM_DMA_CHANNELS; channel++) {
+		if ((dma->ISR >> (4 * (channel - 1))) & __simDmaChannel(channel)->CCR & (DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE)) {
+			lines |= (1 << ((channel == 1) ? DMA1_Channel1_IRQn : ((channel <= 3) ? DMA1_Channel2_3_IRQn : DMA1_Channel4_5_IRQn)));
+		}
+	}
+
+	ADC_TypeDef* adc = SIM_REG(ADC1);
+	if (adc->ISR & adc->IER & 0x9F) {
+		lines |= (1 << ADC1_COMP_IRQn);
+	}
+
+	for (unsigned int i = 0; i < SIM_TIMER_COUNT; i++) {
+		TIM_TypeDef* timer = (TIM_TypeDef*)__simRegister(simTimers[i].base);
+		uint16_t flags = timer->SR & timer->DIER & 0xFF;
+		if (simTimers[i].base == TIM1_BASE) {
+			if (flags & 0x1E) {
+				lines |= (1 << TIM1_CC_IRQn);
+			}
+			flags &= ~0x1E;
+		}
+		if (flags) {
+			lines |= (1 << simTimers[i].irqn);
+		}
+	}
+
+	DAC_TypeDef* dac = SIM_REG(DAC);
+	if ((dac->SR & DAC_SR_DMAUDR1 && (dac->CR & DAC_CR_DMAUDRIE1)) || ((dac->SR & DAC_SR_DMAUDR2) && (dac->CR & DAC_CR_DMAUDRIE2))) {
+		lines |= (1 << TIM6_DAC_IRQn);
+	}
+
+	for (uint8_t i = 0; i < 2; i++) {
+		SPI_TypeDef* spi = __simSpiRegisters(i);
+		if (((spi->CR2 & SPI_CR2_TXEIE) && (spi->SR & SPI_SR_TXE)) || ((spi->CR2 & SPI_CR2_RXNEIE) && (spi->SR & SPI_SR_RXNE)) || ((spi->CR2 & SPI_CR2_ERRIE) && (spi->SR & (SPI_SR_OVR | SPI_SR_MODF | SPI_SR_CRCERR | SPI_SR_FRE)))) {
+			lines |= (1 << ((i == 0) ? SPI1_IRQn : SPI2_IRQn));
+		}
+
+		I2C_TypeDef* i2c = __simI2cRegisters(i);
+		uint32_t cr1 = i2c->CR1;
+		uint32_t isr = i2c->ISR;
+		if (((cr1 & I2C_CR1_TXIE) && (isr & I2C_ISR_TXIS)) || ((cr1 & I2C_CR1_RXIE) && (isr & I2C_ISR_RXNE)) || ((cr1 & I2C_CR1_NACKIE) && (isr & I2C_ISR_NACKF)) || ((cr1 & I2C_CR1_STOPIE) && (isr & I2C_ISR_STOPF)) || ((cr1 & I2C_CR1_TCIE) && (isr & (I2C_ISR_TC | I2C_ISR_TCR))) || ((cr1 & I2C_CR1_ERRIE) && (isr & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)))) {
+			lines |= (1 << ((i == 0) ? I2C1_IRQn : I2C2_IRQn));
+		}
+	}
+
+	return lines;
+}
+
+// Test bench interface
+
+void simGpioInput(GPIO_TypeDef* port, uint8_t pin, int level) {
+	// Drives an input pin from outside, or releases it
+	uint8_t index = ((uint32_t)(uintptr_t)port - GPIOA_BASE) / 0x400;
+	if ((index >= SIM_GPIO_PORTS) || (pin > 15)) {
+		return;
+	}
+	if (level == SIM_GPIO_RELEASE) {
+		simGpioDriven[index] &= ~(1 << pin);
+	}
+	else {
+		simGpioDriven[index] |= (1 << pin);
+		if (level) {
+			simGpioLevels[index] |= (1 << pin);
+		}
+		else {
+			simGpioLevels[index] &= ~(1 << pin);
+		}
+	}
+	__simGpioUpdate(index);
+}
+
+uint16_t simGpioOutput(GPIO_TypeDef* port) {
+	// Returns the output data register of a port
+	return ((GPIO_TypeDef*)__simRegister((uint32_t)(uintptr_t)port))->ODR;
+}
+
+void simAdcInput(uint8_t channel, uint16_t value) {
+	// Sets the 12 bit value an ADC channel converts to
+	if (channel < SIM_ADC_CHANNELS) {
+		simAdc.inputs[channel] = value & 0xFFF;
+	}
+}
+
+void simSPIDevice(SPI_TypeDef* spi, SimSPIDevice_TypeDef device) {
+	// Attaches a device to an SPI bus
+	simSpi[__simSpiIndex((uint32_t)(uintptr_t)spi)].device = device;
+}
+
+void simI2CDevice(I2C_TypeDef* i2c, SimI2CDevice_TypeDef* device) {
+	// Attaches a slave to an I2C bus
+	simI2c[__simI2cIndex((uint32_t)(uintptr_t)i2c)].device = device;
+}
+
+void simDACListener(SimDACListener_TypeDef listener) {
+	// Installs a listener for DAC output changes
+	simDac.listener = listener;
+}
+
+uint16_t simDACOutput(uint8_t channel) {
+	// Returns the DAC output register of a channel (1 or 2)
+	DAC_TypeDef* dac = SIM_REG(DAC);
+	return (channel == 2) ? dac->DOR2 : dac->DOR1;
+}
@@ -0,0 +1,694 @@
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Program: sim_bench (host build)
+Drives the driver entry points through representative workloads against the peripheral models (SPI EEPROM page traffic,
+I2C temperature polling, DAC DMA waveform playback, LCD full-screen refresh, ...) and compares the bench cycles per call of every
+function, and of every whole workload, with its recorded budget
+
+Usage: sim_bench [-r] [-t percent] budgets.csv
+Exits with the number of failures: a function or workload over its budget (by more than the tolerance, 2% by default),
+without a budget, or a workload that did not produce the expected result
+-r records the measured cycles as the new budgets instead (after an intended change, review the diff of the budget file)
+
+Bench cycles: instruction stepping is on for the whole run, so every host (x86-64) instruction of the library costs one cycle,
+every register access its bus cycles (SIM_AHB/APB_ACCESS_CYCLES) and interrupt entry/exit their Cortex-M0 cost
+This is a regression measure, not a Cortex-M0 cycle count: it only means something against budgets recorded by the same build,
+so host/Makefile pins the library's code generation (-O0, CODEGEN: no stack protector, no CET instrumentation) regardless of CC
+__cpuHoldDelay is replaced at link time (-Wl,--wrap=__cpuHoldDelay) by the cost of its loop on the target (BENCH_DELAY_LOOP_CYCLES
+per iteration), as stepping through thousands of empty iterations would only measure the host compiler
+
+*/
+
+/* INCLUDES */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef STM32F0_OTHER_H
+#include "STM32F0_OTHER.h"
+#define STM32F0_OTHER_H
+#endif
+
+#ifndef STM32F0_PROFILE_H
+#include "STM32F0_PROFILE.h"
+#define STM32F0_PROFILE_H
+#endif
+
+#ifndef STM32F0_UCTDEV_H
+#include "STM32F0_UCTDEV.h"
+#define STM32F0_UCTDEV_H
+#endif
+
+#ifndef STM32F0_LCD_H
+#include "STM32F0_LCD.h"
+#define STM32F0_LCD_H
+#endif
+
+#ifndef WAVE_SINE256_H
+#include "WAVE_SINE256.h"
+#define WAVE_SINE256_H
+#endif
+
+#ifndef WAVE_SINE256_PACKED_H
+#include "WAVE_SINE256_PACKED.h"
+#define WAVE_SINE256_PACKED_H
+#endif
+
+/* CONSTANT DEFINITIONS */
+
+#define BENCH_DELAY_LOOP_CYCLES 11 // Cortex-M0 cycles per iteration of the __cpuHoldDelay loop (volatile counter: 2 loads, store, add, compare, taken branch)
+#define BENCH_TOLERANCE 2 // Default allowed excess over a budget (percent)
+#define BENCH_MAX_BUDGETS PROFILE_MAX_FUNCTIONS
+
+#define CALL(function, arguments) PROFILE_CALL(#function, function arguments) // Measures a call whose result is not needed
+#define CHECK(condition) __check((condition), #condition, __LINE__)
+
+typedef struct {
+	// A type definition for a recorded budget
+	char name[64]; // Function or workload
+	uint64_t cycles; // Allowed cycles per call
+} BenchBudget_TypeDef;
+
+/* GLOBAL VARIABLES */
+
+static int failures = 0;
+static BenchBudget_TypeDef budgets[BENCH_MAX_BUDGETS];
+static uint8_t budgetCount = 0;
+
+static uint16_t wave[32]; // Static: handed to the DMA
+static uint16_t streamBuffer[64];
+static uint32_t streamSamples = 0;
+static uint32_t dacSamples = 0;
+static uint32_t dualWave[16]; // Static: handed to the DMA
+static uint16_t ddsBuffer[64]; // Static: handed to the DMA
+static uint16_t ddsBlock[256];
+static uint16_t scanBuffer[12];
+static uint32_t adcResults = 0;
+static uint16_t dmaBuffer[64]; // Source of the paced stream and scatter-gather list
+static volatile uint16_t dmaSink; // RAM word standing in for a peripheral data register
+static uint32_t dmaHalves = 0;
+static uint32_t dmaListsDone = 0;
+static const DACPackedWave_TypeDef sinePacked = WAVE_SINE256_PACKED;
+
+/* FUNCTIONS */
+
+void __wrap___cpuHoldDelay(uint32_t uS) {
+	// Charges the cycles the delay loop takes on the target
+	simAdvance(uS * (HSI_VALUE / 2000000) * BENCH_DELAY_LOOP_CYCLES);
+}
+
+void pinInterruptTriggered(IOPin_TypeDef* iopin) {
+	// Pin interrupts are not used
+}
+
+static void __check(int condition, const char* text, int line) {
+	// Records a workload that did not produce the expected result
+	if (!condition) {
+		printf("FAIL line %d: %s\n", line, text);
+		failures++;
+	}
+}
+
+static void dacCounter(uint8_t channel, uint16_t value, uint64_t cycle) {
+	// Counts DAC output updates
+	dacSamples++;
+}
+
+static uint16_t streamSource(uint16_t* samples, uint16_t count) {
+	// Endless ramp
+	for (uint16_t i = 0; i < count; i++) {
+		samples[i] = (streamSamples++ * 64) & 0xFFF;
+	}
+	return count;
+}
+
+static void adcCounter(uint8_t channel, uint16_t value, uint8_t events) {
+	// Counts conversion results delivered from the ADC interrupt
+	adcResults++;
+}
+
+static void dmaConsumer(DMAStream_TypeDef* stream, uint8_t half) {
+	// Takes each half of the paced stream and hands it straight back (not bracketed: the profiler would run stepped in the interrupt)
+	uint16_t* samples = (uint16_t*)dmaStreamHalfAddress(stream, half);
+	samples[0] = (uint16_t)dmaHalves++;
+	dmaStreamRelease(stream, half);
+}
+
+static void dmaListDone(DMAScatterGather_TypeDef* list) {
+	// Counts finished scatter-gather lists
+	dmaListsDone++;
+}
+
+static void __benchPacedTimer(uint16_t period) {
+	// Starts TIM17 requesting a DMA transfer (DMA channel 1) every period uS
+	init_timer(TIM17, 47);
+	startRepeatingTimer(TIM17, period - 1);
+	TIM17->DIER |= TIM_DIER_UDE;
+}
+
+static void __benchGPIO() {
+	// Pin setup and toggling (LED bar, switches)
+	volatile int level = 0;
+	CALL(init_STD_GPIO, ());
+	CALL(pinMode, (PB0, GPIO_OUTPUT));
+	CALL(pinMode, (SW0, GPIO_INPUT));
+	CALL(pinState, (SW0, GPIO_PULLUP));
+	for (int i = 0; i < 32; i++) {
+		CALL(digitalWrite, (PB0, (i & 1)));
+		PROFILE_CALL("digitalRead", level = digitalRead(SW0));
+	}
+	CHECK(level == HIGH);
+	for (int i = 0; i < 8; i++) {
+		CALL(ledWrite, (1 << i));
+	}
+	CHECK((simGpioOutput(GPIOB) & 0xFF) == 0x80);
+}
+
+static void __benchTimers() {
+	// Timer start/poll and rate selection
+	volatile int complete = 0;
+	CALL(init_timer, (TIM14, 47));
+	CALL(startTimer, (TIM14, 100));
+	simAdvance(101 * 48);
+	PROFILE_CALL("timerComplete", complete = timerComplete(TIM14));
+	CHECK(complete);
+	CALL(stopTimer, (TIM14));
+	for (uint32_t rate = 1000; rate <= 64000; rate *= 2) {
+		PROFILE_CALL("startRateTimer", complete = startRateTimer(TIM14, rate));
+		CALL(stopTimer, (TIM14));
+	}
+	CALL(configure_PWM, (TIM2));
+	CALL(pwmEnable, (TIM2, 3));
+	for (int i = 0; i < 8; i++) {
+		CALL(pwmWrite, (TIM2, 3, (uint8_t)(i * 32)));
+	}
+}
+
+static void __benchADC() {
+	// Potentiometer sampling
+	volatile uint16_t value = 0;
+	ADCInput_TypeDef input;
+	CALL(init_ADC, (ADC_12BIT));
+	CALL(adcInputInit, (&input, POT1));
+	for (int i = 0; i < 16; i++) {
+		simAdcInput(5, (uint16_t)(i * 256));
+		PROFILE_CALL("analogRead", value = analogRead(POT0));
+		CHECK(value == (i * 256));
+		PROFILE_CALL("adcInputRead", value = adcInputRead(&input));
+	}
+}
+
+static void __benchADCConversions() {
+	// Software, non-blocking, timeout bounded, interrupt driven and timer triggered conversions
+	volatile uint16_t value = 0;
+	uint16_t result = 0;
+	volatile uint8_t status = 0;
+	volatile uint32_t rate = 0;
+	simAdcInput(5, 0x321);
+	simAdcInput(6, 0x654);
+	PROFILE_CALL("analogReadChannel", value = analogReadChannel(ADC_CHANNEL_TEMPERATURE));
+	for (int i = 0; i < 8; i++) {
+		PROFILE_CALL("adcStart", status = adcStart(ADC_CHANNEL_MASK(5)));
+		do {
+			PROFILE_CALL("adcPoll", status = adcPoll(&result));
+		} while (status == ADC_STATUS_BUSY);
+		CHECK((status == ADC_STATUS_COMPLETE) && (result == 0x321));
+		PROFILE_CALL("adcReadTimeout", status = adcReadTimeout(ADC_CHANNEL_MASK(6), &result, ADC_TIMEOUT));
+		CHECK(status && (result == 0x654));
+	}
+
+	// Results through the interrupt: a two channel sequence, then 1 ms of sequences triggered by TIM3 at 8 kHz
+	adcResults = 0;
+	CALL(adcInterruptEnable, (adcCounter, 1));
+	CALL(adcStart, (ADC_CHANNEL_MASK(5) | ADC_CHANNEL_MASK(6)));
+	simAdvance(SIM_CORE_CLOCK / 10000);
+	CHECK(adcResults == 2);
+	PROFILE_CALL("adcTriggerStart", rate = adcTriggerStart(ADC_TRIGGER_TIM3, 8000));
+	CHECK(rate != 0);
+	simAdvance(SIM_CORE_CLOCK / 1000);
+	CALL(adcTriggerStop, ());
+	CALL(adcInterruptDisable, ());
+	CHECK((adcResults >= (2 + 14)) && (adcResults <= (2 + 18))); // 7 to 9 sequences of 2 results
+	PROFILE_CALL("adcOverruns", value = adcOverruns());
+	CHECK(value == 0);
+}
+
+static void __benchADCScan() {
+	// DMA ring buffer scans, free running and timer triggered
+	ADCScan_TypeDef scan;
+	volatile uint32_t rate = 0;
+	volatile uint16_t value = 0;
+	uint32_t channels = (ADC_CHANNEL_MASK(5) | ADC_CHANNEL_MASK(6) | ADC_CHANNEL_MASK(ADC_CHANNEL_TEMPERATURE));
+	simAdcInput(5, 0x111);
+	simAdcInput(6, 0x222);
+	PROFILE_CALL("adcScanStart", rate = adcScanStart(&scan, channels, scanBuffer, 4));
+	CHECK(rate != 0);
+	simAdvance(SIM_CORE_CLOCK / 10000);
+	for (int i = 0; i < 8; i++) {
+		PROFILE_CALL("adcScanRead", value = adcScanRead(&scan, (i & 1) ? 6 : 5));
+		CHECK(value == ((i & 1) ? 0x222 : 0x111));
+		PROFILE_CALL("adcScanPosition", value = adcScanPosition(&scan));
+	}
+	CALL(adcScanStop, (&scan));
+
+	// 2 kHz sequences triggered by TIM15 for 2 ms
+	simAdcInput(5, 0x333);
+	PROFILE_CALL("adcScanStartTriggered", rate = adcScanStartTriggered(&scan, channels, scanBuffer, 4, ADC_TRIGGER_TIM15, 2000));
+	CHECK(rate != 0);
+	simAdvance(SIM_CORE_CLOCK / 500);
+	PROFILE_CALL("adcScanRead", value = adcScanRead(&scan, 5));
+	CHECK(value == 0x333);
+	CALL(adcScanStop, (&scan));
+	CHECK(dmaChannelOwnedBy(DMA_REQUEST_ADC) == 0);
+}
+
+static void __benchEEPROMPage() {
+	// SPI EEPROM page traffic: a 32 byte page written and read back byte by byte
+	volatile uint8_t data = 0;
+	int errors = 0;
+	CALL(init_EEPROM, ());
+	for (uint16_t i = 0; i < 32; i++) {
+		CALL(eepromWrite, (0x0100 + i, (uint8_t)(0x5A ^ i)));
+	}
+	for (uint16_t i = 0; i < 32; i++) {
+		PROFILE_CALL("eepromRead", data = eepromRead(0x0100 + i));
+		errors += (data != (uint8_t)(0x5A ^ i));
+	}
+	CHECK(errors == 0);
+	CHECK(simBoardEEPROM()[0x011F] == (0x5A ^ 0x1F));
+}
+
+static void __benchTemperature() {
+	// I2C temperature polling
+	volatile uint8_t temperature = 0;
+	CALL(init_tempSensor, ());
+	for (int i = 0; i < 4; i++) {
+		simBoardTemperature((int8_t)(20 + i));
+		PROFILE_CALL("tempSensorRead", temperature = tempSensorRead());
+		CHECK(temperature == (20 + i));
+		simAdvance(SIM_CORE_CLOCK / 1000);
+	}
+}
+
+static void __benchDAC() {
+	// Direct output, a refilled stream, then DMA waveform playback
+	DACHandle_TypeDef handle;
+	DACStream_TypeDef player;
+	volatile uint32_t rate = 0;
+	for (int i = 0; i < 32; i++) {
+		wave[i] = (uint16_t)(i * 128);
+	}
+	CALL(init_DAC, (1, 0, 0, 0));
+	for (int i = 0; i < 32; i++) {
+		CALL(dacValueOut, (1, wave[i], DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN));
+	}
+	CHECK(simDACOutput(1) == wave[31]);
+	CALL(dacHandleInit, (&handle, 1, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN));
+	for (int i = 0; i < 32; i++) {
+		CALL(dacHandleWrite, (&handle, wave[i]));
+	}
+
+	// Stream refilled from the DMA interrupts, 16 kHz for 8 ms (the refills are measured inside the workload)
+	streamSamples = 0;
+	PROFILE_CALL("dacStreamStart", rate = dacStreamStart(&player, streamBuffer, 64, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, streamSource, DAC_TRIGGER_TIM6, 16000, 1));
+	CHECK(rate != 0);
+	simAdvance(SIM_CORE_CLOCK / 125);
+	CALL(dacStreamStop, (&player));
+	CHECK(streamSamples == (64 + 128));
+	CHECK(dacStreamUnderruns(&player) == 0);
+
+	// Timer triggered DMA playback, 32 samples at 32 kHz for 2 ms
+	simDACListener(dacCounter);
+	dacSamples = 0;
+	PROFILE_CALL("dacDMATriggeredWaveGen", rate = dacDMATriggeredWaveGen(1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 32, DAC_TRIGGER_TIM6, 32000));
+	CHECK(rate != 0);
+	simAdvance(SIM_CORE_CLOCK / 500);
+	CALL(dacDMATriggeredWaveGenDisable, (1));
+	CHECK((dacSamples >= 64) && (dacSamples <= 68)); // Plus the trigger periods spent inside the stepped start and disable calls
+
+	// Timer paced DMA waveform generation, 20 us per sample for 2 ms with a table swap half way
+	dacSamples = 0;
+	CALL(dacDMAWaveGen, (1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 32, 20));
+	simAdvance(SIM_CORE_CLOCK / 1000);
+	CALL(dacDMAWaveSetTable, (1, wave, 16));
+	simAdvance(SIM_CORE_CLOCK / 1000);
+	CALL(dacDMAWaveGenDisable, (1));
+	simDACListener(0);
+	CHECK((dacSamples >= 96) && (dacSamples <= 104));
+}
+
+static void __benchDACWaveforms() {
+	// CPU output loops, paced CPU playback, dual channel DMA generation and the built-in noise/triangle generators
+	volatile uint32_t rate = 0;
+	DACHandle_TypeDef handle;
+	CALL(init_DAC, (1, 0, 0, 0));
+	CALL(init_DAC, (2, 0, 0, 0));
+	for (int i = 0; i < 8; i++) {
+		CALL(analogWrite, (1, (uint8_t)(i * 32)));
+	}
+	CALL(dacWaveOut, (1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 32));
+	CALL(dacWaveGen, (1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 32, 4));
+	CALL(dacHandleInit, (&handle, 2, DAC_MODE_12BIT | DAC_MODE_LEFTALIGN));
+	CALL(dacHandleWaveOut, (&handle, wave, 32));
+
+	// Paced CPU playback: 16 samples twice at 32 kHz
+	simDACListener(dacCounter);
+	dacSamples = 0;
+	PROFILE_CALL("dacPacedWaveGen", rate = dacPacedWaveGen(1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 16, 2, DAC_TRIGGER_TIM6, 32000));
+	CHECK(rate != 0);
+	PROFILE_CALL("dacPacedLateSamples", rate = dacPacedLateSamples());
+	CHECK(rate == 0);
+	CHECK(dacSamples >= 32);
+
+	// Dual channel DMA generation, 16 packed samples at 25 us for 1 ms with a period change half way
+	for (int i = 0; i < 16; i++) {
+		dualWave[i] = DAC_DUAL_PACK(i * 256, 4095 - (i * 256));
+	}
+	dacSamples = 0;
+	CALL(dacDMADualWaveGen, (dualWave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 16, 25));
+	simAdvance(SIM_CORE_CLOCK / 2000);
+	CALL(dacDMAWaveSetPeriod, (1, 50));
+	simAdvance(SIM_CORE_CLOCK / 2000);
+	CALL(dacDMADualWaveGenDisable, ());
+	simDACListener(0);
+	CHECK(dmaChannelOwnedBy(DMA_REQUEST_TIM17) == 0);
+
+	// Triangle stepped by software, noise stepped by TIM6 at 48 kHz for 0.5 ms
+	PROFILE_CALL("dacHardwareWaveGen", rate = dacHardwareWaveGen(1, DAC_WAVE_TRIANGLE, 7, 0x400, DAC_TRIGGER_SOFTWARE, 0));
+	for (int i = 0; i < 8; i++) {
+		CALL(dacSoftwareTrigger, (1));
+	}
+	CALL(dacHardwareWaveGenDisable, (1));
+	PROFILE_CALL("dacHardwareWaveGen", rate = dacHardwareWaveGen(1, DAC_WAVE_NOISE, DAC_WAVE_AMPLITUDE_MAX, 0, DAC_TRIGGER_TIM6, 48000));
+	CHECK(rate != 0);
+	simAdvance(SIM_CORE_CLOCK / 2000);
+	CALL(dacHardwareWaveGenDisable, (1));
+}
+
+static void __benchDACPacked() {
+	// Packed waveform decoding, then 4 ms of packed playback at 16 kHz refilled from the DMA interrupts
+	DACPackedDecoder_TypeDef decoder;
+	volatile uint32_t rate = 0;
+	CALL(dacPackedWaveReset, (&decoder, &sinePacked));
+	for (int i = 0; i < 8; i++) {
+		CALL(dacPackedWaveDecode, (&decoder, streamBuffer, 32));
+	}
+	CHECK(streamBuffer[31] == (sinePacked.reflect - WAVE_SINE256_PACKED_DATA[1])); // 256 samples decoded, the last one reflects the second
+
+	PROFILE_CALL("dacPackedWaveStart", rate = dacPackedWaveStart(&decoder, &sinePacked, streamBuffer, 64, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, DAC_TRIGGER_TIM6, 16000, 1));
+	CHECK(rate != 0);
+	simAdvance(SIM_CORE_CLOCK / 250);
+	CHECK(dacStreamUnderruns(&decoder.player) == 0);
+	CALL(dacPackedWaveStop, (&decoder));
+}
+
+static void __benchDACDDS() {
+	// 4 ms of DDS at 32 kHz (1 kHz, then 2 kHz) refilled from the DMA interrupts, then one 256 sample fill on its own
+	DACDDS_TypeDef dds;
+	volatile uint32_t rate = 0;
+	simDACListener(dacCounter);
+	dacSamples = 0;
+	PROFILE_CALL("dacDDSStart", rate = dacDDSStart(&dds, WAVE_SINE256, WAVE_SINE256_LENGTH, ddsBuffer, 64, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, DAC_TRIGGER_TIM6, 32000, 1000000, 1));
+	CHECK(rate != 0);
+	simAdvance(SIM_CORE_CLOCK / 500);
+	PROFILE_CALL("dacDDSSetFrequency", rate = dacDDSSetFrequency(&dds, 2000000));
+	CHECK((rate > 1999000) && (rate < 2001000));
+	simAdvance(SIM_CORE_CLOCK / 500);
+	CALL(dacDDSStop, (&dds));
+	simDACListener(0);
+	CHECK((dacSamples >= 128) && (dacSamples <= 136)); // Plus the trigger periods spent inside the stepped calls
+	CHECK((dds.stream.overruns == 0) && (dds.stream.errors == 0));
+
+	// The refill loop (the cost per sample __dacDDSFill refers to)
+	uint32_t phase = dds.phase;
+	CALL(__dacDDSFill, (&dds, ddsBlock, 256));
+	CHECK(ddsBlock[0] == WAVE_SINE256[phase >> dds.shift]);
+	CHECK(ddsBlock[255] == WAVE_SINE256[(phase + 255 * dds.increment) >> dds.shift]);
+	CHECK(dds.phase == phase + 256 * dds.increment);
+}
+
+static void __benchDMAStream() {
+	// Paced circular stream (TIM17 update requests every 4 uS), 64 transfers per pass for 1 ms
+	DMAStream_TypeDef stream;
+	dmaHalves = 0;
+	CALL(init_DMAController, ());
+	CHECK(dmaChannelClaim(1, DMA_REQUEST_TIM17));
+	CALL(init_DMAStream, (&stream, 1, (uint32_t)&dmaSink, (uint32_t)dmaBuffer, 64, DMA_PRIORITY_LOW, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD, dmaConsumer, 1));
+	__benchPacedTimer(4);
+	simAdvance(SIM_CORE_CLOCK / 1000);
+	stopTimer(TIM17);
+	TIM17->DIER &= ~TIM_DIER_UDE;
+	CALL(dmaStreamStop, (&stream));
+	CHECK((dmaHalves >= 6) && (dmaHalves <= 9)); // 250 transfers plus the periods spent in the stepped calls, a half every 32
+	CHECK((stream.overruns == 0) && (stream.errors == 0));
+	volatile uint32_t address = 0;
+	PROFILE_CALL("dmaStreamHalfAddress", address = dmaStreamHalfAddress(&stream, DMA_STREAM_HALF_SECOND));
+	CHECK(address == (uint32_t)(dmaBuffer + 32));
+	CALL(dmaStreamRelease, (&stream, DMA_STREAM_HALF_SECOND));
+	dmaChannelFree(1);
+}
+
+static void __benchDMAScatterGather() {
+	// Three segment list (one empty) paced by TIM17 every 4 uS, run 4 times
+	DMASegment_TypeDef segments[3] = {
+		{(uint32_t)dmaBuffer, 16},
+		{(uint32_t)(dmaBuffer + 16), 0},
+		{(uint32_t)(dmaBuffer + 32), 32}
+	};
+	DMAScatterGather_TypeDef list;
+	dmaListsDone = 0;
+	CHECK(dmaChannelClaim(1, DMA_REQUEST_TIM17));
+	__benchPacedTimer(4);
+	for (int i = 0; i < 4; i++) {
+		CALL(dmaScatterGatherStart, (&list, 1, (uint32_t)&dmaSink, segments, 3, DMA_PRIORITY_LOW, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD, dmaListDone, 1));
+		simAdvance(60 * 4 * 48); // 48 transfers, with margin
+		CHECK(list.status == DMA_LIST_COMPLETE);
+	}
+	stopTimer(TIM17);
+	TIM17->DIER &= ~TIM_DIER_UDE;
+	CHECK(dmaListsDone == 4);
+	CHECK(dmaSink == dmaBuffer[63]);
+	dmaChannelFree(1);
+}
+
+static void __benchDMAFill() {
+	// Direct fill, then queued copies and fills through the copy engine
+	static uint32_t block[256];
+	static const uint32_t pattern = 0xA5A5A5A5;
+	static DMACopyRequest_TypeDef requests[6]; // Static: fills read their pattern from the request
+	volatile uint32_t value = 0;
+	CALL(dmaMemFill, (4, &pattern, (uint32_t)block, 256, DMA_TRANSFERSIZE_WORD, DMA_PRIORITY_LOW));
+	simAdvance(256 * SIM_DMA_TRANSFER_CYCLES);
+	CHECK(block[255] == pattern);
+	CALL(dmaChannelDisable, (4));
+
+	CALL(init_DMACopyEngine, (5, DMA_PRIORITY_LOW, 2));
+	for (int i = 0; i < 6; i++) {
+		requests[i].status = DMA_COPY_COMPLETE;
+	}
+	for (int i = 0; i < 3; i++) {
+		PROFILE_CALL("dmaFillQueue", value = dmaFillQueue(&requests[2 * i], (uint32_t)(block + (64 * i)), (uint32_t)i, 64, DMA_TRANSFERSIZE_WORD, 0));
+		CHECK(value);
+		PROFILE_CALL("dmaCopyQueue", value = dmaCopyQueue(&requests[(2 * i) + 1], (uint32_t)(block + (64 * i)), (uint32_t)(block + 192), 64, DMA_TRANSFERSIZE_WORD, 0));
+		CHECK(value);
+	}
+	simAdvance(6 * 80 * SIM_DMA_TRANSFER_CYCLES);
+	PROFILE_CALL("dmaCopyPending", value = dmaCopyPending());
+	CHECK(value == 0);
+	PROFILE_CALL("dmaCopyStatus", value = dmaCopyStatus(&requests[5]));
+	CHECK(value == DMA_COPY_COMPLETE);
+	PROFILE_CALL("dmaCopyErrorCount", value = dmaCopyErrorCount());
+	CHECK(value == 0);
+	CHECK(block[192] == 2);
+	CALL(dmaChannelDisable, (5));
+	CALL(dmaChannelFree, (5));
+}
+
+static void __benchDMAAllocation() {
+	// Allocation, remapping on conflict, lookups and release of peripheral channels
+	volatile uint8_t channel = 0;
+	volatile uint8_t remapped = 0;
+	volatile uint8_t owner = 0;
+	PROFILE_CALL("dmaChannelClaim", channel = dmaChannelClaim(1, DMA_REQUEST_ADC));
+	CHECK(channel);
+	PROFILE_CALL("dmaChannelAllocate", remapped = dmaChannelAllocate(DMA_REQUEST_TIM17)); // Channel 1 taken, remapped to 2
+	CHECK(remapped == 2);
+	PROFILE_CALL("dmaChannelAllocate", channel = dmaChannelAllocate(DMA_REQUEST_TIM17)); // Already owned
+	CHECK(channel == 0);
+	PROFILE_CALL("dmaRequestChannel", channel = dmaRequestChannel(DMA_REQUEST_TIM17));
+	CHECK(channel == 2);
+	PROFILE_CALL("dmaChannelOwner", owner = dmaChannelOwner(2));
+	CHECK(owner == DMA_REQUEST_TIM17);
+	PROFILE_CALL("dmaChannelOwnedBy", channel = dmaChannelOwnedBy(DMA_REQUEST_TIM17));
+	CHECK(channel == 2);
+	CALL(dmaChannelFree, (2));
+	CALL(dmaChannelFree, (1));
+	PROFILE_CALL("dmaChannelAllocate", channel = dmaChannelAllocate(DMA_REQUEST_TIM17)); // Back on its default channel
+	CHECK(channel == 1);
+	CALL(dmaChannelFree, (1));
+}
+
+static void __benchDMA() {
+	// Memory copies
+	static uint32_t source[256];
+	static uint32_t destination[256];
+	volatile uint8_t channel = 0;
+	CALL(init_DMAController, ());
+	PROFILE_CALL("dmaChannelAllocate", channel = dmaChannelAllocate(DMA_REQUEST_MEM2MEM));
+	CHECK(channel != 0);
+	for (int i = 0; i < 256; i++) {
+		source[i] = i;
+	}
+	CALL(dmaMemCopy, (channel, (uint32_t)source, (uint32_t)destination, 256, DMA_TRANSFERSIZE_WORD, DMA_PRIORITY_LOW));
+	simAdvance(256 * SIM_DMA_TRANSFER_CYCLES);
+	CHECK(destination[255] == 255);
+	CALL(dmaChannelDisable, (channel));
+	CALL(dmaChannelFree, (channel));
+}
+
+static void __benchLCD() {
+	// LCD full-screen refresh
+	CALL(init_LCD, ());
+	for (int i = 0; i < 4; i++) {
+		CALL(lcdWrite, ("STM32F0 Utility", "UCT dev board  "));
+	}
+	CALL(lcdCommand, (LCD_CLEAR_DISPLAY));
+	CALL(lcdCursorPosition, (2, 0));
+	for (int i = 0; i < 16; i++) {
+		CALL(lcdPlaceChar, ('0' + i));
+	}
+}
+
+static void __benchRun() {
+	// Runs every workload, each bracketed as a whole as well
+	PROFILE_CALL("[gpio]", __benchGPIO());
+	PROFILE_CALL("[timers]", __benchTimers());
+	PROFILE_CALL("[adc]", __benchADC());
+	PROFILE_CALL("[adc conversions]", __benchADCConversions());
+	PROFILE_CALL("[adc scan]", __benchADCScan());
+	PROFILE_CALL("[eeprom page]", __benchEEPROMPage());
+	PROFILE_CALL("[temperature polling]", __benchTemperature());
+	PROFILE_CALL("[dac playback]", __benchDAC());
+	PROFILE_CALL("[dac waveforms]", __benchDACWaveforms());
+	PROFILE_CALL("[dac packed playback]", __benchDACPacked());
+	PROFILE_CALL("[dac dds]", __benchDACDDS());
+	PROFILE_CALL("[dma copy]", __benchDMA());
+	PROFILE_CALL("[dma stream]", __benchDMAStream());
+	PROFILE_CALL("[dma scatter-gather]", __benchDMAScatterGather());
+	PROFILE_CALL("[dma fill]", __benchDMAFill());
+	PROFILE_CALL("[dma allocation]", __benchDMAAllocation());
+	PROFILE_CALL("[lcd refresh]", __benchLCD());
+}
+
+static int __benchLoadBudgets(const char* path) {
+	// Reads the budget file (function,cycles per line after the header)
+	FILE* file = fopen(path, "r");
+	if (file == 0) {
+		return 0;
+	}
+	char line[128];
+	while (fgets(line, sizeof(line), file) && (budgetCount < BENCH_MAX_BUDGETS)) {
+		char* comma = strrchr(line, ',');
+		if ((comma == 0) || (strncmp(line, "function,", 9) == 0)) {
+			continue; // Header or blank line
+		}
+		*comma = 0;
+		strncpy(budgets[budgetCount].name, line, sizeof(budgets[budgetCount].name) - 1);
+		budgets[budgetCount].cycles = strtoull(comma + 1, 0, 10);
+		budgetCount++;
+	}
+	fclose(file);
+	return 1;
+}
+
+static const BenchBudget_TypeDef* __benchBudget(const char* name) {
+	// Returns the budget of a function or workload (0 if none is recorded)
+	for (uint8_t i = 0; i < budgetCount; i++) {
+		if (strcmp(budgets[i].name, name) == 0) {
+			return &budgets[i];
+		}
+	}
+	return 0;
+}
+
+static uint64_t __benchCyclesPerCall(const ProfileFunction_TypeDef* function) {
+	// Returns the mean cycles of a call, rounded up
+	return (function->total.cycles + function->calls - 1) / function->calls;
+}
+
+int main(int argc, char** argv) {
+	int record = 0;
+	uint32_t tolerance = BENCH_TOLERANCE;
+	const char* path = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-r") == 0) {
+			record = 1;
+		}
+		else if ((strcmp(argv[i], "-t") == 0) && ((i + 1) < argc)) {
+			tolerance = (uint32_t)strtoul(argv[++i], 0, 10);
+		}
+		else {
+			path = argv[i];
+		}
+	}
+	if (path == 0) {
+		fprintf(stderr, "usage: sim_bench [-r] [-t percent] budgets.csv\n");
+		return 1;
+	}
+	if (!record && !__benchLoadBudgets(path)) {
+		perror(path);
+		return 1;
+	}
+
+	simInit();
+	simBoardDevices();
+	profileInit();
+	simInstructionStepping(1);
+	__benchRun();
+	simInstructionStepping(0);
+	profileStop();
+
+	if (record) {
+		FILE* file = fopen(path, "w");
+		if (file == 0) {
+			perror(path);
+			return 1;
+		}
+		fprintf(file, "function,cycles\n");
+		for (uint8_t i = 0; i < profileFunctionCount(); i++) {
+			fprintf(file, "%s,%llu\n", profileFunction(i)->name, (unsigned long long)__benchCyclesPerCall(profileFunction(i)));
+		}
+		fclose(file);
+		printf("sim_bench: %u budgets recorded in %s, %d failure(s)\n", profileFunctionCount(), path, failures);
+		return failures;
+	}
+
+	printf("%-32s %6s %12s %12s\n", "function", "calls", "cycles/call", "budget");
+	for (uint8_t i = 0; i < profileFunctionCount(); i++) {
+		const ProfileFunction_TypeDef* function = profileFunction(i);
+		const BenchBudget_TypeDef* budget = __benchBudget(function->name);
+		uint64_t cycles = __benchCyclesPerCall(function);
+		const char* status = "";
+		if (budget == 0) {
+			status = "FAIL (no budget)";
+			failures++;
+		}
+		else if ((cycles * 100) > (budget->cycles * (100 + tolerance))) {
+			status = "FAIL (slower)";
+			failures++;
+		}
+		else if (cycles < budget->cycles) {
+			status = "faster";
+		}
+		printf("%-32s %6u %12llu %12llu %s\n", function->name, function->calls, (unsigned long long)cycles,
+			(unsigned long long)(budget ? budget->cycles : 0), status);
+	}
+	printf("sim_bench: %d failure(s), %llu cycles\n", failures, (unsigned long long)simCycles());
+	return failures;
+}
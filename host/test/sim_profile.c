@@ -0,0 +1,163 @@
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Program: sim_profile (host build)
+Calls the public API of every module against the peripheral models (UCT development board devices attached) and reports the
+register reads, writes, read-modify-writes, polling iterations and simulated cycles of each function (see STM32F0_PROFILE.h)
+
+Usage: sim_profile [-j] [output]
+-j writes JSON instead of CSV, the report goes to stdout unless an output file is given
+Keep the call sequence stable: reports are meant to be diffed between library revisions
+
+*/
+
+/* INCLUDES */
+
+#include <string.h>
+
+#ifndef STM32F0_OTHER_H
+#include "STM32F0_OTHER.h"
+#define STM32F0_OTHER_H
+#endif
+
+#ifndef STM32F0_PROFILE_H
+#include "STM32F0_PROFILE.h"
+#define STM32F0_PROFILE_H
+#endif
+
+#ifndef STM32F0_UCTDEV_H
+#include "STM32F0_UCTDEV.h"
+#define STM32F0_UCTDEV_H
+#endif
+
+/* CONSTANT DEFINITIONS */
+
+#define CALL(function, arguments) PROFILE_CALL(#function, function arguments) // Profiles a call whose result is not needed
+
+/* GLOBAL VARIABLES */
+
+static uint16_t wave[8] = {0, 512, 1024, 1536, 2048, 2560, 3072, 3584}; // Static: handed to the DMA
+static uint32_t copySource[64];
+static uint32_t copyDestination[64];
+
+/* FUNCTIONS */
+
+void pinInterruptTriggered(IOPin_TypeDef* iopin) {
+	// Pin interrupts are not used
+}
+
+static void __profileWorkload() {
+	// Calls each function of the public API at least once
+	volatile uint32_t result; // Keeps results alive
+	char temperature;
+	ADCInput_TypeDef input;
+	DACHandle_TypeDef handle;
+
+	// GPIO
+	CALL(init_STD_GPIO, ());
+	CALL(pinMode, (PB0, GPIO_OUTPUT));
+	CALL(pinState, (SW0, GPIO_PULLUP));
+	CALL(pinOutputType, (PB0, GPIO_PUSH_PULL));
+	CALL(afSelect, (EEPROM_SCK, GPIO_AF0));
+	CALL(digitalWrite, (PB0, HIGH));
+	CALL(digitalWrite, (PB0, LOW));
+	PROFILE_CALL("digitalRead", result = digitalRead(SW0));
+	CALL(ledWrite, (0xA5));
+
+	// Interrupts
+	CALL(init_SYSCFG, ());
+	CALL(pinInterruptEnable, (SW1, 0, 1, 0));
+
+	// Timers
+	CALL(init_timer, (TIM14, 47));
+	CALL(startTimer, (TIM14, 1000));
+	PROFILE_CALL("timerComplete", result = timerComplete(TIM14));
+	CALL(stopTimer, (TIM14));
+	PROFILE_CALL("startRateTimer", result = startRateTimer(TIM14, 8000));
+	CALL(stopTimer, (TIM14));
+	CALL(configure_PWM, (TIM2));
+	CALL(pwmEnable, (TIM2, 3));
+	CALL(pwmWrite, (TIM2, 3, 128));
+
+	// ADC
+	CALL(init_ADC, (ADC_12BIT));
+	PROFILE_CALL("analogRead", result = analogRead(POT0));
+	PROFILE_CALL("analogReadChannel", result = analogReadChannel(ADC_CHANNEL_TEMPERATURE));
+	CALL(adcInputInit, (&input, POT1));
+	PROFILE_CALL("adcInputRead", result = adcInputRead(&input));
+
+	// DAC
+	CALL(init_DAC, (1, 0, 0, 0));
+	CALL(dacValueOut, (1, 0x800, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN));
+	CALL(dacValueOut, (1, 0x40, DAC_MODE_8BIT | DAC_MODE_RIGHTALIGN));
+	CALL(dacHandleInit, (&handle, 1, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN));
+	CALL(dacHandleWrite, (&handle, 0x123));
+	CALL(dacDMAWaveGen, (1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 8, 100));
+	CALL(dacDMAWaveSetTable, (1, wave, 8));
+	CALL(dacDMAWaveGenDisable, (1));
+	PROFILE_CALL("dacDMATriggeredWaveGen", result = dacDMATriggeredWaveGen(1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 8, DAC_TRIGGER_TIM6, 8000));
+	CALL(dacDMATriggeredWaveGenDisable, (1));
+
+	// DMA
+	CALL(init_DMAController, ());
+	PROFILE_CALL("dmaChannelAllocate", result = dmaChannelAllocate(DMA_REQUEST_MEM2MEM));
+	CALL(dmaMemCopy, (result, (uint32_t)copySource, (uint32_t)copyDestination, 64, DMA_TRANSFERSIZE_WORD, DMA_PRIORITY_LOW));
+	simAdvance(64 * SIM_DMA_TRANSFER_CYCLES);
+	CALL(dmaChannelDisable, (result));
+	CALL(dmaChannelFree, (result));
+
+	// SPI EEPROM
+	CALL(init_EEPROM, ());
+	CALL(eepromWrite, (0x0010, 0xA5));
+	PROFILE_CALL("eepromRead", result = eepromRead(0x0010));
+	CALL(spiTransmitFrame, (SPI2, 0x00));
+	PROFILE_CALL("spiReceiveFrame", result = spiReceiveFrame(SPI2));
+
+	// I2C temperature sensor
+	CALL(init_tempSensor, ());
+	PROFILE_CALL("tempSensorRead", result = tempSensorRead());
+	CALL(i2cReadFromSlave, (I2C2, &temperature, 1, I2C_7BIT_ADDRESSING, TS_READ_ADDRESS, TS_READ_ADDRESS, 0x00));
+
+	// LCD
+	CALL(init_LCD, ());
+	CALL(lcdCommand, (LCD_CLEAR_DISPLAY));
+	CALL(lcdCursorPosition, (2, 4));
+	CALL(lcdPlaceChar, ('A'));
+	CALL(lcdWriteString, ("UCT"));
+	CALL(lcdWrite, ("STM32F0", "Utilities"));
+}
+
+int main(int argc, char** argv) {
+	uint8_t format = PROFILE_FORMAT_CSV;
+	const char* output = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0) {
+			format = PROFILE_FORMAT_JSON;
+		}
+		else {
+			output = argv[i];
+		}
+	}
+
+	simInit();
+	simBoardDevices();
+	profileInit();
+	__profileWorkload();
+	profileStop();
+
+	FILE* file = (output ? fopen(output, "w") : stdout);
+	if (file == 0) {
+		perror(output);
+		return 1;
+	}
+	profileReport(file, format);
+	if (output) {
+		fclose(file);
+	}
+	return 0;
+}
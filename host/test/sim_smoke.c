@@ -0,0 +1,337 @@
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Test: sim_smoke (host build)
+Runs the library against the peripheral models: GPIO, EXTI interrupts, timers, ADC, DAC (direct and timer triggered DMA), DMA memory copy,
+the SPI EEPROM and the I2C temperature sensor of the UCT development board
+Built with DMA_STATISTICS (make check-statistics) it also checks the DMA transfer counters
+Exits with the number of failed checks
+
+*/
+
+/* INCLUDES */
+
+#include <stdio.h>
+
+#ifndef STM32F0_OTHER_H
+#include "STM32F0_OTHER.h"
+#define STM32F0_OTHER_H
+#endif
+
+#ifndef STM32F0_SIM_H
+#include "STM32F0_SIM.h"
+#define STM32F0_SIM_H
+#endif
+
+#ifndef STM32F0_UCTDEV_H
+#include "STM32F0_UCTDEV.h"
+#define STM32F0_UCTDEV_H
+#endif
+
+/* CONSTANT DEFINITIONS */
+
+#define CHECK(condition) __check((condition), #condition, __LINE__)
+
+/* GLOBAL VARIABLES */
+
+static int failures = 0;
+static volatile int pinInterrupts = 0;
+static uint8_t eepromMemory[EEPROM_MEM_SIZE];
+static uint32_t dacSamples = 0;
+static uint16_t wave[8] = {0, 512, 1024, 1536, 2048, 2560, 3072, 3584}; // Static: handed to the DMA
+static uint16_t swapWave[8] = {100, 200, 300, 400, 500, 600, 700, 800};
+static uint16_t dacHistory[32]; // DAC output values seen by the listener
+static uint16_t streamBuffer[32];
+static uint32_t streamSamples = 0;
+static uint32_t copySource[16];
+static uint32_t copyDestination[16];
+static DMACopyRequest_TypeDef copyRequest;
+
+/* FUNCTIONS */
+
+static void __check(int condition, const char* text, int line) {
+	// Records a failed check
+	if (!condition) {
+		printf("FAIL line %d: %s\n", line, text);
+		failures++;
+	}
+}
+
+void pinInterruptTriggered(IOPin_TypeDef* iopin) {
+	// Counts GPIO pin interrupts
+	pinInterrupts++;
+}
+
+static uint16_t eepromDevice(SPI_TypeDef* spi, uint16_t mosi, uint8_t bits) {
+	// CAT25040-style EEPROM: WREN, single byte READ/WRITE with a 16 bit address (chip select on PB12)
+	static uint8_t command, phase, writeEnabled;
+	static uint16_t address;
+	if (simGpioOutput(GPIOB) & (1 << 12)) {
+		return 0xFF; // Not selected
+	}
+	uint16_t miso = 0xFF;
+	if (phase == 0) {
+		command = mosi;
+	}
+	else if (phase == 1) {
+		address = mosi << 8;
+	}
+	else if (phase == 2) {
+		address |= mosi;
+	}
+	else if ((command == EEPROM_WRITE) && writeEnabled) {
+		eepromMemory[address % EEPROM_MEM_SIZE] = mosi;
+		writeEnabled = 0;
+	}
+	else if (command == EEPROM_READ) {
+		miso = eepromMemory[address % EEPROM_MEM_SIZE];
+	}
+	phase++;
+	if (command == EEPROM_WREN) {
+		writeEnabled = 1;
+		phase = 0;
+	}
+	else if (phase == 4) {
+		phase = 0; // Instruction complete
+	}
+	return miso;
+}
+
+static int tempStart(I2C_TypeDef* i2c, uint8_t address, int read) {
+	// TC74 temperature sensor at 0x48
+	return address == TS_READ_ADDRESS;
+}
+
+static int tempWrite(I2C_TypeDef* i2c, uint8_t data) {
+	// Register pointer
+	return 1;
+}
+
+static uint8_t tempRead(I2C_TypeDef* i2c) {
+	// Temperature register (25 degrees)
+	return 25;
+}
+
+static SimI2CDevice_TypeDef tempSensor = {tempStart, tempWrite, tempRead, 0};
+
+static void dacCounter(uint8_t channel, uint16_t value, uint64_t cycle) {
+	// Counts (and records) DAC output updates
+	if (dacSamples < 32) {
+		dacHistory[dacSamples] = value;
+	}
+	dacSamples++;
+}
+
+static uint16_t streamSource(uint16_t* samples, uint16_t count) {
+	// Endless ramp
+	for (uint16_t i = 0; i < count; i++) {
+		samples[i] = (streamSamples++ * 64) & 0xFFF;
+	}
+	return count;
+}
+
+int main() {
+	simInit();
+
+	// GPIO
+	init_STD_GPIO();
+	pinMode(PB0, GPIO_OUTPUT);
+	digitalWrite(PB0, HIGH);
+	CHECK(simGpioOutput(GPIOB) & 0x1);
+	CHECK(digitalRead(PB0) == HIGH);
+	digitalWrite(PB0, LOW);
+	CHECK(!(simGpioOutput(GPIOB) & 0x1));
+	pinMode(SW0, GPIO_INPUT);
+	pinState(SW0, GPIO_PULLUP);
+	CHECK(digitalRead(SW0) == HIGH);
+	simGpioInput(GPIOA, 0, 0);
+	CHECK(digitalRead(SW0) == LOW);
+	simGpioInput(GPIOA, 0, SIM_GPIO_RELEASE);
+
+	// EXTI interrupt on a falling edge of SW1
+	pinMode(SW1, GPIO_INPUT);
+	pinState(SW1, GPIO_PULLUP);
+	pinInterruptEnable(SW1, 0, 1, 0);
+	simGpioInput(GPIOA, 1, 0);
+	simAdvance(100);
+	CHECK(pinInterrupts == 1);
+	simGpioInput(GPIOA, 1, 1);
+	simAdvance(100);
+	CHECK(pinInterrupts == 1);
+
+	// Timer (1 us ticks, 1000 ticks)
+	init_timer(TIM14, 47);
+	startTimer(TIM14, 1000);
+	simAdvance(47000);
+	CHECK(!timerComplete(TIM14));
+	simAdvance(2000);
+	CHECK(timerComplete(TIM14));
+
+	// ADC
+	init_ADC(ADC_12BIT);
+	simAdcInput(5, 0x123);
+	CHECK(analogRead(POT0) == 0x123);
+	simAdcInput(6, 0xABC);
+	CHECK(analogRead(POT1) == 0xABC);
+
+	// DAC
+	init_DAC(1, 0, 0, 0);
+	dacValueOut(1, 0x800, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN);
+	CHECK(simDACOutput(1) == 0x800);
+	dacValueOut(1, 0x40, DAC_MODE_8BIT | DAC_MODE_RIGHTALIGN);
+	CHECK(simDACOutput(1) == 0x400);
+
+	// DMA memory copy
+	for (int i = 0; i < 16; i++) {
+		copySource[i] = 0x1000 + i;
+		copyDestination[i] = 0;
+	}
+	init_DMAController();
+	dmaMemCopy(1, (uint32_t)copySource, (uint32_t)copyDestination, 16, DMA_TRANSFERSIZE_WORD, DMA_PRIORITY_LOW);
+	simAdvance(16 * SIM_DMA_TRANSFER_CYCLES);
+	CHECK(copyDestination[15] == 0x100F);
+	CHECK(DMA1->ISR & DMA_ISR_TCIF1);
+	dmaChannelDisable(1);
+	CHECK(!(DMA1->ISR & DMA_ISR_GIF1)); // Nothing left to fire when the channel's interrupts are enabled next
+
+	// Completion interrupt enabled on a channel without a handler: acknowledged by the dispatcher instead of firing forever
+	dmaInterruptConfig(4, DMA_INTERRUPT_TRANSFERCOMPLETE, 3);
+	dmaMemCopy(4, (uint32_t)copySource, (uint32_t)copyDestination, 16, DMA_TRANSFERSIZE_WORD, DMA_PRIORITY_LOW);
+	simAdvance(20 * SIM_DMA_TRANSFER_CYCLES);
+	CHECK(copyDestination[15] == 0x100F);
+	CHECK(!(DMA1->ISR & DMA_ISR_GIF4));
+	dmaChannelDisable(4);
+	dmaInterruptConfig(4, 0, 3);
+	nvicDisableInterrupt(DMA1_Channel4_5_IRQn);
+
+	// Queued copies: a request still in progress is rejected and keeps its status
+	init_DMACopyEngine(1, DMA_PRIORITY_LOW, 3);
+	CHECK(dmaCopyQueue(&copyRequest, (uint32_t)copySource, (uint32_t)copyDestination, 16, DMA_TRANSFERSIZE_WORD, 0) == 1);
+	CHECK(dmaCopyQueue(&copyRequest, (uint32_t)copyDestination, (uint32_t)copySource, 16, DMA_TRANSFERSIZE_WORD, 0) == 0);
+	CHECK(dmaCopyStatus(&copyRequest) == DMA_COPY_ACTIVE);
+	uint8_t copyChannel = dmaChannelAllocate(DMA_REQUEST_MEM2MEM);
+	CHECK((copyChannel != 0) && (copyChannel != 1)); // A second memory-to-memory user gets its own channel
+	dmaChannelFree(copyChannel);
+	simAdvance(20 * SIM_DMA_TRANSFER_CYCLES);
+	CHECK(dmaCopyStatus(&copyRequest) == DMA_COPY_COMPLETE);
+	CHECK(dmaCopyPending() == 0);
+	CHECK(copySource[0] == 0x1000);
+	dmaChannelDisable(1);
+	dmaChannelFree(1);
+
+	// A request that already owns a channel is not handed (and remapped to) a second one
+	uint8_t timerChannel = dmaChannelAllocate(DMA_REQUEST_TIM17);
+	CHECK(timerChannel == 1);
+	CHECK(dmaChannelAllocate(DMA_REQUEST_TIM17) == 0);
+	CHECK(dmaRequestChannel(DMA_REQUEST_TIM17) == timerChannel);
+	CHECK(dmaChannelOwnedBy(DMA_REQUEST_TIM17) == timerChannel);
+	dmaChannelFree(timerChannel);
+	CHECK(dmaChannelOwnedBy(DMA_REQUEST_TIM17) == 0);
+
+	// DAC stream refilled from the DMA half/full transfer interrupts (16 kHz, 4 ms)
+	DACStream_TypeDef player;
+	streamSamples = 0;
+	CHECK(dacStreamStart(&player, streamBuffer, 32, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, streamSource, DAC_TRIGGER_TIM6, 16000, 1) != 0);
+	simAdvance(SIM_CORE_CLOCK / 250);
+	CHECK(streamSamples == (32 + 64)); // Primed buffer + one refill per played half
+	CHECK(dacStreamUnderruns(&player) == 0);
+	dacStreamStop(&player);
+
+	// Timer triggered DAC DMA playback (8 kHz, 1 ms)
+	simDACListener(dacCounter);
+	dacSamples = 0;
+	CHECK(dacDMATriggeredWaveGen(1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 8, DAC_TRIGGER_TIM6, 8000) != 0);
+	simAdvance(SIM_CORE_CLOCK / 1000);
+	CHECK((dacSamples >= 7) && (dacSamples <= 9));
+	CHECK(!(DAC->SR & DAC_SR_DMAUDR1));
+	CHECK(dacStreamStart(&player, streamBuffer, 32, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, streamSource, DAC_TRIGGER_TIM6, 16000, 1) == 0); // DMA channel 3 is taken
+	dacDMATriggeredWaveGenDisable(1);
+	simDACListener(0);
+
+	// A stream on the channel the playback left behind starts clean (no stale half/full transfer flags handed over)
+	streamSamples = 0;
+	CHECK(dacStreamStart(&player, streamBuffer, 32, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, streamSource, DAC_TRIGGER_TIM6, 16000, 1) != 0);
+	simAdvance(SIM_CORE_CLOCK / 250);
+	CHECK(streamSamples == (32 + 64));
+	CHECK(dacStreamUnderruns(&player) == 0);
+	nvicDisableInterrupt(DMA1_Channel2_3_IRQn); // Hold off the refills for more than a whole buffer
+	simAdvance(SIM_CORE_CLOCK / 400);
+	nvicEnableInterrupt(DMA1_Channel2_3_IRQn);
+	simAdvance(100);
+	CHECK(dacStreamUnderruns(&player) != 0); // Late refill, the first half has already been replayed
+	dacStreamStop(&player);
+
+	// DMA waveform table swap at the end of a pass (100 us per sample, swapped mid-pass after the table has wrapped)
+	dacDMAWaveGen(1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 8, 100);
+	simAdvance(SIM_CORE_CLOCK / 800); // 1.25 ms, into the second pass
+	simDACListener(dacCounter);
+	dacSamples = 0;
+	dacDMAWaveSetTable(1, swapWave, 8);
+	simAdvance(SIM_CORE_CLOCK / 1000);
+	simDACListener(0);
+	int swapIndex = 0;
+	while ((swapIndex < 10) && (dacHistory[swapIndex] != swapWave[0])) {
+		swapIndex++;
+	}
+	CHECK((swapIndex > 0) && (swapIndex < 10) && (dacHistory[swapIndex - 1] == wave[7])); // The old table finishes its pass first
+
+	// Restarting waveform generation reuses its DMA channel and applies the new period, disabling releases it
+	dacDMAWaveGen(1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 8, 50);
+	dacDMAWaveGen(1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 8, 20);
+	CHECK(TIM17->ARR == 19);
+	CHECK(dmaRequestChannel(DMA_REQUEST_TIM17) == 1);
+	CHECK(dmaChannelOwner(2) == DMA_REQUEST_NONE);
+	dacDMAWaveGenDisable(1);
+	CHECK(dmaChannelOwnedBy(DMA_REQUEST_TIM17) == 0);
+	CHECK(!(DMA1_Channel1->CCR & DMA_CCR_EN));
+
+#ifdef DMA_STATISTICS
+	// Completions of a circular channel without a handler are counted once its statistics are enabled (20 us per sample, 8 samples per pass, 1 ms)
+	dacDMAWaveGen(1, wave, DAC_MODE_12BIT | DAC_MODE_RIGHTALIGN, 8, 20);
+	uint8_t waveChannel = dmaRequestChannel(DMA_REQUEST_TIM17);
+	dmaStatisticsReset(waveChannel);
+	dmaStatisticsEnable(waveChannel, 3);
+	simAdvance(SIM_CORE_CLOCK / 1000);
+	DMAStatistics_TypeDef statistics;
+	dmaStatisticsGet(waveChannel, &statistics);
+	CHECK((statistics.transfersCompleted >= 5) && (statistics.transfersCompleted <= 7));
+	CHECK(statistics.bytesMoved == (statistics.transfersCompleted * 16));
+	dmaStatisticsDisable(waveChannel);
+	CHECK(!(DMA1_Channel1->CCR & DMA_CCR_TCIE));
+	dacDMAWaveGenDisable(1);
+#endif
+
+	// Busy-wait delays only cost time while instruction stepping
+	uint64_t start = simCycles();
+	__cpuHoldDelay(10);
+	CHECK(simCycles() == start);
+	simInstructionStepping(1);
+	__cpuHoldDelay(10);
+	simInstructionStepping(0);
+	CHECK(simCycles() > (start + 40));
+
+	// SPI EEPROM
+	simSPIDevice(SPI2, eepromDevice);
+	init_EEPROM();
+	eepromWrite(0x0010, 0xA5);
+	CHECK(eepromMemory[0x10] == 0xA5);
+	CHECK(eepromRead(0x0010) == 0xA5);
+
+	// I2C temperature sensor
+	simI2CDevice(I2C2, &tempSensor);
+	init_tempSensor();
+	CHECK(tempSensorRead() == 25);
+
+	CHECK(simUnhandledInterrupts() == 0);
+
+	SimStats_TypeDef stats = simStats();
+	printf("sim_smoke: %d failure(s), %llu cycles, %llu reads, %llu writes, %llu interrupts, %llu DMA transfers\n", failures,
+		(unsigned long long)stats.cycles, (unsigned long long)stats.reads, (unsigned long long)stats.writes,
+		(unsigned long long)stats.interrupts, (unsigned long long)stats.dmaTransfers);
+	return failures;
+}
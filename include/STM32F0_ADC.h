@@ -34,6 +34,21 @@ Functions to use the analog to digital converter
 #define STM32F0_OTHER_H
 #endif
 
+#ifndef STM32F0_TIM_H
+#include "STM32F0_TIM.h"
+#define STM32F0_TIM_H
+#endif
+
+#ifndef STM32F0_DMA_H
+#include "STM32F0_DMA.h"
+#define STM32F0_DMA_H
+#endif
+
+#ifndef STM32F0_INTERRUPTS_H
+#include "STM32F0_INTERRUPTS.h"
+#define STM32F0_INTERRUPTS_H
+#endif
+
 /* CONSTANT DEFINITIONS */
 // ADC resolutions
 #define ADC_12BIT 0
@@ -41,8 +56,120 @@ Functions to use the analog to digital converter
 #define ADC_8BIT 2
 #define ADC_6BIT 3
 
+// ADC channels
+#define ADC_CHANNEL_COUNT 19
+#define ADC_CHANNEL_TEMPERATURE 16 // Internal temperature sensor
+#define ADC_CHANNEL_VREFINT 17 // Internal reference voltage
+#define ADC_CHANNEL_VBAT 18 // VBAT/2
+#define ADC_CHANNEL_MASK(channel) (1UL << (channel)) // CHSELR bit for a channel (combine with | for a scan)
+#define ADC_CHANNEL_NONE 0xFF // Channel is not part of a scan/pin has no ADC channel
+
+// Non-blocking conversion status (adcPoll)
+#define ADC_STATUS_IDLE 0 // No conversion started
+#define ADC_STATUS_BUSY 1 // Conversion in progress
+#define ADC_STATUS_COMPLETE 2 // Result returned
+
+// Interrupt callback events (combined with |)
+#define ADC_EVENT_CONVERSION 0x4 // A conversion completed (EOC)
+#define ADC_EVENT_SEQUENCE 0x8 // The conversion was the last of the sequence (EOSEQ)
+#define ADC_EVENT_OVERRUN 0x10 // A result was lost because the previous one had not been read (OVR)
+
+#define ADC_TIMEOUT 100 // Timeout of the blocking reads (uS), they return 0 if it expires
+#define ADC_POLL_CYCLES 16 // Estimated core clock cycles per result poll of the blocking reads (converts the timeout to a poll count using SystemCoreClock)
+
+// Pin to channel mapping (compile time, see adcPinChannel for run time)
+#define ADC_CHANNEL_PA0 0
+#define ADC_CHANNEL_PA1 1
+#define ADC_CHANNEL_PA2 2
+#define ADC_CHANNEL_PA3 3
+#define ADC_CHANNEL_PA4 4
+#define ADC_CHANNEL_PA5 5
+#define ADC_CHANNEL_PA6 6
+#define ADC_CHANNEL_PA7 7
+#define ADC_CHANNEL_PB0 8
+#define ADC_CHANNEL_PB1 9
+#define ADC_CHANNEL_PC0 10
+#define ADC_CHANNEL_PC1 11
+#define ADC_CHANNEL_PC2 12
+#define ADC_CHANNEL_PC3 13
+#define ADC_CHANNEL_PC4 14
+#define ADC_CHANNEL_PC5 15
+
+// Trigger sources (EXTSEL, each trigger converts the whole selected sequence)
+#define ADC_TRIGGER_TIM1 0x0 // TIM1 TRGO event
+#define ADC_TRIGGER_TIM2 0x2 // TIM2 TRGO event
+#define ADC_TRIGGER_TIM3 0x3 // TIM3 TRGO event
+#define ADC_TRIGGER_TIM15 0x4 // TIM15 TRGO event
+
+typedef struct {
+	// A type definition for an ADC scan (owned by the caller, must stay valid while scanning)
+	uint16_t* buffer; // Ring buffer of whole sequences (channels in ascending order)
+	uint16_t length; // Number of samples in the ring buffer
+	uint8_t channels; // Number of channels per sequence
+	uint8_t dmaChannel; // DMA channel moving the results
+	uint8_t rank[ADC_CHANNEL_COUNT]; // Position of each channel in a sequence (ADC_CHANNEL_NONE if not scanned)
+} ADCScan_TypeDef;
+
+typedef struct {
+	// A type definition for an analog input handle (channel resolved once by adcInputInit)
+	uint32_t channelMask; // CHSELR value selecting the channel (0 if the pin has no ADC channel)
+	uint8_t channel; // ADC channel (ADC_CHANNEL_NONE if the pin has no ADC channel)
+} ADCInput_TypeDef;
+
 /* FUNCTIONS */
 
 void init_ADC(int resolution); // Initialise and calibrate the ADC
 uint16_t analogRead(IOPin_TypeDef* iopin); // Read an analog value from a pin
-uint16_t analogReadChannel(int channel); // Read an analog value from a specific ADC channel
\ No newline at end of file
+uint16_t analogReadChannel(int channel); // Read an analog value from a specific ADC channel
+
+uint8_t adcStart(uint32_t channelMask); // Starts converting a set of channels without waiting, returns whether it was started (0 if the ADC is busy)
+uint8_t adcPoll(uint16_t* value); // Checks for the next result of a started conversion without waiting, returns ADC_STATUS_IDLE/BUSY/COMPLETE (value is written when complete)
+uint8_t adcReadTimeout(uint32_t channelMask, uint16_t* value, uint32_t timeout); // Converts a channel and waits at most timeout uS for the result, returns whether a result was read
+uint32_t adcOverruns(); // Returns the number of results lost to overruns (OVR) since initialisation
+
+void adcInterruptEnable(void (*callback)(uint8_t channel, uint16_t value, uint8_t events), uint8_t priority); // Delivers conversion results through a callback from the ADC interrupt (EOC/EOSEQ/OVR)
+/*
+NOTE: Start conversions with adcStart or adcTriggerStart afterwards, the callback runs once per converted channel (not usable together with a DMA scan)
+callback - called with the channel, its result and the ADC_EVENT_* flags (ADC_EVENT_OVERRUN alone with channel ADC_CHANNEL_NONE when a result is lost)
+priority - the interrupt priority from 0 (highest) to 3 (lowest)
+*/
+
+void adcInterruptDisable(); // Stops delivering conversion results through the ADC interrupt
+void ADC1_COMP_IRQHandler(); // Interrupt handler for the ADC (shared with the comparators)
+
+uint16_t __adcConvert(uint32_t channelMask); // Converts the selected channels and waits up to ADC_TIMEOUT for the first result (0 on timeout)
+void __adcCountOverrun(); // Counts and clears an overrun
+
+uint8_t adcPinChannel(IOPin_TypeDef* iopin); // Returns the ADC channel connected to a pin (ADC_CHANNEL_NONE if there is none)
+void adcInputInit(ADCInput_TypeDef* input, IOPin_TypeDef* iopin); // Resolves the ADC channel of a pin once for fast repeated reads
+uint16_t adcInputRead(const ADCInput_TypeDef* input); // Read an analog value through an analog input handle (0 if the pin has no ADC channel)
+
+uint8_t adcScanStart(ADCScan_TypeDef* scan, uint32_t channelMask, uint16_t* buffer, uint16_t depth); // Starts continuously scanning a set of channels, with DMA streaming the results into a ring buffer
+/*
+NOTE: Uses the ADC DMA request (DMA channel 1, or channel 2 if channel 1 is taken), the CPU is never involved once started
+scan - caller-owned scan state
+channelMask - the channels to scan, e.g. (ADC_CHANNEL_MASK(5) | ADC_CHANNEL_MASK(6) | ADC_CHANNEL_MASK(ADC_CHANNEL_TEMPERATURE))
+buffer - ring buffer holding depth * (number of channels) samples
+depth - the number of whole sequences the ring buffer holds
+Returns the DMA channel used (0 if the scan was not started)
+*/
+
+uint32_t adcScanStartTriggered(ADCScan_TypeDef* scan, uint32_t channelMask, uint16_t* buffer, uint16_t depth, uint8_t triggerSource, uint32_t sampleRate); // Starts scanning a set of channels at a fixed rate set by a timer trigger, with DMA streaming the results into a ring buffer
+/*
+NOTE: Same as adcScanStart, but each timer update starts one sequence so the sampling instants do not depend on the CPU (for filtering/FFT work)
+triggerSource - the timer to pace the sampling (ADC_TRIGGER_TIM1/TIM2/TIM3/TIM15, the timer is initialised and started)
+sampleRate - the requested sequence rate (Hz)
+Returns the achieved sequence rate in millihertz (0 if the scan was not started)
+*/
+
+uint32_t adcTriggerStart(uint8_t triggerSource, uint32_t sampleRate); // Starts conversions of the selected channels on every update of a timer, returns the achieved rate in millihertz (0 if not started)
+void adcTriggerStop(); // Stops timer triggered conversions (back to software started conversions)
+
+uint16_t adcScanRead(ADCScan_TypeDef* scan, uint8_t channel); // Returns the latest sample of a scanned channel (0 if the channel is not scanned)
+uint16_t adcScanPosition(ADCScan_TypeDef* scan); // Returns the index in the ring buffer the next sample will be written to
+void adcScanStop(ADCScan_TypeDef* scan); // Stops scanning and releases the DMA channel
+
+uint8_t __adcScanSetup(ADCScan_TypeDef* scan, uint32_t channelMask, uint16_t* buffer, uint16_t depth); // Selects the scan channels and starts the DMA ring buffer (ADC left stopped), returns the DMA channel (0 if not set up)
+TIM_TypeDef* __adcTriggerTimer(uint8_t triggerSource); // Returns the timer behind an ADC trigger source (0 if not a timer trigger)
+void __adcStop(); // Stops any ongoing conversions so the ADC can be reconfigured
+void __adcSelectChannels(uint32_t channelMask); // Selects the channels to convert and enables the internal channel sources they need
\ No newline at end of file
@@ -68,6 +68,71 @@ Functions for operating the Digital to Analog converter
 #define DAC_TRIGGER_EXTI 0x6 // EXTI line 9 interrupt event
 #define DAC_TRIGGER_SOFTWARE 0x7 // Software trigger
 
+// Hardware wave generation (noise/triangle)
+#define DAC_WAVE_NONE 0x0
+#define DAC_WAVE_NOISE 0x1 // LFSR noise, amplitude unmasks LFSR bits [0..amplitude]
+#define DAC_WAVE_TRIANGLE 0x2 // Triangle counting up/down on each trigger, peak amplitude (2^(amplitude + 1)) - 1
+#define DAC_WAVE_AMPLITUDE_MAX 11 // Largest amplitude setting (4095 / 12 LFSR bits)
+
+// Dual channel sample packing (channel 1 in the low half, channel 2 in the high half)
+#define DAC_DUAL_PACK(ch1Value, ch2Value) ((((uint32_t)(ch2Value)) << 16) | ((uint16_t)(ch1Value))) // 12 bit samples (right or left aligned) for DHR12RD/DHR12LD
+#define DAC_DUAL_PACK8(ch1Value, ch2Value) ((uint16_t)((((uint16_t)(ch2Value) & 0xFF) << 8) | ((uint8_t)(ch1Value)))) // 8 bit samples for DHR8RD
+
+// Packed waveform formats (see dacPackedWaveDecode, generated with tools/wavegen.c)
+#define DAC_PACKED_QUARTERWAVE 0x1 // First quarter period (length/4 + 1 samples), mirrored for the second quarter and reflected (reflect - sample) for the second half
+#define DAC_PACKED_DELTA 0x2 // Byte tokens: 0ddddddd adds a signed 7 bit delta, 10nnnnnn repeats the previous sample n+1 times, 11000000 LL HH sets an absolute sample
+#define DAC_PACKED_TOKEN_RUN 0x80
+#define DAC_PACKED_TOKEN_ABSOLUTE 0xC0
+
+// Interrupt priority used for waveform table swaps (must be serviced within one sample period)
+#define DAC_DMA_INTERRUPT_PRIORITY 0
+
+typedef struct {
+	// A type definition for a DAC output handle (channel and mode resolved once by dacHandleInit)
+	volatile uint32_t* dataRegister; // Data holding register for the channel and mode (0 if the handle is invalid)
+	uint16_t mask; // Valid data bits for the mode
+} DACHandle_TypeDef;
+
+typedef struct {
+	// A type definition for a DAC stream player (owned by the caller, must stay valid while playing)
+	DMAStream_TypeDef stream; // Double-buffered DMA stream feeding the DAC
+	uint16_t* buffer; // Ping-pong sample buffer
+	uint16_t length; // Number of samples in the buffer (both halves)
+	uint16_t (*source)(uint16_t* samples, uint16_t count); // Fills up to count samples, returns the number provided
+	uint16_t lastSample; // Last sample provided (held through underruns)
+	volatile uint32_t underruns; // Number of refills the source could not complete
+} DACStream_TypeDef;
+
+typedef struct {
+	// A type definition for a DDS generator (owned by the caller, must stay valid while playing)
+	DMAStream_TypeDef stream; // Double-buffered DMA stream feeding the DAC
+	const uint16_t* table; // Wavetable (power of 2 length, in the DAC mode format)
+	uint8_t shift; // Phase bits below the table index (32 - log2(table length))
+	uint32_t phase; // Phase accumulator, one table cycle per 2^32
+	volatile uint32_t increment; // Phase step per sample
+	uint32_t sampleRate; // Achieved sample rate (mHz)
+	uint16_t* buffer; // Ping-pong sample buffer
+	uint16_t length; // Number of samples in the buffer (both halves)
+} DACDDS_TypeDef;
+
+typedef struct {
+	// A type definition for a packed waveform (tools/wavegen.c emits a WAVE_<NAME>_PACKED initialiser)
+	uint8_t format; // DAC_PACKED_QUARTERWAVE or DAC_PACKED_DELTA
+	uint16_t length; // Number of samples in one decoded period (multiple of 4 for quarter wave)
+	uint16_t reflect; // Quarter wave: second half samples are (reflect - first half sample)
+	const void* data; // Quarter wave: uint16_t samples, delta: uint8_t tokens
+} DACPackedWave_TypeDef;
+
+typedef struct {
+	// A type definition for a packed waveform decoder (owned by the caller, must stay valid while playing)
+	DACStream_TypeDef player; // Stream the decoder feeds (dacPackedWaveStart)
+	const DACPackedWave_TypeDef* wave; // Waveform being decoded
+	const uint8_t* position; // Next delta token
+	uint16_t index; // Next sample of the period
+	uint16_t current; // Last delta sample
+	uint8_t repeat; // Remaining samples of a delta run
+} DACPackedDecoder_TypeDef;
+
 /* FUNCTIONS */
 void init_DAC(uint8_t channel, uint8_t buffer, uint8_t triggerEnable, uint8_t triggerSource); // Initialises and configures  DAC channel
 /*
@@ -86,6 +151,26 @@ value - the value to output on the DAC
 mode - 8/12 bit, left/right aligned
 */
 
+void dacHandleInit(DACHandle_TypeDef* handle, uint8_t channel, uint8_t mode); // Resolves the data holding register and data mask for a DAC channel and mode
+/*
+NOTE: Use with dacHandleWrite/dacHandleWriteRaw where dacValueOut is too slow (e.g. control loops at tens of kHz), init_DAC must still be called
+handle - caller-owned handle
+channel - the DAC channel to write to (an invalid channel leaves dataRegister at 0, the inline writes do not check it)
+mode - 8/12 bit, left/right aligned
+*/
+
+static inline void dacHandleWrite(const DACHandle_TypeDef* handle, uint16_t value) {
+	// Outputs an analog value through a DAC handle (mask and single store, no channel/mode branching)
+	*handle->dataRegister = (value & handle->mask);
+}
+
+static inline void dacHandleWriteRaw(const DACHandle_TypeDef* handle, uint16_t value) {
+	// Outputs an analog value already in the handle's mode format through a DAC handle (single store)
+	*handle->dataRegister = value;
+}
+
+void dacHandleWaveOut(const DACHandle_TypeDef* handle, uint16_t* values, uint16_t length); // Outputs a series of analog values in sequence through a DAC handle
+
 void dacWaveOut(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t length); // Outputs a series of analog values in sequence using the DAC
 /*
 channel - the DAC channel to output on
@@ -105,7 +190,9 @@ repetitions - the number of times to generate the waveform
 
 void dacDMAWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t length, uint16_t period); // Enables waveform generation using DMA (repeats forever...)
 /*
-NOTE: Uses DMA channel 2 and TIM17 for DAC channel 1 and DMA channel 3 and TIM16 for DAC channel 2
+NOTE: Uses TIM17 and its DMA channel (1, or 2 if remapped) for DAC channel 1 and TIM16 and its DMA channel (3, or 4 if remapped) for DAC channel 2
+DMA channels are taken from the channel allocator (dmaChannelAllocate), nothing is started if no channel is free
+Calling again while generating restarts on a freshly allocated channel with the new table and period
 channel - the DAC channel to output on
 values - a pointer to an array of analog values to output
 mode - 8/12 bit, left/right aligned
@@ -113,4 +200,156 @@ length - the number of values in the array
 period - the approximate delay between values (in microseconds)
 */
 
-void dacDMAWaveGenDisable(uint8_t channel); // Disables waveform generation using DMA
\ No newline at end of file
+void dacDMAWaveGenDisable(uint8_t channel); // Disables waveform generation using DMA (releases every DMA channel the timer request owns)
+
+uint32_t dacPacedWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t length, uint32_t repetitions, uint8_t triggerSource, uint32_t sampleRate); // Outputs a series of analog values multiple times using the DAC, paced by a timer trigger (CPU writes, no DMA)
+/*
+NOTE: Blocks until complete, for builds with no free DMA channel. The DAC trigger latches each sample on the timer update, so the sample timing does not depend on the compiler or flash wait states
+channel - the DAC channel to use
+values - a pointer to an array of analog values
+mode - 8/12 bit, left/right aligned
+length - the number of values in the array
+repetitions - the number of times to generate the waveform
+triggerSource - the timer to pace the output (DAC_TRIGGER_TIM6/TIM3/TIM15/TIM2)
+sampleRate - the requested sample rate (Hz)
+Returns the achieved sample rate in millihertz (0 if nothing was output), see dacPacedLateSamples for samples that missed their period
+*/
+
+uint32_t dacPacedLateSamples(); // Returns the number of samples written too late during the last paced playback (the previous sample was held for an extra period)
+
+void dacDMADualWaveGen(void* values, uint8_t mode, uint16_t length, uint16_t period); // Enables synchronous waveform generation on both DAC channels from one DMA channel (repeats forever...)
+/*
+NOTE: Uses TIM17 and its DMA channel (same as dacDMAWaveGen on DAC channel 1), both DAC channels must be initialised (the STM32F051 only has DAC channel 1, the dual registers need a part with 2 channels)
+Each sample updates both outputs with a single DMA transfer to DHR12RD/DHR12LD/DHR8RD, so the outputs stay sample-aligned
+values - a pointer to an array of packed samples: uint32_t (DAC_DUAL_PACK) in 12 bit modes, uint16_t (DAC_DUAL_PACK8) in 8 bit mode
+mode - 8/12 bit, left/right aligned
+length - the number of packed samples in the array
+period - the approximate delay between samples (in microseconds)
+dacDMAWaveSetPeriod/dacDMAWaveSetTable on channel 1 also apply to dual generation
+*/
+
+void dacDMADualWaveGenDisable(); // Disables synchronous dual channel waveform generation
+
+uint32_t dacDMATriggeredWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t length, uint8_t triggerSource, uint32_t sampleRate); // Enables waveform generation paced by a timer trigger, with the DAC requesting its own DMA transfers (repeats forever...)
+/*
+NOTE: DAC channel 1 only (the only DAC DMA request on the STM32F051), uses DMA channel 3 and the trigger timer
+The timer TRGO moves each sample to the output on the trigger edge and the DAC then requests the next one, so sample timing is jitter-free
+Returns the achieved sample rate in millihertz (= TIMER_CLOCK_FREQUENCY / ((PSC + 1) * (ARR + 1))), 0 if nothing was started
+channel - the DAC channel to output on
+values - a pointer to an array of analog values to output
+mode - 8/12 bit, left/right aligned
+length - the number of values in the array
+triggerSource - the timer to pace the output (DAC_TRIGGER_TIM6/TIM3/TIM15/TIM2)
+sampleRate - the requested sample rate (Hz)
+*/
+
+void dacDMATriggeredWaveGenDisable(uint8_t channel); // Disables timer triggered waveform generation
+
+uint32_t dacHardwareWaveGen(uint8_t channel, uint8_t wave, uint8_t amplitude, uint16_t offset, uint8_t triggerSource, uint32_t triggerRate); // Enables the DAC's built-in noise/triangle generation on top of a DC offset (no DMA channel or table needed)
+/*
+NOTE: Noise/triangle generation is only implemented in the DAC of STM32F07x/STM32F09x parts, on the STM32F051 the WAVE/MAMP bits are reserved and only the DC offset is output
+channel - the DAC channel to output on (initialise it with init_DAC first)
+wave - DAC_WAVE_NOISE or DAC_WAVE_TRIANGLE
+amplitude - 0 to DAC_WAVE_AMPLITUDE_MAX
+offset - 12 bit DC offset the wave is added to
+triggerSource - what steps the generator (DAC_TRIGGER_TIM6/TIM3/TIM15/TIM2 starts that timer at triggerRate, DAC_TRIGGER_SOFTWARE steps on dacSoftwareTrigger)
+triggerRate - generator step rate in Hz when triggered by a timer
+Returns the achieved step rate in millihertz (0 if no timer was started)
+*/
+
+void dacHardwareWaveGenDisable(uint8_t channel); // Disables the DAC's built-in noise/triangle generation (the channel keeps outputting DHR)
+
+void dacSoftwareTrigger(uint8_t channel); // Triggers a DAC channel configured with DAC_TRIGGER_SOFTWARE
+
+uint32_t dacStreamStart(DACStream_TypeDef* player, uint16_t* buffer, uint16_t length, uint8_t mode, uint16_t (*source)(uint16_t* samples, uint16_t count), uint8_t triggerSource, uint32_t sampleRate, uint8_t interruptPriority); // Starts streaming samples pulled from a source function out of DAC channel 1
+/*
+NOTE: DAC channel 1 only, uses DMA channel 3 with half/full transfer interrupts and the trigger timer (see dacDMATriggeredWaveGen)
+The source is called from the DMA interrupt to refill each half of the buffer once it has been played, so arbitrarily long signals can be played
+If the source provides fewer samples than asked the last sample is held and an underrun is counted (the buffer is never replayed stale)
+player - caller-owned player state
+buffer - ping-pong sample buffer (each half holds length/2 samples, larger buffers give the source more time)
+length - the number of samples in the buffer
+mode - 8/12 bit, left/right aligned
+source - function that writes up to count samples and returns how many it wrote (e.g. reading from a ring buffer or file)
+triggerSource - the timer to pace the output (DAC_TRIGGER_TIM6/TIM3/TIM15/TIM2)
+sampleRate - the requested sample rate (Hz)
+interruptPriority - the NVIC priority of the DMA interrupt
+Returns the achieved sample rate in millihertz, 0 if nothing was started
+*/
+
+void dacStreamStop(DACStream_TypeDef* player); // Stops a DAC stream
+uint32_t dacStreamUnderruns(DACStream_TypeDef* player); // Returns the number of underruns (source ran dry or a refill was late)
+
+uint32_t dacDDSStart(DACDDS_TypeDef* dds, const uint16_t* table, uint16_t tableLength, uint16_t* buffer, uint16_t length, uint8_t mode, uint8_t triggerSource, uint32_t sampleRate, uint32_t frequency, uint8_t interruptPriority); // Starts direct digital synthesis of a wavetable on DAC channel 1
+/*
+NOTE: DAC channel 1 only, uses DMA channel 3 with half/full transfer interrupts and the trigger timer (see dacStreamStart, only one of the two can play)
+A 32 bit phase accumulator steps through the table at any frequency, the resolution is sampleRate / 2^32 (about 0.2 mHz at 1 MHz), no table resampling or timer period change needed
+See __dacDDSFill for the refill loop, the host bench ([dac dds]) measures it
+dds - caller-owned generator state
+table - the wavetable, e.g. WAVE_SINE256 (length must be a power of 2)
+tableLength - the number of samples in the wavetable
+buffer - ping-pong sample buffer (each half holds length/2 samples)
+length - the number of samples in the buffer
+mode - 8/12 bit, left/right aligned (format of the table)
+triggerSource - the timer to pace the output (DAC_TRIGGER_TIM6/TIM3/TIM15/TIM2)
+sampleRate - the requested sample rate (Hz)
+frequency - the output frequency (mHz, below half the sample rate)
+interruptPriority - the NVIC priority of the DMA interrupt
+Returns the achieved sample rate in millihertz, 0 if nothing was started
+*/
+
+uint32_t dacDDSSetFrequency(DACDDS_TypeDef* dds, uint32_t frequency); // Changes the output frequency of direct digital synthesis (phase continuous, takes effect at the next half refill), returns the achieved frequency (mHz)
+void dacDDSStop(DACDDS_TypeDef* dds); // Stops direct digital synthesis
+
+void dacPackedWaveReset(DACPackedDecoder_TypeDef* decoder, const DACPackedWave_TypeDef* wave); // Starts decoding a packed waveform from the beginning of its period
+void dacPackedWaveDecode(DACPackedDecoder_TypeDef* decoder, uint16_t* samples, uint16_t count); // Expands the next samples of a packed waveform (wraps around at the end of each period)
+/*
+NOTE: Decoding runs in small constant time per sample (no multiplies or divides), so a DMA half-buffer can be refilled from the half/full transfer interrupt at dacDMAWaveGen rates
+decoder - caller-owned decoder state (reset with dacPackedWaveReset)
+samples - the buffer to expand into
+count - the number of samples to expand
+*/
+
+uint32_t dacPackedWaveStart(DACPackedDecoder_TypeDef* decoder, const DACPackedWave_TypeDef* wave, uint16_t* buffer, uint16_t length, uint8_t mode, uint8_t triggerSource, uint32_t sampleRate, uint8_t interruptPriority); // Plays a packed waveform on DAC channel 1, expanding it into a ping-pong DMA buffer (repeats forever...)
+/*
+NOTE: Uses dacStreamStart with the decoder as its source (same resources and restrictions)
+decoder - caller-owned decoder state
+wave - the packed waveform
+buffer - ping-pong sample buffer (each half holds length/2 samples)
+length - the number of samples in the buffer
+mode - 8/12 bit, left/right aligned (format of the packed samples)
+triggerSource - the timer to pace the output (DAC_TRIGGER_TIM6/TIM3/TIM15/TIM2)
+sampleRate - the requested sample rate (Hz)
+interruptPriority - the NVIC priority of the DMA interrupt
+Returns the achieved sample rate in millihertz, 0 if nothing was started
+*/
+
+void dacPackedWaveStop(DACPackedDecoder_TypeDef* decoder); // Stops playing a packed waveform
+uint16_t __dacPackedSource(uint16_t* samples, uint16_t count); // Stream source: expands the playing packed waveform
+
+void __dacDDSFill(DACDDS_TypeDef* dds, uint16_t* samples, uint16_t count); // Fills part of the DDS buffer by stepping the phase accumulator through the wavetable
+void __dacDDSRefill(DMAStream_TypeDef* stream, uint8_t half); // Stream callback: refills the half of the DDS buffer that has just been played
+void __dacStreamFill(DACStream_TypeDef* player, uint16_t* samples, uint16_t count); // Fills part of the stream buffer from the source, holding the last sample if the source runs dry
+void __dacStreamRefill(DMAStream_TypeDef* stream, uint8_t half); // Stream callback: refills the half of the buffer that has just been played
+
+uint16_t __dacDataMask(uint8_t mode); // Returns the valid data bits for a mode
+uint32_t __dacDataRegister(uint8_t channel, uint8_t mode); // Returns the address of the data holding register for a channel and mode
+void __dacTriggeredDMAEnable(uint8_t triggerSource); // Enables DAC channel 1 with a hardware trigger and DMA requests
+void __dacTriggerTimerStart(uint8_t channel, TIM_TypeDef* timer, uint16_t prescaler, uint16_t ticks); // Starts a timer driving TRGO on every update to trigger a DAC channel
+TIM_TypeDef* __dacTriggerTimer(uint8_t triggerSource); // Returns the timer behind a DAC trigger source (0 if the source is not a timer available on the STM32F051)
+
+void dacDMAWaveSetPeriod(uint8_t channel, uint16_t period); // Changes the sample period of DMA waveform generation without restarting it (takes effect at the next timer update)
+/*
+channel - the DAC channel whose waveform generation to change
+period - the new approximate delay between values (in microseconds)
+*/
+
+void dacDMAWaveSetTable(uint8_t channel, uint16_t* values, uint16_t length); // Switches DMA waveform generation to a new table at the end of the current pass (uses the DMA transfer complete interrupt)
+/*
+channel - the DAC channel whose waveform generation to change
+values - a pointer to the new array of analog values (same mode as dacDMAWaveGen was started with)
+length - the number of values in the new array
+*/
+
+void __dacDMAWaveEvent(uint8_t dmaChannel, uint8_t events); // DMA channel handler for waveform generation: swaps in the pending table at the wrap point
+void __dacWaveGenRelease(uint8_t request); // Disables and releases every DMA channel owned by a waveform generation timer request
\ No newline at end of file
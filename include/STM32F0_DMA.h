@@ -40,6 +40,9 @@ Functions for configuring/controlling the direct memory access module
 #endif
 
 /* CONSTANT DEFINITIONS */
+// Define DMA_STATISTICS (e.g. -DDMA_STATISTICS) to keep per-channel transfer counters, everything compiles out otherwise
+// #define DMA_STATISTICS
+
 // Priority levels
 #define DMA_PRIORITY_LOW 0
 #define DMA_PRIORITY_MEDIUM 1
@@ -68,6 +71,138 @@ Functions for configuring/controlling the direct memory access module
 #define DMA_INTERRUPT_HALFTRANSFER 0x2
 #define DMA_INTERRUPT_TRANSFERCOMPLETE 0x01
 
+// Interrupt events (passed to channel handlers, same bit positions as channel 1 in DMA1->ISR)
+#define DMA_EVENT_TRANSFERCOMPLETE 0x2
+#define DMA_EVENT_HALFTRANSFER 0x4
+#define DMA_EVENT_ERROR 0x8
+
+// Channels
+#define DMA_CHANNEL_COUNT 5 // Number of DMA channels on the STM32F051 (channels 6 and 7 exist on larger STM32F0 parts)
+
+// DMA requests (fixed request-to-channel mapping of the STM32F051, see reference manual RM0091 DMA request mapping)
+#define DMA_REQUEST_NONE 0 // Channel is free
+#define DMA_REQUEST_MEM2MEM 1 // Memory-to-memory (no peripheral request, any channel)
+#define DMA_REQUEST_ADC 2 // Channel 1 (channel 2 with ADC_DMA_RMP)
+#define DMA_REQUEST_SPI1_RX 3 // Channel 2
+#define DMA_REQUEST_SPI1_TX 4 // Channel 3
+#define DMA_REQUEST_SPI2_RX 5 // Channel 4
+#define DMA_REQUEST_SPI2_TX 6 // Channel 5
+#define DMA_REQUEST_USART1_TX 7 // Channel 2 (channel 4 with USART1TX_DMA_RMP)
+#define DMA_REQUEST_USART1_RX 8 // Channel 3 (channel 5 with USART1RX_DMA_RMP)
+#define DMA_REQUEST_USART2_TX 9 // Channel 4
+#define DMA_REQUEST_USART2_RX 10 // Channel 5
+#define DMA_REQUEST_I2C1_TX 11 // Channel 2
+#define DMA_REQUEST_I2C1_RX 12 // Channel 3
+#define DMA_REQUEST_I2C2_TX 13 // Channel 4
+#define DMA_REQUEST_I2C2_RX 14 // Channel 5
+#define DMA_REQUEST_TIM1_CH1 15 // Channel 2
+#define DMA_REQUEST_TIM1_CH2 16 // Channel 3
+#define DMA_REQUEST_TIM1_CH3 17 // Channel 5
+#define DMA_REQUEST_TIM1_CH4 18 // Channel 4 (TIM1_CH4/TRIG/COM)
+#define DMA_REQUEST_TIM1_UP 19 // Channel 5
+#define DMA_REQUEST_TIM2_CH1 20 // Channel 5
+#define DMA_REQUEST_TIM2_CH2 21 // Channel 3
+#define DMA_REQUEST_TIM2_CH3 22 // Channel 1
+#define DMA_REQUEST_TIM2_CH4 23 // Channel 4
+#define DMA_REQUEST_TIM2_UP 24 // Channel 2
+#define DMA_REQUEST_TIM3_CH1 25 // Channel 4 (TIM3_CH1/TRIG)
+#define DMA_REQUEST_TIM3_CH3 26 // Channel 2
+#define DMA_REQUEST_TIM3_CH4 27 // Channel 3 (TIM3_CH4/UP)
+#define DMA_REQUEST_TIM6_UP 28 // Channel 3 (TIM6_UP/DAC_CH1)
+#define DMA_REQUEST_TIM15 29 // Channel 5 (TIM15_CH1/UP/TRIG/COM)
+#define DMA_REQUEST_TIM16 30 // Channel 3 (channel 4 with TIM16_DMA_RMP) (TIM16_CH1/UP)
+#define DMA_REQUEST_TIM17 31 // Channel 1 (channel 2 with TIM17_DMA_RMP) (TIM17_CH1/UP)
+#define DMA_REQUEST_COUNT 32
+
+// Double-buffered streams
+#define DMA_STREAM_HALF_FIRST 0 // First half of the stream buffer
+#define DMA_STREAM_HALF_SECOND 1 // Second half of the stream buffer
+
+// Scatter-gather list status
+#define DMA_LIST_ACTIVE 1 // Segments still being transferred
+#define DMA_LIST_COMPLETE 2 // All segments transferred
+#define DMA_LIST_ERROR 3 // Aborted by a DMA transfer error (TEIF)
+
+// Channel configuration register image (everything except the enable bit), usable in constant initialisers
+#define DMA_CCR_IMAGE(priority, transferDirection, transferMode, incrementMode, peripheralTransferSize, memoryTransferSize) \
+	((((uint32_t)(priority) & 0x03) << 12) | \
+	((transferDirection) ? DMA_CCR_DIR : 0) | \
+	((transferMode) ? DMA_CCR_CIRC : 0) | \
+	(((incrementMode) & DMA_INCREMENT_MEMORY) ? DMA_CCR_MINC : 0) | \
+	(((incrementMode) & DMA_INCREMENT_PERIPHERAL) ? DMA_CCR_PINC : 0) | \
+	(((uint32_t)(memoryTransferSize) & 0x03) << 10) | \
+	(((uint32_t)(peripheralTransferSize) & 0x03) << 8))
+
+typedef struct {
+	// A type definition for a precomputed DMA channel configuration (register images applied with plain stores)
+	uint32_t CPAR; // Peripheral address
+	uint32_t CMAR; // Memory address
+	uint32_t CNDTR; // Number of data to transfer
+	uint32_t CCR; // Channel configuration (without DMA_CCR_EN)
+} DMADescriptor_TypeDef;
+
+typedef struct {
+	// A type definition for one segment of a scatter-gather transfer list
+	uint32_t memoryAddress; // Address of the segment in memory
+	uint16_t dataSize; // Number of data in the segment
+} DMASegment_TypeDef;
+
+typedef struct DMAScatterGather {
+	// A type definition for a scatter-gather transfer in progress (owned by the caller, must stay valid until complete)
+	uint8_t channel; // DMA channel
+	const DMASegment_TypeDef* segments; // Segment list
+	uint8_t segmentCount; // Number of segments in the list
+	volatile uint8_t segmentIndex; // Segment currently being transferred
+	volatile uint8_t status; // DMA_LIST_ACTIVE/COMPLETE/ERROR
+	void (*callback)(struct DMAScatterGather* list); // Called from the DMA interrupt when the list finishes (may be 0)
+} DMAScatterGather_TypeDef;
+
+#ifdef DMA_STATISTICS
+typedef struct {
+	// A type definition for the transfer counters of a DMA channel
+	uint32_t transfersStarted; // Transfers started through the DMA module
+	uint32_t transfersCompleted; // Transfer complete events (each pass of a circular transfer counts)
+	uint32_t bytesMoved; // Bytes moved by completed transfers
+	uint32_t errors; // Transfer error events
+	uint16_t lastLatency; // Start-to-complete time of the last transfer (timebase ticks)
+	uint16_t maxLatency; // Longest start-to-complete time (timebase ticks)
+	uint32_t busyTicks; // Total start-to-complete time (timebase ticks, wall time with a transfer in progress, not bus occupancy)
+} DMAStatistics_TypeDef;
+#endif
+
+// Memory copy engine
+#define DMA_COPY_QUEUE_LENGTH 8 // Maximum number of copy requests waiting/in progress
+
+// Copy request status
+#define DMA_COPY_PENDING 0 // Waiting in the queue
+#define DMA_COPY_ACTIVE 1 // Transfer in progress
+#define DMA_COPY_COMPLETE 2 // Transfer completed successfully
+#define DMA_COPY_ERROR 3 // Transfer aborted by a DMA transfer error (TEIF)
+
+typedef struct DMACopyRequest {
+	// A type definition for an asynchronous memory copy request (owned by the caller, must stay valid until complete)
+	uint32_t fromAddress; // Source address
+	uint32_t toAddress; // Destination address
+	uint16_t dataSize; // Number of data to copy
+	uint8_t transferSize; // Size of each datum (DMA_TRANSFERSIZE_*)
+	uint8_t fill; // 1: the source is a fixed pattern (fill), 0: the source increments (copy)
+	uint32_t pattern; // Fill value, the source of fill requests
+	volatile uint8_t status; // DMA_COPY_PENDING/ACTIVE/COMPLETE/ERROR
+	void (*callback)(struct DMACopyRequest* request); // Called from the DMA interrupt when the request finishes (may be 0)
+} DMACopyRequest_TypeDef;
+
+typedef struct DMAStream {
+	// A type definition for a circular double-buffered (ping-pong) DMA stream
+	uint8_t channel; // DMA channel
+	uint32_t bufferAddress; // Address of the stream buffer
+	uint16_t length; // Number of data in the whole buffer (both halves)
+	uint16_t halfBytes; // Size of each half in bytes
+	volatile uint8_t held; // Halves handed to the consumer and not yet released (bit 0: first, bit 1: second)
+	volatile uint32_t overruns; // Number of times the DMA re-entered a half the consumer still held, or that was handed over too late
+	volatile uint32_t errors; // Number of transfer errors (the stream stops on an error)
+	void (*callback)(struct DMAStream* stream, uint8_t half); // Called from the DMA interrupt when a half is ready for the consumer
+} DMAStream_TypeDef;
+
 
 /* FUNCTIONS */
 DMA_Channel_TypeDef* __dmaChannelAddress(uint8_t channel); // Returns the address of a DMA channel (configuration registers)
@@ -86,8 +221,162 @@ peripheralTransferSize - peripheral transaction memory size
 memoryTransferSize - memory transaction memory size
 */
 
-void dmaChannelDisable(uint8_t channel); // Disables a DMA channel
+void dmaChannelDisable(uint8_t channel); // Disables a DMA channel and clears its interrupt flags
+
+void init_DMAController(); // Enables the clock for the DMA controller (needed before applying descriptors)
+
+void dmaBuildDescriptor(DMADescriptor_TypeDef* descriptor, uint32_t peripheralAddress, uint32_t memoryAddress, uint16_t dataSize, uint8_t priority, uint8_t transferDirection, uint8_t transferMode, uint8_t incrementMode, uint8_t peripheralTransferSize, uint8_t memoryTransferSize); // Precomputes a DMA channel configuration (same arguments as init_DMA)
+/*
+Descriptors can also be built at compile time, e.g.
+const DMADescriptor_TypeDef desc = { peripheralAddress, memoryAddress, dataSize, DMA_CCR_IMAGE(priority, direction, mode, increment, psize, msize) };
+Interrupt enable bits (DMA_CCR_TCIE/HTIE/TEIE) may be OR'd into the CCR image
+*/
+
+void dmaApplyDescriptor(uint8_t channel, const DMADescriptor_TypeDef* descriptor); // Configures and enables a DMA channel from a descriptor using plain register stores (no read-modify-write), clearing flags left by the previous transfer
+
+void dmaRearm(uint8_t channel, uint32_t memoryAddress, uint16_t dataSize); // Restarts a configured DMA channel with a new memory address and data size, keeping the rest of its configuration
 
 void dmaMemCopy(uint8_t channel, uint32_t fromAddress, uint32_t toAddress, uint16_t dataSize, uint8_t transferSize, uint8_t priority); // Copies a block of memory from one location to another
 
+int __dmaChannelIRQn(uint8_t channel); // Returns the NVIC interrupt number shared by a DMA channel (-1 if invalid)
+
+void dmaMemFill(uint8_t channel, const uint32_t* pattern, uint32_t toAddress, uint16_t dataSize, uint8_t transferSize, uint8_t priority); // Fills a block of memory with a repeated value
+/*
+pattern - pointer to the fill value (must stay valid until the transfer completes, the low byte/halfword is used for byte/halfword fills)
+toAddress - the address of the block to fill
+dataSize - the number of data to fill
+transferSize - the size of each datum (DMA_TRANSFERSIZE_*)
+*/
+
 void dmaInterruptConfig(uint8_t channel, uint8_t interruptSource, uint8_t priority); // Configures DMA interrupts for a channel
+
+// Channel allocation
+uint8_t dmaRequestChannel(uint8_t request); // Returns the channel a DMA request is currently routed to (0 if none/any)
+uint8_t dmaChannelAllocate(uint8_t request); // Allocates the channel serving a DMA request, remapping it if the default channel is taken (returns 0 on conflict)
+/*
+request - the DMA request (DMA_REQUEST_*) that will use the channel
+DMA_REQUEST_MEM2MEM takes any free channel
+A channel is never shared: if the request already owns a channel (default or remapped, another user of the same request), 0 is returned, free the channel first
+NOTE: Remapping sets/clears the SYSCFG_CFGR1 *_DMA_RMP bit for the peripheral
+*/
+int dmaChannelClaim(uint8_t channel, uint8_t request); // Claims a specific channel for a DMA request, returns 1 if successful and 0 if the channel is already owned
+void dmaChannelFree(uint8_t channel); // Releases a channel (does not disable it)
+uint8_t dmaChannelOwner(uint8_t channel); // Returns the DMA request that owns a channel (DMA_REQUEST_NONE if free)
+uint8_t dmaChannelOwnedBy(uint8_t request); // Returns the lowest channel owned by a DMA request (0 if none)
+
+// Double-buffered (ping-pong) streams
+void init_DMAStream(DMAStream_TypeDef* stream, uint8_t channel, uint32_t peripheralAddress, uint32_t bufferAddress, uint16_t length, uint8_t priority, uint8_t transferDirection, uint8_t peripheralTransferSize, uint8_t memoryTransferSize, void (*callback)(DMAStream_TypeDef* stream, uint8_t half), uint8_t interruptPriority); // Starts a circular DMA stream that hands over each half of its buffer as it completes
+/*
+stream - caller-owned stream state
+channel - the DMA channel to use
+peripheralAddress - the address of the peripheral register to stream to/from
+bufferAddress - the address of the stream buffer in memory
+length - the number of data in the buffer (must be even, each half is length/2)
+priority - the DMA channel priority
+transferDirection - P2M: halves are handed over when filled, M2P: halves are handed over when sent (to be refilled)
+peripheralTransferSize - peripheral transaction memory size
+memoryTransferSize - memory transaction memory size
+callback - called from the DMA interrupt (HT for the first half, TC for the second) with the half that is ready (0 for none)
+interruptPriority - the NVIC priority of the channel interrupt
+NOTE: A half stays held by the consumer until dmaStreamRelease() is called for it, if the DMA wraps back into a held half an overrun is counted
+An overrun is also counted when the interrupt is serviced after the DMA has already re-entered the half (HT and TC pending together, or CNDTR inside the half)
+*/
+
+void dmaStreamStop(DMAStream_TypeDef* stream); // Stops a DMA stream
+void dmaStreamRelease(DMAStream_TypeDef* stream, uint8_t half); // Returns a half of the stream buffer to the DMA once the consumer is done with it
+uint32_t dmaStreamHalfAddress(DMAStream_TypeDef* stream, uint8_t half); // Returns the address of a half of the stream buffer
+void __dmaStreamEvent(uint8_t channel, uint8_t events); // Channel handler for streams: hands over completed halves and handles errors
+
+// Scatter-gather transfer lists
+void dmaScatterGatherStart(DMAScatterGather_TypeDef* list, uint8_t channel, uint32_t peripheralAddress, const DMASegment_TypeDef* segments, uint8_t segmentCount, uint8_t priority, uint8_t transferDirection, uint8_t peripheralTransferSize, uint8_t memoryTransferSize, void (*callback)(DMAScatterGather_TypeDef* list), uint8_t interruptPriority); // Transfers a list of non-contiguous memory segments to/from one peripheral register
+/*
+list - caller-owned transfer state, doubles as the handle to poll for completion
+channel - the DMA channel serving the peripheral request
+peripheralAddress - the address of the peripheral register to transfer to/from
+segments - the memory segments, in order (zero-length segments are skipped)
+segmentCount - the number of segments
+priority - the DMA channel priority
+transferDirection - 0: Transfer from peripheral to memory 1: Transfer from memory to peripheral
+peripheralTransferSize - peripheral transaction memory size
+memoryTransferSize - memory transaction memory size
+callback - called from the DMA interrupt when the whole list has finished (0 for none)
+interruptPriority - the NVIC priority of the channel interrupt
+NOTE: The F0 DMA has no linked-list mode, the transfer complete interrupt reprograms CMAR/CNDTR for the next segment
+*/
+void __dmaScatterGatherEvent(uint8_t channel, uint8_t events); // Channel handler for scatter-gather lists: starts the next segment or finishes the list
+
+// Asynchronous memory copy engine
+void init_DMACopyEngine(uint8_t channel, uint8_t priority, uint8_t interruptPriority); // Dedicates a DMA channel to queued memory copies
+/*
+channel - the DMA channel to use for copies
+priority - the DMA channel priority
+interruptPriority - the NVIC priority of the channel interrupt
+NOTE: Does nothing if the channel is already owned (see dmaChannelAllocate), except by the copy engine itself (re-initialisation)
+*/
+
+int dmaCopyQueue(DMACopyRequest_TypeDef* request, uint32_t fromAddress, uint32_t toAddress, uint16_t dataSize, uint8_t transferSize, void (*callback)(DMACopyRequest_TypeDef* request)); // Queues a memory copy, returns 1 if queued and 0 if the queue is full
+/*
+request - caller-owned request, doubles as the handle to poll for completion (rejected, and left untouched, while it is still queued or in progress)
+fromAddress - the address to copy from
+toAddress - the address to copy to
+dataSize - the number of data to copy
+transferSize - the size of each datum (DMA_TRANSFERSIZE_*)
+callback - function called from the DMA interrupt when the copy finishes (0 for none)
+*/
+
+int dmaFillQueue(DMACopyRequest_TypeDef* request, uint32_t toAddress, uint32_t pattern, uint16_t dataSize, uint8_t transferSize, void (*callback)(DMACopyRequest_TypeDef* request)); // Queues a memory fill, returns 1 if queued and 0 if the queue is full
+/*
+request - caller-owned request, doubles as the handle to poll for completion (holds the pattern during the transfer, rejected while it is still queued or in progress)
+toAddress - the address of the block to fill
+pattern - the fill value (the low byte/halfword is used for byte/halfword fills)
+dataSize - the number of data to fill (e.g. 1024 words to clear 4 KB)
+transferSize - the size of each datum (DMA_TRANSFERSIZE_*)
+callback - function called from the DMA interrupt when the fill finishes (0 for none)
+*/
+
+uint8_t dmaCopyStatus(DMACopyRequest_TypeDef* request); // Returns the status of a copy request (DMA_COPY_*)
+int dmaCopyPending(); // Returns the number of copy requests queued or in progress
+uint32_t dmaCopyErrorCount(); // Returns the number of copy requests that ended in a transfer error
+
+int __dmaCopyEnqueue(DMACopyRequest_TypeDef* request); // Adds a prepared request to the copy queue, starting it if the channel is idle
+int __dmaCopyQueued(DMACopyRequest_TypeDef* request); // Returns whether a request is waiting in the copy queue or in progress (call with the copy interrupt disabled)
+int __dmaCopyAvailable(DMACopyRequest_TypeDef* request); // Returns whether a request can be (re)filled and queued: the engine is initialised and the request is not queued or in progress
+void __dmaCopyStart(DMACopyRequest_TypeDef* request); // Programs the copy channel with a request
+void __dmaCopyEvent(uint8_t channel, uint8_t events); // Channel handler for the copy engine: completes the active request and starts the next queued one
+
+// Interrupt dispatch
+void dmaSetChannelHandler(uint8_t channel, void (*handler)(uint8_t channel, uint8_t events)); // Registers the function called from the DMA interrupt for a channel (0 to remove)
+/*
+handler - called with the channel number and its DMA_EVENT_* flags (already acknowledged)
+NOTE: Flags of channels without a handler are left untouched so they can still be polled, unless the channel has interrupts enabled (they are acknowledged so the interrupt does not keep firing)
+NOTE: Enable the channel interrupts with dmaInterruptConfig()
+*/
+uint32_t __dmaUnhandledFlags(uint32_t flags); // Returns the flags of channels without a handler that are raising an interrupt
+void __dmaDispatch(uint32_t lineFlags); // Acknowledges and dispatches the DMA events of one interrupt line
+
+#ifdef DMA_STATISTICS
+// Transfer statistics
+// Starts are counted for transfers started with init_DMA, dmaApplyDescriptor and dmaRearm (and everything built on them)
+// Completions/errors are counted for channels with a handler (see dmaSetChannelHandler) and for channels passed to dmaStatisticsEnable
+void dmaStatisticsTimebase(TIM_TypeDef* timer); // Sets the free-running timer used to measure transfer latency (latency is not measured without one)
+void dmaStatisticsEnable(uint8_t channel, uint8_t interruptPriority); // Counts the completions/errors of a channel from the DMA interrupt, whether or not it has a handler (e.g. circular dacDMAWaveGen/ADC scan channels)
+/*
+NOTE: Enables the channel's transfer complete/error interrupts (kept across reconfiguration), its flags are then acknowledged in the interrupt and can no longer be polled
+*/
+void dmaStatisticsReset(uint8_t channel); // Clears the counters of a channel
+void dmaStatisticsGet(uint8_t channel, DMAStatistics_TypeDef* statistics); // Copies the counters of a channel
+void dmaStatisticsDisable(uint8_t channel); // Stops counting the completions/errors of a channel without a handler (its interrupts are disabled again unless it has a handler)
+uint8_t dmaStatisticsUtilisation(uint8_t channel, uint32_t windowTicks); // Returns the percentage (0-100) of a measurement window the channel had a transfer in progress (reset the counters at the start of each window)
+/*
+NOTE: Measured from busyTicks, i.e. start-to-complete wall time, not bus occupancy: a channel paced by peripheral requests (e.g. a timer-driven circular DAC channel) reads close to 100% while using little of the bus
+*/
+uint32_t __dmaStatisticsInterrupts(uint8_t channel); // Returns the interrupt enables a channel needs for its statistics
+void __dmaStatisticsStart(uint8_t channel, uint32_t dataSize, uint32_t ccr); // Records the start of a transfer
+void __dmaStatisticsEvent(uint8_t channel, uint8_t events); // Records the completion/error of a transfer
+#endif
+
+// Interrupt handlers
+// The following handlers dispatch to the registered channel handlers, remove them if you want to write your own
+void DMA1_Channel1_IRQHandler(); // Interrupt handler for DMA channel 1
+void DMA1_Channel2_3_IRQHandler(); // Interrupt handler for DMA channels 2-3
+void DMA1_Channel4_5_IRQHandler(); // Interrupt handler for DMA channels 4-5 (4-7 on larger STM32F0 parts)
@@ -29,11 +29,6 @@ Functions to configure interrupts as well as interrupt handlers
 #define STM32F0_GPIO_H
 #endif
 
-#ifndef STM32F0_OTHER_H
-#include "STM32F0_GPIO.h"
-#define STM32F0_OTHER_H
-#endif
-
 #ifndef STM32F0_OTHER_H
 #include "STM32F0_OTHER.h"
 #define STM32F0_OTHER_H
@@ -40,6 +40,14 @@ Functions for using the timers (re-write)
 #endif
 
 /* CONSTANT DEFINITIONS */
+#ifndef TIMER_CLOCK_FREQUENCY
+#define TIMER_CLOCK_FREQUENCY 48000000 // Timer input clock in Hz (48 MHz system clock, APB prescaler 1 - the same assumption as the 1 uS prescaler of 47 used elsewhere)
+#endif
+
+// Master mode (TRGO) sources
+#define TIMER_TRGO_RESET 0x0 // UG bit
+#define TIMER_TRGO_ENABLE 0x1 // Counter enable
+#define TIMER_TRGO_UPDATE 0x2 // Update event (overflow)
 
 
 /* FUNCTIONS */
@@ -59,6 +67,18 @@ int timerComplete(TIM_TypeDef* timer); // Returns whether a timer has completed
 void clearStatusFlag(TIM_TypeDef* timer); // Clears the status flag of timer completion
 void timerInterruptEnable(TIM_TypeDef* timer, uint8_t priority); // Enables a timers update interrupt (triggered when timer completes) (remember to write your IRQHandler)
 
+// Rate functions
+uint32_t timerCalculateRate(uint32_t frequency, uint16_t* prescaler, uint16_t* ticks); // Calculates the prescaler and auto-reload (ticks) values closest to an update rate, returns the achieved rate in millihertz (0 if unreachable)
+/*
+frequency - the requested update rate in Hz
+prescaler - receives the prescaler value (PSC)
+ticks - receives the auto-reload value (ARR, as passed to startRepeatingTimer)
+Achieved rate = TIMER_CLOCK_FREQUENCY / ((prescaler + 1) * (ticks + 1)), the smallest prescaler is used to keep the error as low as possible
+Rates above half the timer clock are unreachable (the auto-reload value must be at least 1)
+*/
+uint32_t startRateTimer(TIM_TypeDef* timer, uint32_t frequency); // Initialises and starts a timer to repeatedly update at (close to) a rate in Hz, returns the achieved rate in millihertz (0 if unreachable)
+void timerTriggerOutput(TIM_TypeDef* timer, uint8_t source); // Selects the event a timer drives on its trigger output (TRGO) for the DAC/ADC/other timers (TIMER_TRGO_*)
+
 // PWM functions
 void pwmEnable(TIM_TypeDef* timer, uint8_t channel); // Enables output capture/compare (PWM) on a timer channel
 void pwmDisable(TIM_TypeDef* timer, uint8_t channel); // Disables output capture/compare (PWM) on a timer channel
@@ -17,6 +17,17 @@ Module: ADC
 #define STM32F0_ADC_H
 #endif
 
+/* GLOBAL VARIABLES */
+static TIM_TypeDef* adcTriggerTimerRunning = 0; // Timer started to pace triggered conversions
+static volatile uint32_t adcOverrunCount = 0; // Results lost to overruns
+static void (*adcCallback)(uint8_t channel, uint16_t value, uint8_t events) = 0; // Interrupt mode result callback
+static uint8_t adcNextChannel = 0; // Channel the next interrupt mode result belongs to
+static const uint8_t adcPinChannels[3][16] = {
+	// ADC channel of each pin of GPIOA, GPIOB and GPIOC (ADC_CHANNEL_NONE if not connected to the ADC)
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, // PA0-PA7: channels 0-7
+	{ 8, 9, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, // PB0-PB1: channels 8-9
+	{ 10, 11, 12, 13, 14, 15, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } // PC0-PC5: channels 10-15
+};
 
 /* FUNCTIONS */
 
@@ -35,74 +46,324 @@ void init_ADC(int resolution) {
 
 uint16_t analogRead(IOPin_TypeDef* iopin) {
 	// Read an analog value from a pin
-	ADC1->CHSELR &= 0xFFF80000; // Reset the channel selection
-	if ((iopin->port == GPIOA) && (iopin->pin == 0)) { // PA0
-		ADC1->CHSELR |= (1 << 0); // Select channel 0
+	uint8_t channel = adcPinChannel(iopin);
+	if (channel == ADC_CHANNEL_NONE) {
+		// Pin not connected to ADC, do nothing
+		return 0;
 	}
-	else if ((iopin->port == GPIOA) && (iopin->pin == 1)) { // PA1
-		ADC1->CHSELR |= (1 << 1); // Select channel 1
+	return __adcConvert(ADC_CHANNEL_MASK(channel)); // Convert the channel and return the ADC data
+}
+
+uint16_t analogReadChannel(int channel) {
+	// Read an analog value from a specific ADC channel
+	if ((channel >= 0) && (channel <= 18)) { // Check that the channel requested is valid
+		return __adcConvert(ADC_CHANNEL_MASK(channel)); // Convert the channel and return the ADC data
 	}
-	else if ((iopin->port == GPIOA) && (iopin->pin == 2)) { // PA2
-		ADC1->CHSELR |= (1 << 2); // Select channel 2
+	return 0; // Invalid channel selection, do not read ADC
+}
+
+
+uint8_t adcStart(uint32_t channelMask) {
+	// Starts converting a set of channels without waiting
+	if (ADC1->CR & ADC_CR_ADSTART) {
+		return 0; // A conversion is already in progress
 	}
-	else if ((iopin->port == GPIOA) && (iopin->pin == 3)) { // PA3
-		ADC1->CHSELR |= (1 << 3); // Select channel 3
+	if (ADC1->ISR & ADC_ISR_OVR) {
+		__adcCountOverrun(); // A result of the previous conversion was never read
 	}
-	else if ((iopin->port == GPIOA) && (iopin->pin == 4)) { // PA4
-		ADC1->CHSELR |= (1 << 4); // Select channel 4
+	ADC1->ISR = (ADC_ISR_EOC | ADC_ISR_EOSEQ); // Clear stale completion flags (write 1 to clear)
+	__adcSelectChannels(channelMask);
+	adcNextChannel = 0; // Interrupt mode results start from the lowest selected channel
+	ADC1->CR |= ADC_CR_ADSTART; // Start converting
+	return 1;
+}
+
+uint8_t adcPoll(uint16_t* value) {
+	// Checks for the next result of a started conversion without waiting
+	uint32_t isr = ADC1->ISR;
+	if (isr & ADC_ISR_OVR) {
+		__adcCountOverrun(); // A result was lost before this poll
 	}
-	else if ((iopin->port == GPIOA) && (iopin->pin == 5)) { // PA5
-		ADC1->CHSELR |= (1 << 5); // Select channel 5
+	if (isr & ADC_ISR_EOC) {
+		*value = (uint16_t)ADC1->DR; // Reading DR clears EOC
+		return ADC_STATUS_COMPLETE;
 	}
-	else if ((iopin->port == GPIOA) && (iopin->pin == 6)) { // PA6
-		ADC1->CHSELR |= (1 << 6); // Select channel 6
+	return (ADC1->CR & ADC_CR_ADSTART) ? ADC_STATUS_BUSY : ADC_STATUS_IDLE;
+}
+
+uint8_t adcReadTimeout(uint32_t channelMask, uint16_t* value, uint32_t timeout) {
+	// Converts a channel and waits at most timeout uS for the result
+	uint32_t cyclesPerUs = (SystemCoreClock / 1000000);
+	uint32_t polls = ((cyclesPerUs && (timeout > (0xFFFFFFFF / cyclesPerUs))) ? 0xFFFFFFFF : (timeout * cyclesPerUs)) / ADC_POLL_CYCLES; // Timeout as a poll count, so the result is seen as soon as it is ready
+	if (!adcStart(channelMask)) {
+		return 0; // ADC is busy
 	}
-	else if ((iopin->port == GPIOA) && (iopin->pin == 7)) { // PA7
-		ADC1->CHSELR |= (1 << 7); // Select channel 7
+	while (adcPoll(value) != ADC_STATUS_COMPLETE) {
+		if (polls == 0) {
+			__adcStop(); // Give up on the conversion
+			return 0;
+		}
+		polls--;
 	}
-	else if ((iopin->port == GPIOB) && (iopin->pin == 0)) { // PB0
-		ADC1->CHSELR |= (1 << 8); // Select channel 8
+	return 1;
+}
+
+uint32_t adcOverruns() {
+	// Returns the number of results lost to overruns
+	return adcOverrunCount;
+}
+
+void adcInterruptEnable(void (*callback)(uint8_t channel, uint16_t value, uint8_t events), uint8_t priority) {
+	// Delivers conversion results through a callback from the ADC interrupt
+	adcCallback = callback;
+	ADC1->ISR = (ADC_ISR_EOC | ADC_ISR_EOSEQ | ADC_ISR_OVR); // Clear stale flags (write 1 to clear)
+	ADC1->IER |= (ADC_IER_EOCIE | ADC_IER_EOSEQIE | ADC_IER_OVRIE); // Interrupt on each result, the end of each sequence, and lost results
+	nvicSetPriority(ADC1_COMP_IRQn, priority);
+	nvicEnableInterrupt(ADC1_COMP_IRQn);
+}
+
+void adcInterruptDisable() {
+	// Stops delivering conversion results through the ADC interrupt
+	ADC1->IER &= ~(ADC_IER_EOCIE | ADC_IER_EOSEQIE | ADC_IER_OVRIE);
+	nvicDisableInterrupt(ADC1_COMP_IRQn);
+	adcCallback = 0;
+}
+
+void ADC1_COMP_IRQHandler() {
+	// Interrupt handler for the ADC (shared with the comparators)
+	uint32_t isr = ADC1->ISR;
+	uint32_t chselr = ADC1->CHSELR;
+
+	if (isr & ADC_ISR_OVR) {
+		__adcCountOverrun();
+		if (adcCallback) {
+			adcCallback(ADC_CHANNEL_NONE, 0, ADC_EVENT_OVERRUN); // Report the lost result
+		}
 	}
-	else if ((iopin->port == GPIOB) && (iopin->pin == 1)) { // PB1
-		ADC1->CHSELR |= (1 << 9); // Select channel 9
+	if (isr & ADC_ISR_EOC) {
+		uint16_t value = (uint16_t)ADC1->DR; // Reading DR clears EOC
+		while ((adcNextChannel < ADC_CHANNEL_COUNT) && !(chselr & ADC_CHANNEL_MASK(adcNextChannel))) {
+			adcNextChannel++; // Channels are converted in ascending order
+		}
+		uint8_t channel = (adcNextChannel < ADC_CHANNEL_COUNT) ? adcNextChannel : ADC_CHANNEL_NONE;
+		adcNextChannel++;
+		uint8_t events = ADC_EVENT_CONVERSION;
+		if (isr & ADC_ISR_EOSEQ) {
+			events |= ADC_EVENT_SEQUENCE; // Last result of the sequence
+		}
+		if (adcCallback) {
+			adcCallback(channel, value, events);
+		}
 	}
-	else if ((iopin->port == GPIOC) && (iopin->pin == 0)) { // PC0
-		ADC1->CHSELR |= (1 << 10); // Select channel 10
+	if (isr & ADC_ISR_EOSEQ) {
+		ADC1->ISR = ADC_ISR_EOSEQ; // Acknowledge the end of sequence
+		adcNextChannel = 0; // Next sequence starts from the lowest selected channel
 	}
-	else if ((iopin->port == GPIOC) && (iopin->pin == 1)) { // PC1
-		ADC1->CHSELR |= (1 << 11); // Select channel 11
+}
+
+uint16_t __adcConvert(uint32_t channelMask) {
+	// Converts the selected channels and waits up to ADC_TIMEOUT for the first result
+	uint16_t value = 0;
+	adcReadTimeout(channelMask, &value, ADC_TIMEOUT);
+	return value;
+}
+
+void __adcCountOverrun() {
+	// Counts and clears an overrun
+	adcOverrunCount++;
+	ADC1->ISR = ADC_ISR_OVR; // Write 1 to clear
+}
+
+uint8_t adcPinChannel(IOPin_TypeDef* iopin) {
+	// Returns the ADC channel connected to a pin
+	uint32_t port = ((uint32_t)iopin->port - GPIOA_BASE) >> 10; // GPIO ports are 0x400 apart
+	if ((port >= 3) || (iopin->pin >= 16)) {
+		return ADC_CHANNEL_NONE; // Only GPIOA, GPIOB and GPIOC have ADC inputs
 	}
-	else if ((iopin->port == GPIOC) && (iopin->pin == 2)) { // PC2
-		ADC1->CHSELR |= (1 << 12); // Select channel 12
+	return adcPinChannels[port][iopin->pin];
+}
+
+void adcInputInit(ADCInput_TypeDef* input, IOPin_TypeDef* iopin) {
+	// Resolves the ADC channel of a pin once for fast repeated reads
+	input->channel = adcPinChannel(iopin);
+	input->channelMask = (input->channel == ADC_CHANNEL_NONE) ? 0 : ADC_CHANNEL_MASK(input->channel);
+}
+
+uint16_t adcInputRead(const ADCInput_TypeDef* input) {
+	// Read an analog value through an analog input handle
+	if (!input->channelMask) {
+		return 0; // Pin not connected to ADC, do nothing
 	}
-	else if ((iopin->port == GPIOC) && (iopin->pin == 3)) { // PC3
-		ADC1->CHSELR |= (1 << 13); // Select channel 13
+	return __adcConvert(input->channelMask); // Convert the channel and return the ADC data
+}
+
+void __adcStop() {
+	// Stops any ongoing conversions so the ADC can be reconfigured
+	if (ADC1->CR & ADC_CR_ADSTART) {
+		ADC1->CR |= ADC_CR_ADSTP; // Request the stop
+		while (ADC1->CR & ADC_CR_ADSTP); // Wait for the ongoing conversion to finish
 	}
-	else if ((iopin->port == GPIOC) && (iopin->pin == 4)) { // PC4
-		ADC1->CHSELR |= (1 << 14); // Select channel 14
+}
+
+void __adcSelectChannels(uint32_t channelMask) {
+	// Selects the channels to convert and enables the internal channel sources they need
+	uint32_t sources = 0;
+	if (channelMask & ADC_CHANNEL_MASK(ADC_CHANNEL_TEMPERATURE)) {
+		sources |= ADC_CCR_TSEN; // Temperature sensor
 	}
-	else if ((iopin->port == GPIOC) && (iopin->pin == 5)) { // PC5
-		ADC1->CHSELR |= (1 << 15); // Select channel 15
+	if (channelMask & ADC_CHANNEL_MASK(ADC_CHANNEL_VREFINT)) {
+		sources |= ADC_CCR_VREFEN; // Internal reference
 	}
-	else {
-		// Pin not connected to ADC, do nothing
-		return 0;
+	if (channelMask & ADC_CHANNEL_MASK(ADC_CHANNEL_VBAT)) {
+		sources |= ADC_CCR_VBATEN; // VBAT divider
+	}
+	if (sources) {
+		ADC->CCR |= sources; // Only internal channels touch the common register, an input read stays a single CHSELR write
 	}
+	ADC1->CHSELR = (channelMask & 0x7FFFF); // Select the channels (converted in ascending order)
+}
 
-	ADC1->CR |= (1 << 2); // Set the ADSTART bit to start a conversion
-	while ((ADC1->ISR & (1 << 2)) == 0); // Wait for the conversion to complete
-	return (uint16_t)ADC1->DR; // Return the ADC data
+uint8_t __adcScanSetup(ADCScan_TypeDef* scan, uint32_t channelMask, uint16_t* buffer, uint16_t depth) {
+	// Selects the scan channels and starts the DMA ring buffer (ADC left stopped)
+	uint8_t channels = 0;
+	channelMask &= 0x7FFFF; // Only channels 0 to 18 exist
+	for (uint8_t channel = 0; channel < ADC_CHANNEL_COUNT; channel++) {
+		// Record where each channel sits in a sequence
+		if (channelMask & ADC_CHANNEL_MASK(channel)) {
+			scan->rank[channel] = channels++;
+		}
+		else {
+			scan->rank[channel] = ADC_CHANNEL_NONE;
+		}
+	}
+	if ((channels == 0) || (depth == 0) || ((uint32_t)channels * depth > 0xFFFF)) {
+		return 0; // Nothing to scan, or the ring buffer is too large for one DMA transfer
+	}
+	uint8_t dmaChannel = dmaChannelAllocate(DMA_REQUEST_ADC);
+	if (!dmaChannel) {
+		return 0; // No DMA channel available, do nothing
+	}
+	scan->buffer = buffer;
+	scan->length = channels * depth;
+	scan->channels = channels;
+	scan->dmaChannel = dmaChannel;
+	for (uint16_t i = 0; i < scan->length; i++) {
+		buffer[i] = 0; // Reads before the first sequence completes return 0
+	}
 
+	__adcStop(); // The configuration can only change while the ADC is idle
+	__adcSelectChannels(channelMask);
+	init_DMA(dmaChannel, (uint32_t)(&ADC1->DR), (uint32_t)buffer, scan->length, DMA_PRIORITY_HIGH, DMA_TRANSFERDIRECTION_P2M, DMA_TRANSFERMODE_CIRCULAR, DMA_INCREMENT_MEMORY, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD); // Stream DR into the ring buffer
+	ADC1->CFGR1 = ((ADC1->CFGR1 & ~(ADC_CFGR1_CONT | ADC_CFGR1_EXTEN | ADC_CFGR1_EXTSEL | ADC_CFGR1_DISCEN | ADC_CFGR1_AUTOFF | ADC_CFGR1_WAIT)) | ADC_CFGR1_DMACFG | ADC_CFGR1_DMAEN); // Circular DMA requests
+	return dmaChannel;
 }
 
-uint16_t analogReadChannel(int channel) {
-	// Read an analog value from a specific ADC channel
-	ADC1->CHSELR &= 0xFFF80000; // Reset the channel selection
-	if ((channel >= 0) && (channel <= 18)) { // Check that the channel requested is valid
-		ADC1->CHSELR |= (1 << channel); // Select the channel
-		ADC1->CR |= (1 << 2); // Set the ADSTART bit to start a conversion
-		while ((ADC1->ISR & (1 << 2)) == 0); // Wait for the conversion to complete
-		return (uint16_t)ADC1->DR; // Return the ADC data
+uint8_t adcScanStart(ADCScan_TypeDef* scan, uint32_t channelMask, uint16_t* buffer, uint16_t depth) {
+	// Starts continuously scanning a set of channels, with DMA streaming the results into a ring buffer
+	uint8_t dmaChannel = __adcScanSetup(scan, channelMask, buffer, depth);
+	if (dmaChannel) {
+		ADC1->CFGR1 |= ADC_CFGR1_CONT; // Continuous conversions
+		ADC1->CR |= ADC_CR_ADSTART; // Start scanning
 	}
-	return 0; // Invalid channel selection, do not read ADC
+	return dmaChannel;
+}
+
+uint32_t adcScanStartTriggered(ADCScan_TypeDef* scan, uint32_t channelMask, uint16_t* buffer, uint16_t depth, uint8_t triggerSource, uint32_t sampleRate) {
+	// Starts scanning a set of channels at a fixed rate set by a timer trigger, with DMA streaming the results into a ring buffer
+	uint16_t prescaler;
+	uint16_t ticks;
+	if ((__adcTriggerTimer(triggerSource) == 0) || (timerCalculateRate(sampleRate, &prescaler, &ticks) == 0)) {
+		return 0; // Trigger must be a timer and the rate must be reachable
+	}
+	if (!__adcScanSetup(scan, channelMask, buffer, depth)) {
+		return 0; // Scan could not be set up
+	}
+	return adcTriggerStart(triggerSource, sampleRate);
 }
+
+TIM_TypeDef* __adcTriggerTimer(uint8_t triggerSource) {
+	// Returns the timer behind an ADC trigger source
+	if (triggerSource == ADC_TRIGGER_TIM1) {
+		return TIM1;
+	}
+	else if (triggerSource == ADC_TRIGGER_TIM2) {
+		return TIM2;
+	}
+	else if (triggerSource == ADC_TRIGGER_TIM3) {
+		return TIM3;
+	}
+	else if (triggerSource == ADC_TRIGGER_TIM15) {
+		return TIM15;
+	}
+	return 0; // Not a timer trigger
+}
+
+uint32_t adcTriggerStart(uint8_t triggerSource, uint32_t sampleRate) {
+	// Starts conversions of the selected channels on every update of a timer
+	TIM_TypeDef* timer = __adcTriggerTimer(triggerSource);
+	uint16_t prescaler;
+	uint16_t ticks;
+	if (timer == 0) {
+		return 0; // Trigger must be a timer
+	}
+	uint32_t achievedRate = timerCalculateRate(sampleRate, &prescaler, &ticks);
+	if (achievedRate == 0) {
+		return 0; // Sample rate can not be reached
+	}
+
+	__adcStop(); // The configuration can only change while the ADC is idle
+	ADC1->CFGR1 = ((ADC1->CFGR1 & ~(ADC_CFGR1_CONT | ADC_CFGR1_EXTEN | ADC_CFGR1_EXTSEL)) | ADC_CFGR1_EXTEN_0 | (ADC_CFGR1_EXTSEL & (triggerSource << 6))); // Convert the sequence on each rising edge of the trigger
+	ADC1->CR |= ADC_CR_ADSTART; // Arm the ADC, conversions now wait for the trigger
+
+	adcTriggerTimerRunning = timer;
+	init_timer(timer, prescaler); // Initialise the trigger timer
+	timerTriggerOutput(timer, TIMER_TRGO_UPDATE); // Drive TRGO on every update
+	startRepeatingTimer(timer, ticks); // Start triggering
+	return achievedRate;
+}
+
+void adcTriggerStop() {
+	// Stops timer triggered conversions
+	if (adcTriggerTimerRunning) {
+		stopTimer(adcTriggerTimerRunning); // Stop triggering
+		adcTriggerTimerRunning = 0;
+	}
+	__adcStop();
+	ADC1->CFGR1 &= ~(ADC_CFGR1_EXTEN | ADC_CFGR1_EXTSEL); // Back to software started conversions
+}
+
+uint16_t adcScanPosition(ADCScan_TypeDef* scan) {
+	// Returns the index in the ring buffer the next sample will be written to
+	uint16_t remaining = (uint16_t)__dmaChannelAddress(scan->dmaChannel)->CNDTR;
+	return (remaining == 0) ? 0 : (scan->length - remaining); // CNDTR reloads to length at the wrap
+}
+
+uint16_t adcScanRead(ADCScan_TypeDef* scan, uint8_t channel) {
+	// Returns the latest sample of a scanned channel
+	if ((channel >= ADC_CHANNEL_COUNT) || (scan->rank[channel] == ADC_CHANNEL_NONE)) {
+		return 0; // Channel is not scanned
+	}
+	uint16_t rank = scan->rank[channel];
+	uint16_t latest = adcScanPosition(scan);
+	latest = (latest ? latest : scan->length) - 1; // Last sample written
+	uint16_t latestRank = latest % scan->channels;
+	int32_t index = (int32_t)latest - latestRank + rank; // Same sequence as the last sample
+	if (rank > latestRank) {
+		index -= scan->channels; // Channel has not been converted yet in this sequence, use the previous one
+	}
+	if (index < 0) {
+		index += scan->length; // Wrap around the ring buffer
+	}
+	return scan->buffer[index];
+}
+
+void adcScanStop(ADCScan_TypeDef* scan) {
+	// Stops scanning and releases the DMA channel
+	adcTriggerStop(); // Stops the ADC, and the trigger timer if the scan was triggered
+	ADC1->CFGR1 &= ~(ADC_CFGR1_CONT | ADC_CFGR1_DMACFG | ADC_CFGR1_DMAEN); // Back to single software-started conversions
+	if (scan->dmaChannel) {
+		__dmaChannelAddress(scan->dmaChannel)->CCR &= ~DMA_CCR_EN; // Stop the DMA channel
+		dmaChannelFree(scan->dmaChannel); // Release the DMA channel
+		scan->dmaChannel = 0;
+	}
+}
\ No newline at end of file
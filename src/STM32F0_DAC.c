@@ -18,6 +18,15 @@ Functions for operating the Digital to Analog converter
 #define STM32F0_DAC_H
 #endif
 
+/* GLOBAL VARIABLES */
+static uint16_t* dacPendingTable[2] = { 0, 0 }; // Waveform table to switch to at the next wrap (per DAC channel)
+static uint16_t dacPendingLength[2] = { 0, 0 }; // Length of the pending waveform table (per DAC channel)
+static TIM_TypeDef* dacTriggerTimers[2] = { 0, 0 }; // Timer started to pace triggered output (per DAC channel)
+static DACStream_TypeDef* dacStreamPlayer = 0; // Stream playing on DAC channel 1
+static DACDDS_TypeDef* dacDDSGenerator = 0; // DDS generator playing on DAC channel 1
+static DACPackedDecoder_TypeDef* dacPackedPlaying = 0; // Packed waveform decoder feeding the DAC stream
+static uint32_t dacPacedLate = 0; // Samples written too late during the last paced playback
+
 /* FUNCTIONS */
 void init_DAC(uint8_t channel, uint8_t buffer, uint8_t triggerEnable, uint8_t triggerSource) {
 	// Initialises and configures  DAC channel
@@ -123,6 +132,24 @@ void dacValueOut(uint8_t channel, uint16_t value, uint8_t mode) {
 	}
 }
 
+void dacHandleInit(DACHandle_TypeDef* handle, uint8_t channel, uint8_t mode) {
+	// Resolves the data holding register and data mask for a DAC channel and mode
+	handle->dataRegister = (volatile uint32_t*)__dacDataRegister(channel, mode);
+	handle->mask = __dacDataMask(mode);
+}
+
+void dacHandleWaveOut(const DACHandle_TypeDef* handle, uint16_t* values, uint16_t length) {
+	// Outputs a series of analog values in sequence through a DAC handle
+	volatile uint32_t* dataRegister = handle->dataRegister;
+	uint16_t mask = handle->mask;
+	if (dataRegister == 0) {
+		return; // Invalid handle, do nothing
+	}
+	for (uint16_t i = 0; i < length; i++) {
+		*dataRegister = (values[i] & mask);
+	}
+}
+
 void dacWaveOut(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t length) {
 	// Outputs a series of analog values in sequence using the DAC
 	if (channel == 1) {
@@ -241,7 +268,7 @@ void dacWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t length
 
 
 /*
-NOTE: Uses DMA channel 2 and TIM17 for DAC channel 1 and DMA channel 3 and TIM16 for DAC channel 2
+NOTE: Uses TIM17 (DMA channel 1 or 2) for DAC channel 1 and TIM16 (DMA channel 3 or 4) for DAC channel 2
 channel - the DAC channel to output on
 values - a pointer to an array of analog values to output
 mode - 8/12 bit, left/right aligned
@@ -252,9 +279,17 @@ void dacDMAWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t len
 	// Enables waveform generation using DMA (repeats forever...)
 	uint32_t peripheralAddress;
 	uint32_t memoryAddress = (uint32_t)values; // Address of waveform values in memory
+	uint8_t dmaChannel; // DMA channel serving the timer request
 
 	if (channel == 1) {
 		// Configure channel 1
+		if (dmaChannelOwnedBy(DMA_REQUEST_TIM17)) {
+			dacDMAWaveGenDisable(1); // Already generating, release its DMA channel before starting again
+		}
+		dmaChannel = dmaChannelAllocate(DMA_REQUEST_TIM17); // Get a DMA channel for TIM17 (remaps TIM17 if channel 1 is taken)
+		if (!dmaChannel) {
+			return; // No DMA channel available, do nothing
+		}
 		if (!(mode & DAC_MODE_RESOLUTION)) {
 			// 8 bit mode
 			peripheralAddress = (uint32_t)(&DAC->DHR8R1);
@@ -269,15 +304,22 @@ void dacDMAWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t len
 				peripheralAddress = (uint32_t)(&DAC->DHR12R1);
 			}
 		}
-		init_DMA(2, peripheralAddress, memoryAddress, length, DMA_PRIORITY_LOW, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERMODE_CIRCULAR, DMA_INCREMENT_MEMORY, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD); // Initialise DMA
+		init_DMA(dmaChannel, peripheralAddress, memoryAddress, length, DMA_PRIORITY_LOW, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERMODE_CIRCULAR, DMA_INCREMENT_MEMORY, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD); // Initialise DMA
 		init_timer(TIM17, 47); // Initialise timer 17 to tick every uS
 		startRepeatingTimer(TIM17, period - 1); // Set to overflow/update every period - 1 uS
+		TIM17->CR1 |= TIM_CR1_ARPE; // Buffer ARR so period changes take effect at the next update
 		TIM17->CR2 |= TIM_CR2_CCDS; // Change DMA request to send on update
 		TIM17->DIER |= TIM_DIER_UDE; // Enable DMA request generation
-		SYSCFG->CFGR1 |= SYSCFG_CFGR1_TIM17_DMA_RMP; // Remap TIM17 to trigger DMA
 	}
 	else if (channel == 2) {
 		// Configure channel 2
+		if (dmaChannelOwnedBy(DMA_REQUEST_TIM16)) {
+			dacDMAWaveGenDisable(2); // Already generating, release its DMA channel before starting again
+		}
+		dmaChannel = dmaChannelAllocate(DMA_REQUEST_TIM16); // Get a DMA channel for TIM16 (remaps TIM16 if channel 3 is taken)
+		if (!dmaChannel) {
+			return; // No DMA channel available, do nothing
+		}
 		if (!(mode & DAC_MODE_RESOLUTION)) {
 			// 8 bit mode
 			peripheralAddress = (uint32_t)(&DAC->DHR8R2);
@@ -292,9 +334,10 @@ void dacDMAWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t len
 				peripheralAddress = (uint32_t)(&DAC->DHR12R2);
 			}
 		}
-		init_DMA(3, peripheralAddress, memoryAddress, length, DMA_PRIORITY_LOW, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERMODE_CIRCULAR, DMA_INCREMENT_MEMORY, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD); // Initialise DMA
+		init_DMA(dmaChannel, peripheralAddress, memoryAddress, length, DMA_PRIORITY_LOW, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERMODE_CIRCULAR, DMA_INCREMENT_MEMORY, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD); // Initialise DMA
 		init_timer(TIM16, 47); // Initialise timer 17 to tick every uS
 		startRepeatingTimer(TIM16, period - 1); // Set to overflow/update every period uS
+		TIM16->CR1 |= TIM_CR1_ARPE; // Buffer ARR so period changes take effect at the next update
 		TIM16->CR2 |= TIM_CR2_CCDS; // Change DMA request to send on update
 		TIM16->DIER |= TIM_DIER_UDE; // Enable DMA request generation
 	}
@@ -306,13 +349,604 @@ void dacDMAWaveGenDisable(uint8_t channel) {
 		// Stop wave gen on CH1
 		stopTimer(TIM17); // Stop the timer
 		TIM17->DIER &= ~TIM_DIER_UDE; // Disable DMA request generation
-		dmaChannelDisable(2); // Disable the DMA channel
-		SYSCFG->CFGR1 &= ~SYSCFG_CFGR1_TIM17_DMA_RMP; // Reset TIM17 mapping
+		__dacWaveGenRelease(DMA_REQUEST_TIM17); // Disable and release the DMA channel/s in use
+		dacPendingTable[channel - 1] = 0; // Drop any pending table swap
 	}
 	else if (channel == 2) {
 		// Stop wave gen on CH2
 		stopTimer(TIM16); // Stop the timer
 		TIM16->DIER &= ~TIM_DIER_UDE; // Disable DMA request generation
-		dmaChannelDisable(3); // Disable the DMA channel
+		__dacWaveGenRelease(DMA_REQUEST_TIM16); // Disable and release the DMA channel/s in use
+		dacPendingTable[channel - 1] = 0; // Drop any pending table swap
+	}
+}
+
+void __dacWaveGenRelease(uint8_t request) {
+	// Disables and releases every DMA channel owned by a waveform generation timer request
+	uint8_t dmaChannel;
+	while ((dmaChannel = dmaChannelOwnedBy(request))) {
+		dmaChannelDisable(dmaChannel); // Disable the DMA channel
+		dmaSetChannelHandler(dmaChannel, 0); // Remove any table swap handler
+		dmaChannelFree(dmaChannel); // Release the DMA channel
+	}
+}
+
+uint32_t dacPacedWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t length, uint32_t repetitions, uint8_t triggerSource, uint32_t sampleRate) {
+	// Outputs a series of analog values multiple times using the DAC, paced by a timer trigger (CPU writes, no DMA)
+	TIM_TypeDef* timer = __dacTriggerTimer(triggerSource);
+	DACHandle_TypeDef handle;
+	uint16_t prescaler;
+	uint16_t ticks;
+
+	dacPacedLate = 0;
+	dacHandleInit(&handle, channel, mode);
+	if ((handle.dataRegister == 0) || (timer == 0) || (length == 0) || (repetitions == 0)) {
+		return 0; // Invalid channel, trigger must be a timer, nothing to play
+	}
+	uint32_t achievedRate = timerCalculateRate(sampleRate, &prescaler, &ticks);
+	if (achievedRate == 0) {
+		return 0; // Sample rate can not be reached
+	}
+
+	// Each trigger moves DHR to DOR, so the output changes exactly on the timer update and the CPU only has to write the next sample within one period
+	uint8_t shift = 16 * (channel - 1); // Channel 2 bits sit 16 bits above channel 1 bits
+	uint32_t cr = (DAC->CR & ~((DAC_CR_EN1 | DAC_CR_TSEL1 | DAC_CR_WAVE1 | DAC_CR_MAMP1 | DAC_CR_DMAEN1) << shift)); // Keep the buffer setting
+	DAC->CR = cr; // Disable the channel for configuration
+	DAC->CR = (cr | ((DAC_CR_TEN1 | (DAC_CR_TSEL1 & (triggerSource << 3)) | DAC_CR_EN1) << shift)); // Trigger, enable
+
+	dacHandleWrite(&handle, values[0]); // First sample is moved to the output by the first trigger
+	__dacTriggerTimerStart(channel, timer, prescaler, ticks); // Start triggering
+
+	uint16_t i = 1;
+	while (repetitions) {
+		if (i == length) {
+			i = 0; // Wrap to the start of the table
+			if (--repetitions == 0) {
+				break; // Last sample has been written
+			}
+		}
+		while (!timerComplete(timer)); // Wait for the trigger that outputs the previous sample
+		clearStatusFlag(timer);
+		dacHandleWrite(&handle, values[i++]); // Next sample waits in DHR for the next trigger
+		if (timerComplete(timer)) {
+			dacPacedLate++; // Next trigger came before the write, the previous sample was held for an extra period
+		}
+	}
+	while (!timerComplete(timer)); // Wait for the last sample to be output
+
+	stopTimer(timer); // Stop triggering
+	dacTriggerTimers[channel - 1] = 0;
+	DAC->CR &= ~(DAC_CR_TEN1 << shift); // Write DHR straight through again
+	dacValueOut(channel, 0, mode); // Set back to 0 when complete
+	return achievedRate;
+}
+
+uint32_t dacPacedLateSamples() {
+	// Returns the number of samples written too late during the last paced playback
+	return dacPacedLate;
+}
+
+void dacDMADualWaveGen(void* values, uint8_t mode, uint16_t length, uint16_t period) {
+	// Enables synchronous waveform generation on both DAC channels from one DMA channel (repeats forever...)
+	uint32_t peripheralAddress;
+	uint8_t transferSize;
+	if (dmaChannelOwnedBy(DMA_REQUEST_TIM17)) {
+		dacDMAWaveGenDisable(1); // Already generating, release its DMA channel before starting again
+	}
+	uint8_t dmaChannel = dmaChannelAllocate(DMA_REQUEST_TIM17); // Get a DMA channel for TIM17 (remaps TIM17 if channel 1 is taken)
+	if (!dmaChannel) {
+		return; // No DMA channel available, do nothing
+	}
+
+	if (!(mode & DAC_MODE_RESOLUTION)) {
+		// 8 bit mode, both channels in one halfword
+		peripheralAddress = (uint32_t)(&DAC->DHR8RD);
+		transferSize = DMA_TRANSFERSIZE_HALFWORD;
+	}
+	else {
+		if (mode & DAC_MODE_DATAALIGNMENT) {
+			// 12 bit left aligned mode, both channels in one word
+			peripheralAddress = (uint32_t)(&DAC->DHR12LD);
+		}
+		else {
+			// 12 bit right aligned mode, both channels in one word
+			peripheralAddress = (uint32_t)(&DAC->DHR12RD);
+		}
+		transferSize = DMA_TRANSFERSIZE_WORD;
+	}
+	init_DMA(dmaChannel, peripheralAddress, (uint32_t)values, length, DMA_PRIORITY_LOW, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERMODE_CIRCULAR, DMA_INCREMENT_MEMORY, transferSize, transferSize); // Initialise DMA
+	init_timer(TIM17, 47); // Initialise timer 17 to tick every uS
+	startRepeatingTimer(TIM17, period - 1); // Set to overflow/update every period - 1 uS
+	TIM17->CR1 |= TIM_CR1_ARPE; // Buffer ARR so period changes take effect at the next update
+	TIM17->CR2 |= TIM_CR2_CCDS; // Change DMA request to send on update
+	TIM17->DIER |= TIM_DIER_UDE; // Enable DMA request generation
+}
+
+void dacDMADualWaveGenDisable() {
+	// Disables synchronous dual channel waveform generation
+	dacDMAWaveGenDisable(1); // Dual generation runs on the DAC channel 1 timer and DMA channel
+}
+
+uint16_t __dacDataMask(uint8_t mode) {
+	// Returns the valid data bits for a mode
+	if (!(mode & DAC_MODE_RESOLUTION)) {
+		return 0x00FF; // 8 bit mode
+	}
+	else if (mode & DAC_MODE_DATAALIGNMENT) {
+		return 0xFFF0; // 12 bit left aligned mode
+	}
+	return 0x0FFF; // 12 bit right aligned mode
+}
+
+uint32_t __dacDataRegister(uint8_t channel, uint8_t mode) {
+	// Returns the address of the data holding register for a channel and mode
+	if (channel == 1) {
+		if (!(mode & DAC_MODE_RESOLUTION)) {
+			return (uint32_t)(&DAC->DHR8R1); // 8 bit mode
+		}
+		else if (mode & DAC_MODE_DATAALIGNMENT) {
+			return (uint32_t)(&DAC->DHR12L1); // 12 bit left aligned mode
+		}
+		return (uint32_t)(&DAC->DHR12R1); // 12 bit right aligned mode
+	}
+	else if (channel == 2) {
+		if (!(mode & DAC_MODE_RESOLUTION)) {
+			return (uint32_t)(&DAC->DHR8R2); // 8 bit mode
+		}
+		else if (mode & DAC_MODE_DATAALIGNMENT) {
+			return (uint32_t)(&DAC->DHR12L2); // 12 bit left aligned mode
+		}
+		return (uint32_t)(&DAC->DHR12R2); // 12 bit right aligned mode
+	}
+	return 0; // Invalid channel
+}
+
+void __dacTriggeredDMAEnable(uint8_t triggerSource) {
+	// Enables DAC channel 1 with a hardware trigger and DMA requests
+	// Each trigger moves DHR to DOR, then the DAC requests the next sample into DHR, so the output timing does not depend on DMA latency
+	uint32_t cr = (DAC->CR & ~(DAC_CR_EN1 | DAC_CR_TSEL1 | DAC_CR_WAVE1 | DAC_CR_MAMP1)); // Keep the buffer setting
+	DAC->CR = cr; // Disable CH1 for configuration
+	DAC->CR = (cr | DAC_CR_TEN1 | (DAC_CR_TSEL1 & (triggerSource << 3)) | DAC_CR_DMAEN1 | DAC_CR_EN1); // Trigger, DMA requests, enable
+}
+
+void __dacTriggerTimerStart(uint8_t channel, TIM_TypeDef* timer, uint16_t prescaler, uint16_t ticks) {
+	// Starts a timer driving TRGO on every update to trigger a DAC channel
+	dacTriggerTimers[channel - 1] = timer;
+	init_timer(timer, prescaler); // Initialise the trigger timer
+	timerTriggerOutput(timer, TIMER_TRGO_UPDATE); // Drive TRGO on every update
+	startRepeatingTimer(timer, ticks); // Start triggering
+}
+
+TIM_TypeDef* __dacTriggerTimer(uint8_t triggerSource) {
+	// Returns the timer behind a DAC trigger source (0 if the source is not a timer available on the STM32F051)
+	switch (triggerSource) {
+	case DAC_TRIGGER_TIM6: return TIM6;
+	case DAC_TRIGGER_TIM3: return TIM3;
+	case DAC_TRIGGER_TIM15: return TIM15;
+	case DAC_TRIGGER_TIM2: return TIM2;
+	default: return 0;
+	}
+}
+
+uint32_t dacDMATriggeredWaveGen(uint8_t channel, uint16_t* values, uint8_t mode, uint16_t length, uint8_t triggerSource, uint32_t sampleRate) {
+	// Enables waveform generation paced by a timer trigger, with the DAC requesting its own DMA transfers (repeats forever...)
+	uint32_t peripheralAddress;
+	TIM_TypeDef* timer = __dacTriggerTimer(triggerSource);
+	uint16_t prescaler;
+	uint16_t ticks;
+
+	if ((channel != 1) || (timer == 0)) {
+		return 0; // Only DAC channel 1 has a DMA request on the STM32F051, and the trigger must be a timer
+	}
+	uint32_t achievedRate = timerCalculateRate(sampleRate, &prescaler, &ticks);
+	if (achievedRate == 0) {
+		return 0; // Sample rate can not be reached
+	}
+	uint8_t dmaChannel = dmaChannelAllocate(DMA_REQUEST_TIM6_UP); // The DAC channel 1 request shares DMA channel 3 with TIM6_UP
+	if (!dmaChannel) {
+		return 0; // No DMA channel available, do nothing
+	}
+
+	peripheralAddress = __dacDataRegister(channel, mode); // Data holding register for the mode
+	init_DMA(dmaChannel, peripheralAddress, (uint32_t)values, length, DMA_PRIORITY_HIGH, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERMODE_CIRCULAR, DMA_INCREMENT_MEMORY, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD); // Initialise DMA
+
+	__dacTriggeredDMAEnable(triggerSource); // Trigger, DMA requests, enable
+
+	__dacTriggerTimerStart(1, timer, prescaler, ticks); // Start triggering
+	return achievedRate;
+}
+
+void dacDMATriggeredWaveGenDisable(uint8_t channel) {
+	// Disables timer triggered waveform generation
+	if ((channel != 1) || (dacTriggerTimers[0] == 0)) {
+		return; // Not running
+	}
+	stopTimer(dacTriggerTimers[0]); // Stop triggering
+	dacTriggerTimers[0] = 0;
+	DAC->CR &= ~(DAC_CR_DMAEN1 | DAC_CR_TEN1); // Stop DMA requests, write DHR straight through again
+	uint8_t dmaChannel = dmaRequestChannel(DMA_REQUEST_TIM6_UP); // Find the DMA channel in use
+	if (dmaChannelOwner(dmaChannel) == DMA_REQUEST_TIM6_UP) {
+		dmaChannelDisable(dmaChannel); // Disable the DMA channel
+		dmaChannelFree(dmaChannel); // Release the DMA channel
+	}
+}
+
+uint32_t dacHardwareWaveGen(uint8_t channel, uint8_t wave, uint8_t amplitude, uint16_t offset, uint8_t triggerSource, uint32_t triggerRate) {
+	// Enables the DAC's built-in noise/triangle generation on top of a DC offset
+	if ((channel != 1) && (channel != 2)) {
+		return 0; // Invalid channel
+	}
+	uint8_t shift = 16 * (channel - 1); // Channel 2 bits sit 16 bits above channel 1 bits
+	uint32_t achievedRate = 0;
+
+	// Configure the channel with one write: trigger, wave type and amplitude
+	uint32_t cr = (DAC->CR & ~((DAC_CR_EN1 | DAC_CR_TSEL1 | DAC_CR_WAVE1 | DAC_CR_MAMP1 | DAC_CR_DMAEN1) << shift)); // Keep the buffer setting
+	DAC->CR = cr; // Disable the channel for configuration
+	DAC->CR = (cr | ((DAC_CR_TEN1 | (DAC_CR_TSEL1 & (triggerSource << 3)) | (DAC_CR_WAVE1 & (wave << 6)) | (DAC_CR_MAMP1 & (amplitude << 8)) | DAC_CR_EN1) << shift));
+
+	if (channel == 1) {
+		DAC->DHR12R1 = (0x0FFF & offset); // DC offset the generated wave is added to
+	}
+	else {
+		DAC->DHR12R2 = (0x0FFF & offset); // DC offset the generated wave is added to
+	}
+
+	TIM_TypeDef* timer = __dacTriggerTimer(triggerSource);
+	if (timer) {
+		// Pace the generator with the trigger timer
+		uint16_t prescaler;
+		uint16_t ticks;
+		achievedRate = timerCalculateRate(triggerRate, &prescaler, &ticks);
+		if (achievedRate) {
+			__dacTriggerTimerStart(channel, timer, prescaler, ticks); // Start triggering
+		}
+	}
+	return achievedRate;
+}
+
+void dacHardwareWaveGenDisable(uint8_t channel) {
+	// Disables the DAC's built-in noise/triangle generation (the channel keeps outputting DHR)
+	if ((channel != 1) && (channel != 2)) {
+		return; // Invalid channel
+	}
+	if (dacTriggerTimers[channel - 1]) {
+		stopTimer(dacTriggerTimers[channel - 1]); // Stop the trigger timer started for the channel
+		dacTriggerTimers[channel - 1] = 0;
+	}
+	DAC->CR &= ~((DAC_CR_TEN1 | DAC_CR_WAVE1 | DAC_CR_MAMP1) << (16 * (channel - 1))); // Stop generating, write DHR straight through again
+}
+
+void dacSoftwareTrigger(uint8_t channel) {
+	// Triggers a DAC channel configured with DAC_TRIGGER_SOFTWARE
+	if ((channel == 1) || (channel == 2)) {
+		DAC->SWTRIGR = (DAC_SWTRIGR_SWTRIG1 << (channel - 1)); // Self-clearing
+	}
+}
+
+uint32_t dacStreamStart(DACStream_TypeDef* player, uint16_t* buffer, uint16_t length, uint8_t mode, uint16_t (*source)(uint16_t* samples, uint16_t count), uint8_t triggerSource, uint32_t sampleRate, uint8_t interruptPriority) {
+	// Starts streaming samples pulled from a source function out of DAC channel 1
+	TIM_TypeDef* timer = __dacTriggerTimer(triggerSource);
+	uint16_t prescaler;
+	uint16_t ticks;
+
+	if ((timer == 0) || (length < 2) || (dacStreamPlayer != 0) || (dacDDSGenerator != 0)) {
+		return 0; // Trigger must be a timer, the buffer must split into two halves, and only one stream can play
+	}
+	uint32_t achievedRate = timerCalculateRate(sampleRate, &prescaler, &ticks);
+	if (achievedRate == 0) {
+		return 0; // Sample rate can not be reached
+	}
+	uint8_t dmaChannel = dmaChannelAllocate(DMA_REQUEST_TIM6_UP); // The DAC channel 1 request shares DMA channel 3 with TIM6_UP
+	if (!dmaChannel) {
+		return 0; // No DMA channel available, do nothing
+	}
+
+	player->buffer = buffer;
+	player->length = length & ~0x1; // Whole halves only
+	player->source = source;
+	player->lastSample = 0;
+	player->underruns = 0;
+	dacStreamPlayer = player;
+
+	__dacStreamFill(player, buffer, player->length); // Prime both halves before the first trigger
+	init_DMAStream(&player->stream, dmaChannel, __dacDataRegister(1, mode), (uint32_t)buffer, player->length, DMA_PRIORITY_HIGH, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD, __dacStreamRefill, interruptPriority);
+	__dacTriggeredDMAEnable(triggerSource); // Trigger, DMA requests, enable
+	__dacTriggerTimerStart(1, timer, prescaler, ticks); // Start triggering
+	return achievedRate;
+}
+
+void dacStreamStop(DACStream_TypeDef* player) {
+	// Stops a DAC stream
+	if (dacStreamPlayer != player) {
+		return; // Not playing
+	}
+	if (dacTriggerTimers[0]) {
+		stopTimer(dacTriggerTimers[0]); // Stop triggering
+		dacTriggerTimers[0] = 0;
+	}
+	DAC->CR &= ~(DAC_CR_DMAEN1 | DAC_CR_TEN1); // Stop DMA requests, write DHR straight through again
+	dmaStreamStop(&player->stream); // Stop the DMA channel
+	dmaChannelFree(player->stream.channel); // Release the DMA channel
+	dacStreamPlayer = 0;
+}
+
+uint32_t dacStreamUnderruns(DACStream_TypeDef* player) {
+	// Returns the number of underruns
+	return (player->underruns + player->stream.overruns); // Source ran dry, or the refill interrupt was too late
+}
+
+void __dacStreamFill(DACStream_TypeDef* player, uint16_t* samples, uint16_t count) {
+	// Fills part of the stream buffer from the source, holding the last sample if the source runs dry
+	uint16_t provided = (player->source ? player->source(samples, count) : 0);
+	if (provided > count) {
+		provided = count;
+	}
+	if (provided) {
+		player->lastSample = samples[provided - 1];
+	}
+	if (provided < count) {
+		player->underruns++; // Source could not keep up, hold the output instead of replaying stale data
+		for (uint16_t i = provided; i < count; i++) {
+			samples[i] = player->lastSample;
+		}
+	}
+}
+
+void __dacStreamRefill(DMAStream_TypeDef* stream, uint8_t half) {
+	// Stream callback: refills the half of the buffer that has just been played
+	DACStream_TypeDef* player = dacStreamPlayer;
+	if ((player == 0) || (stream != &player->stream)) {
+		return; // Not the DAC stream
+	}
+	__dacStreamFill(player, (uint16_t*)dmaStreamHalfAddress(stream, half), player->length / 2);
+	dmaStreamRelease(stream, half); // Half is ready to be played again
+}
+
+uint32_t dacDDSStart(DACDDS_TypeDef* dds, const uint16_t* table, uint16_t tableLength, uint16_t* buffer, uint16_t length, uint8_t mode, uint8_t triggerSource, uint32_t sampleRate, uint32_t frequency, uint8_t interruptPriority) {
+	// Starts direct digital synthesis of a wavetable on DAC channel 1
+	TIM_TypeDef* timer = __dacTriggerTimer(triggerSource);
+	uint16_t prescaler;
+	uint16_t ticks;
+	uint8_t tableBits = 0;
+
+	while ((1UL << tableBits) < tableLength) {
+		tableBits++;
+	}
+	if ((timer == 0) || (length < 2) || (tableLength < 2) || ((1UL << tableBits) != tableLength) || (dacStreamPlayer != 0) || (dacDDSGenerator != 0)) {
+		return 0; // Trigger must be a timer, the buffer must split into two halves, the table length must be a power of 2, and only one stream can play
+	}
+	uint32_t achievedRate = timerCalculateRate(sampleRate, &prescaler, &ticks);
+	if (achievedRate == 0) {
+		return 0; // Sample rate can not be reached
+	}
+	uint8_t dmaChannel = dmaChannelAllocate(DMA_REQUEST_TIM6_UP); // The DAC channel 1 request shares DMA channel 3 with TIM6_UP
+	if (!dmaChannel) {
+		return 0; // No DMA channel available, do nothing
+	}
+
+	dds->table = table;
+	dds->shift = 32 - tableBits; // Top bits of the phase index the table
+	dds->phase = 0;
+	dds->sampleRate = achievedRate;
+	dds->buffer = buffer;
+	dds->length = length & ~0x1; // Whole halves only
+	dacDDSSetFrequency(dds, frequency); // Phase increment for the requested frequency
+	dacDDSGenerator = dds;
+
+	__dacDDSFill(dds, buffer, dds->length); // Prime both halves before the first trigger
+	init_DMAStream(&dds->stream, dmaChannel, __dacDataRegister(1, mode), (uint32_t)buffer, dds->length, DMA_PRIORITY_HIGH, DMA_TRANSFERDIRECTION_M2P, DMA_TRANSFERSIZE_HALFWORD, DMA_TRANSFERSIZE_HALFWORD, __dacDDSRefill, interruptPriority);
+	__dacTriggeredDMAEnable(triggerSource); // Trigger, DMA requests, enable
+	__dacTriggerTimerStart(1, timer, prescaler, ticks); // Start triggering
+	return achievedRate;
+}
+
+uint32_t dacDDSSetFrequency(DACDDS_TypeDef* dds, uint32_t frequency) {
+	// Changes the output frequency of direct digital synthesis (phase continuous)
+	// increment = frequency * 2^32 / sampleRate, both in millihertz (64 bit maths, configuration only)
+	uint32_t increment = (uint32_t)((((uint64_t)frequency << 32) + (dds->sampleRate / 2)) / dds->sampleRate);
+	dds->increment = increment; // Single word store, picked up by the next half refill
+	return (uint32_t)(((uint64_t)increment * dds->sampleRate) >> 32); // Achieved frequency
+}
+
+void dacDDSStop(DACDDS_TypeDef* dds) {
+	// Stops direct digital synthesis
+	if (dacDDSGenerator != dds) {
+		return; // Not playing
+	}
+	if (dacTriggerTimers[0]) {
+		stopTimer(dacTriggerTimers[0]); // Stop triggering
+		dacTriggerTimers[0] = 0;
+	}
+	DAC->CR &= ~(DAC_CR_DMAEN1 | DAC_CR_TEN1); // Stop DMA requests, write DHR straight through again
+	dmaStreamStop(&dds->stream); // Stop the DMA channel
+	dmaChannelFree(dds->stream.channel); // Release the DMA channel
+	dacDDSGenerator = 0;
+}
+
+void dacPackedWaveReset(DACPackedDecoder_TypeDef* decoder, const DACPackedWave_TypeDef* wave) {
+	// Starts decoding a packed waveform from the beginning of its period
+	decoder->wave = wave;
+	decoder->position = (const uint8_t*)wave->data;
+	decoder->index = 0;
+	decoder->current = 0;
+	decoder->repeat = 0;
+}
+
+void dacPackedWaveDecode(DACPackedDecoder_TypeDef* decoder, uint16_t* samples, uint16_t count) {
+	// Expands the next samples of a packed waveform (wraps around at the end of each period)
+	const DACPackedWave_TypeDef* wave = decoder->wave;
+	uint16_t length = wave->length;
+	uint16_t index = decoder->index;
+
+	if (length == 0) {
+		return; // Empty waveform, do nothing
+	}
+	if (wave->format == DAC_PACKED_QUARTERWAVE) {
+		// Fold the index into the stored quarter: rising quarter, mirrored falling quarter, then both reflected
+		const uint16_t* quarter = (const uint16_t*)wave->data;
+		uint16_t quarterLength = length / 4;
+		uint16_t halfLength = 2 * quarterLength;
+		while (count--) {
+			if (index == length) {
+				index = 0; // Wrap to the start of the period
+			}
+			uint16_t j = (index < halfLength) ? index : (index - halfLength);
+			uint16_t value = quarter[(j <= quarterLength) ? j : (halfLength - j)];
+			*samples++ = (index < halfLength) ? value : (uint16_t)(wave->reflect - value);
+			index++;
+		}
 	}
+	else if (wave->format == DAC_PACKED_DELTA) {
+		// Walk the token stream, one token per sample except inside runs
+		const uint8_t* position = decoder->position;
+		uint16_t current = decoder->current;
+		uint8_t repeat = decoder->repeat;
+		while (count--) {
+			if (index == length) {
+				index = 0; // Wrap to the start of the period
+				position = (const uint8_t*)wave->data;
+				repeat = 0;
+			}
+			if (repeat) {
+				repeat--; // Inside a run, hold the sample
+			}
+			else {
+				uint8_t token = *position++;
+				if (!(token & DAC_PACKED_TOKEN_RUN)) {
+					current += (uint16_t)((int8_t)(token << 1) >> 1); // Sign extend the 7 bit delta
+				}
+				else if ((token & DAC_PACKED_TOKEN_ABSOLUTE) == DAC_PACKED_TOKEN_RUN) {
+					repeat = (token & 0x3F); // This sample plus n more
+				}
+				else {
+					current = (position[0] | (position[1] << 8)); // Absolute sample, little endian
+					position += 2;
+				}
+			}
+			*samples++ = current;
+			index++;
+		}
+		decoder->position = position;
+		decoder->current = current;
+		decoder->repeat = repeat;
+	}
+	decoder->index = index;
+}
+
+uint32_t dacPackedWaveStart(DACPackedDecoder_TypeDef* decoder, const DACPackedWave_TypeDef* wave, uint16_t* buffer, uint16_t length, uint8_t mode, uint8_t triggerSource, uint32_t sampleRate, uint8_t interruptPriority) {
+	// Plays a packed waveform on DAC channel 1, expanding it into a ping-pong DMA buffer
+	if (dacPackedPlaying != 0) {
+		return 0; // Only one packed waveform can play
+	}
+	dacPackedWaveReset(decoder, wave);
+	dacPackedPlaying = decoder;
+	uint32_t achievedRate = dacStreamStart(&decoder->player, buffer, length, mode, __dacPackedSource, triggerSource, sampleRate, interruptPriority);
+	if (achievedRate == 0) {
+		dacPackedPlaying = 0; // Stream could not be started
+	}
+	return achievedRate;
+}
+
+void dacPackedWaveStop(DACPackedDecoder_TypeDef* decoder) {
+	// Stops playing a packed waveform
+	if (dacPackedPlaying != decoder) {
+		return; // Not playing
+	}
+	dacStreamStop(&decoder->player);
+	dacPackedPlaying = 0;
+}
+
+uint16_t __dacPackedSource(uint16_t* samples, uint16_t count) {
+	// Stream source: expands the playing packed waveform
+	if (dacPackedPlaying == 0) {
+		return 0; // Nothing to decode
+	}
+	dacPackedWaveDecode(dacPackedPlaying, samples, count);
+	return count; // A packed waveform never runs dry
+}
+
+void __dacDDSFill(DACDDS_TypeDef* dds, uint16_t* samples, uint16_t count) {
+	// Fills part of the DDS buffer by stepping the phase accumulator through the wavetable
+	// Inner loop is add, shift, table load, store, pointer step, compare and branch (no division or 64 bit maths per sample)
+	// Measured by the [dac dds] workload and __dacDDSFill budget of the host bench (bench cycles, not Cortex-M0 cycles: profile on target before relying on a CPU share)
+	const uint16_t* table = dds->table;
+	uint32_t phase = dds->phase;
+	uint32_t increment = dds->increment;
+	uint8_t shift = dds->shift;
+	uint16_t* end = samples + count;
+
+	while (samples != end) {
+		*samples++ = table[phase >> shift];
+		phase += increment; // Wraps at 2^32, one full table cycle
+	}
+	dds->phase = phase;
+}
+
+void __dacDDSRefill(DMAStream_TypeDef* stream, uint8_t half) {
+	// Stream callback: refills the half of the DDS buffer that has just been played
+	DACDDS_TypeDef* dds = dacDDSGenerator;
+	if ((dds == 0) || (stream != &dds->stream)) {
+		return; // Not the DDS stream
+	}
+	__dacDDSFill(dds, (uint16_t*)dmaStreamHalfAddress(stream, half), dds->length / 2);
+	dmaStreamRelease(stream, half); // Half is ready to be played again
+}
+
+void dacDMAWaveSetPeriod(uint8_t channel, uint16_t period) {
+	// Changes the sample period of DMA waveform generation without restarting it
+	// ARR is preloaded (ARPE), so the new period takes effect at the next update event and the current sample completes normally
+	if (channel == 1) {
+		TIM17->ARR = period - 1; // Set to overflow/update every period uS
+	}
+	else if (channel == 2) {
+		TIM16->ARR = period - 1; // Set to overflow/update every period uS
+	}
+}
+
+void dacDMAWaveSetTable(uint8_t channel, uint16_t* values, uint16_t length) {
+	// Switches DMA waveform generation to a new table at the end of the current pass
+	uint8_t dmaChannel; // DMA channel serving the timer request
+	if (channel == 1) {
+		dmaChannel = dmaRequestChannel(DMA_REQUEST_TIM17);
+		if (dmaChannelOwner(dmaChannel) != DMA_REQUEST_TIM17) {
+			return; // Waveform generation not running
+		}
+	}
+	else if (channel == 2) {
+		dmaChannel = dmaRequestChannel(DMA_REQUEST_TIM16);
+		if (dmaChannelOwner(dmaChannel) != DMA_REQUEST_TIM16) {
+			return; // Waveform generation not running
+		}
+	}
+	else {
+		return; // Invalid channel
+	}
+
+	dacPendingTable[channel - 1] = values;
+	dacPendingLength[channel - 1] = length;
+	DMA1->IFCR = (DMA_IFCR_CTCIF1 << (4 * (dmaChannel - 1))); // The circular channel sets TCIF every pass, clear it so only the next wrap swaps the table
+	dmaSetChannelHandler(dmaChannel, __dacDMAWaveEvent); // Swap from the transfer complete interrupt
+	dmaInterruptConfig(dmaChannel, DMA_INTERRUPT_TRANSFERCOMPLETE, DAC_DMA_INTERRUPT_PRIORITY);
 }
+
+void __dacDMAWaveEvent(uint8_t dmaChannel, uint8_t events) {
+	// DMA channel handler for waveform generation: swaps in the pending table at the wrap point
+	// The last sample of the pass has just been transferred and the next one is not requested until the next timer update,
+	// so the channel can be reprogrammed without dropping or repeating a sample
+	uint8_t channel;
+	if (dmaChannelOwner(dmaChannel) == DMA_REQUEST_TIM17) {
+		channel = 1;
+	}
+	else if (dmaChannelOwner(dmaChannel) == DMA_REQUEST_TIM16) {
+		channel = 2;
+	}
+	else {
+		return; // Not a waveform channel
+	}
+
+	if ((events & DMA_EVENT_TRANSFERCOMPLETE) && dacPendingTable[channel - 1]) {
+		dmaRearm(dmaChannel, (uint32_t)dacPendingTable[channel - 1], dacPendingLength[channel - 1]); // Restart from the new table
+		dacPendingTable[channel - 1] = 0;
+	}
+	__dmaChannelAddress(dmaChannel)->CCR &= ~DMA_CCR_TCIE; // No more swaps pending, stop interrupting every pass
+}
\ No newline at end of file
@@ -17,6 +17,72 @@ Functions for configuring/controlling the direct memory access module
 #define STM32F0_DMA_H
 #endif
 
+/* GLOBAL VARIABLES */
+typedef struct {
+	// Routing of a DMA request to its channel
+	uint8_t channel; // Default channel
+	uint8_t remapChannel; // Channel when remapped (0 if not remappable)
+	uint32_t remapBit; // SYSCFG_CFGR1 remap bit
+} DMARequestMapping_TypeDef;
+
+static const DMARequestMapping_TypeDef dmaRequestMap[DMA_REQUEST_COUNT] = {
+	{ 0, 0, 0 }, // DMA_REQUEST_NONE
+	{ 0, 0, 0 }, // DMA_REQUEST_MEM2MEM
+	{ 1, 2, SYSCFG_CFGR1_ADC_DMA_RMP }, // DMA_REQUEST_ADC
+	{ 2, 0, 0 }, // DMA_REQUEST_SPI1_RX
+	{ 3, 0, 0 }, // DMA_REQUEST_SPI1_TX
+	{ 4, 0, 0 }, // DMA_REQUEST_SPI2_RX
+	{ 5, 0, 0 }, // DMA_REQUEST_SPI2_TX
+	{ 2, 4, SYSCFG_CFGR1_USART1TX_DMA_RMP }, // DMA_REQUEST_USART1_TX
+	{ 3, 5, SYSCFG_CFGR1_USART1RX_DMA_RMP }, // DMA_REQUEST_USART1_RX
+	{ 4, 0, 0 }, // DMA_REQUEST_USART2_TX
+	{ 5, 0, 0 }, // DMA_REQUEST_USART2_RX
+	{ 2, 0, 0 }, // DMA_REQUEST_I2C1_TX
+	{ 3, 0, 0 }, // DMA_REQUEST_I2C1_RX
+	{ 4, 0, 0 }, // DMA_REQUEST_I2C2_TX
+	{ 5, 0, 0 }, // DMA_REQUEST_I2C2_RX
+	{ 2, 0, 0 }, // DMA_REQUEST_TIM1_CH1
+	{ 3, 0, 0 }, // DMA_REQUEST_TIM1_CH2
+	{ 5, 0, 0 }, // DMA_REQUEST_TIM1_CH3
+	{ 4, 0, 0 }, // DMA_REQUEST_TIM1_CH4
+	{ 5, 0, 0 }, // DMA_REQUEST_TIM1_UP
+	{ 5, 0, 0 }, // DMA_REQUEST_TIM2_CH1
+	{ 3, 0, 0 }, // DMA_REQUEST_TIM2_CH2
+	{ 1, 0, 0 }, // DMA_REQUEST_TIM2_CH3
+	{ 4, 0, 0 }, // DMA_REQUEST_TIM2_CH4
+	{ 2, 0, 0 }, // DMA_REQUEST_TIM2_UP
+	{ 4, 0, 0 }, // DMA_REQUEST_TIM3_CH1
+	{ 2, 0, 0 }, // DMA_REQUEST_TIM3_CH3
+	{ 3, 0, 0 }, // DMA_REQUEST_TIM3_CH4
+	{ 3, 0, 0 }, // DMA_REQUEST_TIM6_UP
+	{ 5, 0, 0 }, // DMA_REQUEST_TIM15
+	{ 3, 4, SYSCFG_CFGR1_TIM16_DMA_RMP }, // DMA_REQUEST_TIM16
+	{ 1, 2, SYSCFG_CFGR1_TIM17_DMA_RMP } // DMA_REQUEST_TIM17
+};
+
+static uint8_t dmaChannelOwners[8] = { 0 }; // Request owning each channel (index 1-7)
+
+static DMAStream_TypeDef* dmaStreams[8] = { 0 }; // Stream running on each channel (index 1-7)
+static DMAScatterGather_TypeDef* dmaScatterGathers[8] = { 0 }; // Scatter-gather list running on each channel (index 1-7)
+
+static void (*dmaChannelHandlers[8])(uint8_t channel, uint8_t events) = { 0 }; // Interrupt handler registered for each channel (index 1-7)
+static volatile uint32_t dmaHandledFlags = 0; // DMA1->ISR flags of channels with a registered handler
+
+#ifdef DMA_STATISTICS
+static DMAStatistics_TypeDef dmaStatistics[8]; // Counters for each channel (index 1-7)
+static uint16_t dmaStatisticsStartTick[8]; // Timebase tick when the current transfer on each channel started
+static uint32_t dmaStatisticsTransferBytes[8]; // Size in bytes of the current transfer on each channel
+static TIM_TypeDef* dmaStatisticsTimer = 0; // Free-running timer used to measure latency
+static uint32_t dmaStatisticsChannels = 0; // Channels whose completions/errors are counted without a handler (bit per channel)
+#endif
+
+static uint8_t dmaCopyChannel = 0; // DMA channel used by the copy engine (0 if not initialised)
+static uint8_t dmaCopyPriority = DMA_PRIORITY_LOW; // DMA priority of the copy channel
+static DMACopyRequest_TypeDef* dmaCopyQueueBuffer[DMA_COPY_QUEUE_LENGTH]; // Copy requests, the head request is the active one
+static volatile uint8_t dmaCopyQueueHead = 0; // Index of the active request
+static volatile uint8_t dmaCopyQueueCount = 0; // Number of requests queued or in progress
+static volatile uint32_t dmaCopyErrors = 0; // Number of requests ended by a transfer error
+
 /* FUNCTIONS */
 DMA_Channel_TypeDef* __dmaChannelAddress(uint8_t channel) {
 	// Returns the address of a DMA channel (configuration registers)
@@ -34,115 +100,680 @@ DMA_Channel_TypeDef* __dmaChannelAddress(uint8_t channel) {
 
 void init_DMA(uint8_t channel, uint32_t peripheralAddress, uint32_t memoryAddress, uint16_t dataSize, uint8_t priority, uint8_t transferDirection, uint8_t transferMode, uint8_t incrementMode, uint8_t peripheralTransferSize, uint8_t memoryTransferSize) {
 	// Initialises and configures a DMA channel
-	RCC->AHBENR |= RCC_AHBENR_DMAEN; // Enable clock for DMA controller
+	init_DMAController(); // Enable clock for DMA controller
 	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
 
+	DMADescriptor_TypeDef descriptor; // Build the whole configuration up front so CCR is written once
+	dmaBuildDescriptor(&descriptor, peripheralAddress, memoryAddress, dataSize, priority, transferDirection, transferMode, incrementMode, peripheralTransferSize, memoryTransferSize);
+	descriptor.CCR |= (DMACH->CCR & (DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE)); // Keep any interrupts already configured with dmaInterruptConfig
+
+	dmaApplyDescriptor(channel, &descriptor); // Configure and enable the DMA channel
+}
+
+void dmaChannelDisable(uint8_t channel) {
+	// Disables a DMA channel
+	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
 	DMACH->CCR &= ~DMA_CCR_EN; // Disable the DMA channel for configuration
-	DMACH->CCR &= ~DMA_CCR_MEM2MEM; // Disable memory-to-memory copy mode
+	DMA1->IFCR = (DMA_IFCR_CGIF1 << (4 * (channel - 1))); // Clear the channel's flags, so nothing left over fires once its interrupts are enabled
+}
+
+void init_DMAController() {
+	// Enables the clock for the DMA controller
+	RCC->AHBENR |= RCC_AHBENR_DMAEN;
+}
 
-	DMACH->CPAR = peripheralAddress; // Set the peripheral address
+void dmaBuildDescriptor(DMADescriptor_TypeDef* descriptor, uint32_t peripheralAddress, uint32_t memoryAddress, uint16_t dataSize, uint8_t priority, uint8_t transferDirection, uint8_t transferMode, uint8_t incrementMode, uint8_t peripheralTransferSize, uint8_t memoryTransferSize) {
+	// Precomputes a DMA channel configuration
+	descriptor->CPAR = peripheralAddress; // Peripheral address
+	descriptor->CMAR = memoryAddress; // Memory address
+	descriptor->CNDTR = (uint32_t)dataSize; // Data size
+	descriptor->CCR = DMA_CCR_IMAGE(priority, transferDirection, transferMode, incrementMode, peripheralTransferSize, memoryTransferSize); // Configuration register image
+}
+
+void dmaApplyDescriptor(uint8_t channel, const DMADescriptor_TypeDef* descriptor) {
+	// Configures and enables a DMA channel from a descriptor using plain register stores
+	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
+	DMACH->CCR = 0; // Disable the DMA channel for configuration (address/count registers are only writable while disabled)
+	DMA1->IFCR = (DMA_IFCR_CGIF1 << (4 * (channel - 1))); // Clear flags left by the previous transfer
+	DMACH->CPAR = descriptor->CPAR; // Set the peripheral address
+	DMACH->CMAR = descriptor->CMAR; // Set the memory address
+	DMACH->CNDTR = descriptor->CNDTR; // Set the data size
+#ifdef DMA_STATISTICS
+	DMACH->CCR = (descriptor->CCR | __dmaStatisticsInterrupts(channel) | DMA_CCR_EN); // Set the configuration (keeping the statistics interrupts) and enable the DMA channel
+	__dmaStatisticsStart(channel, descriptor->CNDTR, descriptor->CCR);
+#else
+	DMACH->CCR = (descriptor->CCR | DMA_CCR_EN); // Set the configuration and enable the DMA channel
+#endif
+}
+
+void dmaRearm(uint8_t channel, uint32_t memoryAddress, uint16_t dataSize) {
+	// Restarts a configured DMA channel with a new memory address and data size
+	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
+	uint32_t ccr = (DMACH->CCR & ~DMA_CCR_EN); // Read the configuration once
+	DMACH->CCR = ccr; // Disable the DMA channel
 	DMACH->CMAR = memoryAddress; // Set the memory address
 	DMACH->CNDTR = (uint32_t)dataSize; // Set the data size
-	DMACH->CCR &= ~DMA_CCR_PL; // Reset priority bits
-	DMACH->CCR |= ((priority & 0x03) << 12); // Set priority bits
+	DMACH->CCR = (ccr | DMA_CCR_EN); // Enable the DMA channel
+#ifdef DMA_STATISTICS
+	__dmaStatisticsStart(channel, dataSize, ccr);
+#endif
+}
 
-	// Transfer direction
-	if (transferDirection) {
-		DMACH->CCR |= DMA_CCR_DIR; // Memory to peripheral
+void dmaMemCopy(uint8_t channel, uint32_t fromAddress, uint32_t toAddress, uint16_t dataSize, uint8_t transferSize, uint8_t priority) {
+	// Copies a block of memory from one location to another
+	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
+
+	DMADescriptor_TypeDef descriptor; // Peripheral side is the source, memory side is the destination
+	dmaBuildDescriptor(&descriptor, fromAddress, toAddress, dataSize, priority, DMA_TRANSFERDIRECTION_P2M, DMA_TRANSFERMODE_SINGLE, (DMA_INCREMENT_MEMORY | DMA_INCREMENT_PERIPHERAL), transferSize, transferSize);
+	descriptor.CCR |= DMA_CCR_MEM2MEM; // Memory-to-memory copy mode
+	descriptor.CCR |= (DMACH->CCR & (DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE)); // Keep any interrupts already configured with dmaInterruptConfig
+
+	dmaApplyDescriptor(channel, &descriptor); // Configure and enable the DMA channel
+}
+
+void dmaMemFill(uint8_t channel, const uint32_t* pattern, uint32_t toAddress, uint16_t dataSize, uint8_t transferSize, uint8_t priority) {
+	// Fills a block of memory with a repeated value
+	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
+
+	DMADescriptor_TypeDef descriptor; // Peripheral side is the fixed pattern, memory side is the destination
+	dmaBuildDescriptor(&descriptor, (uint32_t)pattern, toAddress, dataSize, priority, DMA_TRANSFERDIRECTION_P2M, DMA_TRANSFERMODE_SINGLE, DMA_INCREMENT_MEMORY, transferSize, transferSize);
+	descriptor.CCR |= DMA_CCR_MEM2MEM; // Memory-to-memory mode
+	descriptor.CCR |= (DMACH->CCR & (DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE)); // Keep any interrupts already configured with dmaInterruptConfig
+
+	dmaApplyDescriptor(channel, &descriptor); // Configure and enable the DMA channel
+}
+
+int __dmaChannelIRQn(uint8_t channel) {
+	// Returns the NVIC interrupt number shared by a DMA channel
+	if (channel == 1) {
+		return 9; // DMA Channel 1 interrupt
 	}
-	else {
-		DMACH->CCR &= ~DMA_CCR_DIR; // Peripheral to memory
+	else if ((channel == 2) || (channel == 3)) {
+		return 10; // DMA Channel 2/3 interrupt
+	}
+	else if ((channel >= 4) && (channel <= 7)) {
+		return 11; // DMA Channel 4/5(/6/7) interrupt
+	}
+	return -1; // Invalid channel
+}
+
+void dmaInterruptConfig(uint8_t channel, uint8_t interruptSource, uint8_t priority) {
+	// Configures DMA interrupts for a channel
+	// Set the interrupt source/s in the channel configuration register
+	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
+	DMACH->CCR &= ~0x0000000E; // Disable interrupts
+	DMACH->CCR |= (0x0000000E & (interruptSource << 1)); // Enable the relevant interrupt sources
+
+	int irqn = __dmaChannelIRQn(channel); // Get the interrupt line for the channel
+	nvicSetPriority(irqn, priority);
+	nvicEnableInterrupt(irqn);
+}
+
+
+// Channel allocation
+uint8_t dmaRequestChannel(uint8_t request) {
+	// Returns the channel a DMA request is currently routed to
+	if ((request <= DMA_REQUEST_MEM2MEM) || (request >= DMA_REQUEST_COUNT)) {
+		return 0; // No fixed channel
 	}
+	const DMARequestMapping_TypeDef* mapping = &dmaRequestMap[request];
+	if (mapping->remapBit && (SYSCFG->CFGR1 & mapping->remapBit)) {
+		return mapping->remapChannel; // Request is remapped
+	}
+	return mapping->channel;
+}
 
-	// Transfer mode
-	if (transferMode) {
-		DMACH->CCR |= DMA_CCR_CIRC; // Circular mode
+uint8_t dmaChannelAllocate(uint8_t request) {
+	// Allocates the channel serving a DMA request, remapping it if the default channel is taken
+	if ((request == DMA_REQUEST_NONE) || (request >= DMA_REQUEST_COUNT)) {
+		return 0; // Invalid request
 	}
-	else {
-		DMACH->CCR &= ~DMA_CCR_CIRC; // Single transfer mode
+
+	if (request == DMA_REQUEST_MEM2MEM) {
+		// Any free channel, starting from the highest (lowest hardware priority, least peripheral requests on the F051)
+		for (uint8_t channel = DMA_CHANNEL_COUNT; channel >= 1; channel--) {
+			if (dmaChannelOwners[channel] == DMA_REQUEST_NONE) {
+				dmaChannelOwners[channel] = request;
+				return channel;
+			}
+		}
+		return 0; // No free channels
 	}
 
-	// Increment mode
-	if (incrementMode & DMA_INCREMENT_MEMORY) { // Increment memory
-		DMACH->CCR |= DMA_CCR_MINC;
+	const DMARequestMapping_TypeDef* mapping = &dmaRequestMap[request];
+	if ((dmaChannelOwners[mapping->channel] == request) || (mapping->remapChannel && (dmaChannelOwners[mapping->remapChannel] == request))) {
+		return 0; // Already owned (allocating again would remap the request away from its current user)
 	}
-	else {
-		DMACH->CCR &= ~DMA_CCR_MINC;
+	if (dmaChannelOwners[mapping->channel] == DMA_REQUEST_NONE) {
+		// Default channel is free
+		if (mapping->remapBit) {
+			init_SYSCFG(); // Enable clock for SYSCFG to access the remap bits
+			SYSCFG->CFGR1 &= ~mapping->remapBit; // Route the request to its default channel
+		}
+		dmaChannelOwners[mapping->channel] = request;
+		return mapping->channel;
+	}
+	if (mapping->remapChannel && (dmaChannelOwners[mapping->remapChannel] == DMA_REQUEST_NONE)) {
+		// Default channel is taken, but the request can be remapped to a free channel
+		init_SYSCFG(); // Enable clock for SYSCFG to access the remap bits
+		SYSCFG->CFGR1 |= mapping->remapBit; // Route the request to its alternate channel
+		dmaChannelOwners[mapping->remapChannel] = request;
+		return mapping->remapChannel;
+	}
+	return 0; // Conflict, all channels able to serve the request are taken
+}
+
+int dmaChannelClaim(uint8_t channel, uint8_t request) {
+	// Claims a specific channel for a DMA request
+	if ((channel < 1) || (channel > DMA_CHANNEL_COUNT) || (request == DMA_REQUEST_NONE) || (request >= DMA_REQUEST_COUNT)) {
+		return 0; // Invalid channel/request
+	}
+	if (dmaChannelOwners[channel] != DMA_REQUEST_NONE) {
+		return 0; // Already owned (also by the same request, two users never share a channel)
+	}
+	dmaChannelOwners[channel] = request;
+	return 1;
+}
+
+void dmaChannelFree(uint8_t channel) {
+	// Releases a channel
+	if ((channel >= 1) && (channel <= DMA_CHANNEL_COUNT)) {
+		dmaChannelOwners[channel] = DMA_REQUEST_NONE;
+	}
+}
+
+uint8_t dmaChannelOwner(uint8_t channel) {
+	// Returns the DMA request that owns a channel
+	if ((channel >= 1) && (channel <= DMA_CHANNEL_COUNT)) {
+		return dmaChannelOwners[channel];
+	}
+	return DMA_REQUEST_NONE;
+}
+
+
+uint8_t dmaChannelOwnedBy(uint8_t request) {
+	// Returns the lowest channel owned by a DMA request
+	if (request == DMA_REQUEST_NONE) {
+		return 0;
+	}
+	for (uint8_t channel = 1; channel <= DMA_CHANNEL_COUNT; channel++) {
+		if (dmaChannelOwners[channel] == request) {
+			return channel;
+		}
+	}
+	return 0; // Not owned
+}
+
+
+// Double-buffered (ping-pong) streams
+void init_DMAStream(DMAStream_TypeDef* stream, uint8_t channel, uint32_t peripheralAddress, uint32_t bufferAddress, uint16_t length, uint8_t priority, uint8_t transferDirection, uint8_t peripheralTransferSize, uint8_t memoryTransferSize, void (*callback)(DMAStream_TypeDef* stream, uint8_t half), uint8_t interruptPriority) {
+	// Starts a circular DMA stream that hands over each half of its buffer as it completes
+	if ((channel < 1) || (channel > DMA_CHANNEL_COUNT)) {
+		return; // Invalid channel
+	}
+	stream->channel = channel;
+	stream->bufferAddress = bufferAddress;
+	stream->length = length;
+	stream->halfBytes = (length / 2) << memoryTransferSize; // Half the data, scaled by the memory data size
+	stream->held = 0;
+	stream->overruns = 0;
+	stream->errors = 0;
+	stream->callback = callback;
+	dmaStreams[channel] = stream;
+	dmaSetChannelHandler(channel, __dmaStreamEvent); // Route the channel interrupts to the stream
+
+	init_DMAController(); // Enable clock for DMA controller
+	dmaChannelDisable(channel); // Stop anything running on the channel (and clear its flags, so no half is handed over before it is filled)
+	dmaInterruptConfig(channel, (DMA_INTERRUPT_HALFTRANSFER | DMA_INTERRUPT_TRANSFERCOMPLETE | DMA_INTERRUPT_ERROR), interruptPriority); // Interrupt at each half
+	init_DMA(channel, peripheralAddress, bufferAddress, length, priority, transferDirection, DMA_TRANSFERMODE_CIRCULAR, DMA_INCREMENT_MEMORY, peripheralTransferSize, memoryTransferSize); // Start the circular transfer (keeps the interrupt configuration)
+}
+
+void dmaStreamStop(DMAStream_TypeDef* stream) {
+	// Stops a DMA stream
+	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(stream->channel); // Get the channel configuration address
+	DMACH->CCR &= ~(DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE); // Disable the channel and its interrupts
+	DMA1->IFCR = (DMA_IFCR_CGIF1 << (4 * (stream->channel - 1))); // Clear any pending flags
+	if (dmaStreams[stream->channel] == stream) {
+		dmaStreams[stream->channel] = 0;
+		dmaSetChannelHandler(stream->channel, 0);
+	}
+}
+
+void dmaStreamRelease(DMAStream_TypeDef* stream, uint8_t half) {
+	// Returns a half of the stream buffer to the DMA once the consumer is done with it
+	stream->held &= ~(1 << (half & 0x1));
+}
+
+uint32_t dmaStreamHalfAddress(DMAStream_TypeDef* stream, uint8_t half) {
+	// Returns the address of a half of the stream buffer
+	return (half ? (stream->bufferAddress + stream->halfBytes) : stream->bufferAddress);
+}
+
+void __dmaStreamEvent(uint8_t channel, uint8_t events) {
+	// Channel handler for streams: hands over completed halves and handles errors
+	DMAStream_TypeDef* stream = dmaStreams[channel];
+	if (stream == 0) {
+		return; // No stream on this channel
+	}
+
+	if (events & DMA_EVENT_ERROR) {
+		// Transfer error, the hardware has already disabled the channel
+		stream->errors++;
+		dmaStreamStop(stream);
+		return;
+	}
+
+	// Half the DMA is working in now (read once), a half handed over late has already been re-entered
+	uint16_t remaining = (uint16_t)__dmaChannelAddress(channel)->CNDTR;
+	uint8_t activeHalf = ((stream->length - remaining) >= (stream->length / 2)) ? DMA_STREAM_HALF_SECOND : DMA_STREAM_HALF_FIRST;
+
+	// If HT and TC are both pending the consumer is a full buffer behind, hand over both halves in order
+	for (uint8_t half = DMA_STREAM_HALF_FIRST; half <= DMA_STREAM_HALF_SECOND; half++) {
+		if (!(events & (half ? DMA_EVENT_TRANSFERCOMPLETE : DMA_EVENT_HALFTRANSFER))) {
+			continue; // This half has not completed
+		}
+		if (stream->held & (1 << (half ^ 0x1))) {
+			stream->overruns++; // DMA has moved into the other half while the consumer still holds it
+		}
+		else if ((half == activeHalf) || ((half == DMA_STREAM_HALF_FIRST) && (events & DMA_EVENT_TRANSFERCOMPLETE))) {
+			stream->overruns++; // Handled late: the DMA has wrapped back into this half before it could be refilled/emptied
+		}
+		stream->held |= (1 << half); // Hand the half over to the consumer
+		if (stream->callback) {
+			stream->callback(stream, half);
+		}
+	}
+}
+
+
+// Scatter-gather transfer lists
+void dmaScatterGatherStart(DMAScatterGather_TypeDef* list, uint8_t channel, uint32_t peripheralAddress, const DMASegment_TypeDef* segments, uint8_t segmentCount, uint8_t priority, uint8_t transferDirection, uint8_t peripheralTransferSize, uint8_t memoryTransferSize, void (*callback)(DMAScatterGather_TypeDef* list), uint8_t interruptPriority) {
+	// Transfers a list of non-contiguous memory segments to/from one peripheral register
+	if ((channel < 1) || (channel > DMA_CHANNEL_COUNT)) {
+		return; // Invalid channel
+	}
+	list->channel = channel;
+	list->segments = segments;
+	list->segmentCount = segmentCount;
+	list->segmentIndex = 0;
+	list->callback = callback;
+
+	while ((list->segmentIndex < segmentCount) && (segments[list->segmentIndex].dataSize == 0)) {
+		list->segmentIndex++; // Skip empty segments
 	}
-	if (incrementMode & DMA_INCREMENT_PERIPHERAL) { // Increment peripheral
-		DMACH->CCR |= DMA_CCR_PINC;
+	if (list->segmentIndex >= segmentCount) {
+		// Nothing to transfer
+		list->status = DMA_LIST_COMPLETE;
+		if (callback) {
+			callback(list);
+		}
+		return;
+	}
+	list->status = DMA_LIST_ACTIVE;
+	dmaScatterGathers[channel] = list;
+	dmaSetChannelHandler(channel, __dmaScatterGatherEvent); // Route the channel interrupts to the list
+
+	init_DMAController(); // Enable clock for DMA controller
+	dmaChannelDisable(channel); // Stop anything running on the channel (and clear its flags, so the first interrupt is the end of the first segment)
+	dmaInterruptConfig(channel, (DMA_INTERRUPT_TRANSFERCOMPLETE | DMA_INTERRUPT_ERROR), interruptPriority); // Interrupt at the end of each segment
+	const DMASegment_TypeDef* segment = &segments[list->segmentIndex];
+	init_DMA(channel, peripheralAddress, segment->memoryAddress, segment->dataSize, priority, transferDirection, DMA_TRANSFERMODE_SINGLE, DMA_INCREMENT_MEMORY, peripheralTransferSize, memoryTransferSize); // Start the first segment (keeps the interrupt configuration)
+}
+
+void __dmaScatterGatherEvent(uint8_t channel, uint8_t events) {
+	// Channel handler for scatter-gather lists: starts the next segment or finishes the list
+	DMAScatterGather_TypeDef* list = dmaScatterGathers[channel];
+	if ((list == 0) || (list->status != DMA_LIST_ACTIVE)) {
+		return; // No list in progress on this channel
+	}
+
+	if (events & DMA_EVENT_ERROR) {
+		list->status = DMA_LIST_ERROR; // The hardware has already disabled the channel
+	}
+	else if (events & DMA_EVENT_TRANSFERCOMPLETE) {
+		uint8_t index = list->segmentIndex + 1;
+		while ((index < list->segmentCount) && (list->segments[index].dataSize == 0)) {
+			index++; // Skip empty segments
+		}
+		list->segmentIndex = index;
+		if (index < list->segmentCount) {
+			dmaRearm(channel, list->segments[index].memoryAddress, list->segments[index].dataSize); // Reprogram straight away for the next segment
+			return;
+		}
+		dmaChannelDisable(channel);
+		list->status = DMA_LIST_COMPLETE;
 	}
 	else {
-		DMACH->CCR &= ~DMA_CCR_PINC;
+		return; // Not an end-of-segment event
 	}
 
-	// Memory transaction size
-	DMACH->CCR &= ~DMA_CCR_MSIZE; // Reset memory transaction size bits
-	DMACH->CCR |= (memoryTransferSize << 10); // Set memory transaction size bits
+	dmaScatterGathers[channel] = 0;
+	dmaSetChannelHandler(channel, 0);
+	if (list->callback) {
+		list->callback(list);
+	}
+}
 
-	// Peripheral transaction size
-	DMACH->CCR &= ~DMA_CCR_PSIZE; // Reset peripheral transaction size bits
-	DMACH->CCR |= (peripheralTransferSize << 8); // Set peripheral transaction size bits
 
-	DMACH->CCR |= DMA_CCR_EN; // Enable the DMA channel
+// Asynchronous memory copy engine
+void init_DMACopyEngine(uint8_t channel, uint8_t priority, uint8_t interruptPriority) {
+	// Dedicates a DMA channel to queued memory copies
+	if (((channel != dmaCopyChannel) || (dmaChannelOwner(channel) != DMA_REQUEST_MEM2MEM)) && !dmaChannelClaim(channel, DMA_REQUEST_MEM2MEM)) {
+		return; // Channel is in use by something else (re-initialising the copy engine on its own channel is allowed)
+	}
+	init_DMAController(); // Enable clock for DMA controller
+	dmaChannelDisable(channel); // Stop anything running on the channel
+	dmaCopyChannel = channel;
+	dmaCopyPriority = priority;
+	dmaCopyQueueHead = 0;
+	dmaCopyQueueCount = 0;
+	dmaCopyErrors = 0;
+	dmaSetChannelHandler(channel, __dmaCopyEvent); // Route the channel interrupts to the copy engine
+	dmaInterruptConfig(channel, (DMA_INTERRUPT_TRANSFERCOMPLETE | DMA_INTERRUPT_ERROR), interruptPriority); // Enable the completion/error interrupts
 }
 
-void dmaChannelDisable(uint8_t channel) {
-	// Disables a DMA channel
-	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
-	DMACH->CCR &= ~DMA_CCR_EN; // Disable the DMA channel for configuration
+int dmaCopyQueue(DMACopyRequest_TypeDef* request, uint32_t fromAddress, uint32_t toAddress, uint16_t dataSize, uint8_t transferSize, void (*callback)(DMACopyRequest_TypeDef* request)) {
+	// Queues a memory copy, returns 1 if queued and 0 if the queue is full
+	if (!__dmaCopyAvailable(request)) {
+		return 0; // Still queued or in progress, its transfer must not be changed
+	}
+	request->fromAddress = fromAddress;
+	request->toAddress = toAddress;
+	request->dataSize = dataSize;
+	request->transferSize = transferSize;
+	request->fill = 0; // Source address increments
+	request->callback = callback;
+	return __dmaCopyEnqueue(request);
 }
 
-void dmaMemCopy(uint8_t channel, uint32_t fromAddress, uint32_t toAddress, uint16_t dataSize, uint8_t transferSize, uint8_t priority) {
-	// Copies a block of memory from one location to another
-	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
-	DMACH->CCR &= ~DMA_CCR_EN; // Disable the DMA channel for configuration
+int dmaFillQueue(DMACopyRequest_TypeDef* request, uint32_t toAddress, uint32_t pattern, uint16_t dataSize, uint8_t transferSize, void (*callback)(DMACopyRequest_TypeDef* request)) {
+	// Queues a memory fill, returns 1 if queued and 0 if the queue is full
+	if (!__dmaCopyAvailable(request)) {
+		return 0; // Still queued or in progress, its transfer (and pattern) must not be changed
+	}
+	request->pattern = pattern; // Kept in the request so it stays valid for the whole transfer
+	request->fromAddress = (uint32_t)(&request->pattern);
+	request->toAddress = toAddress;
+	request->dataSize = dataSize;
+	request->transferSize = transferSize;
+	request->fill = 1; // Source address stays on the pattern
+	request->callback = callback;
+	return __dmaCopyEnqueue(request);
+}
 
-	DMACH->CPAR = fromAddress; // Set the peripheral address
-	DMACH->CMAR = toAddress; // Set the memory address
-	DMACH->CNDTR = (uint32_t)dataSize; // Set the data size
-	DMACH->CCR &= ~DMA_CCR_PL; // Reset priority bits
-	DMACH->CCR |= ((priority & 0x03) << 12); // Set priority bits
+int __dmaCopyEnqueue(DMACopyRequest_TypeDef* request) {
+	// Adds a prepared request to the copy queue, starting it if the channel is idle
+	if (dmaCopyChannel == 0) {
+		return 0; // Copy engine not initialised
+	}
 
-	DMACH->CCR &= ~DMA_CCR_DIR; // Set direction from peripheral to memory
-	DMACH->CCR &= ~DMA_CCR_CIRC; // Single transfer mode
-	DMACH->CCR |= DMA_CCR_MINC; // Increment memory address
-	DMACH->CCR |= DMA_CCR_PINC; // Increment peripheral address
+	int irqn = __dmaChannelIRQn(dmaCopyChannel);
+	nvicDisableInterrupt(irqn); // Keep the interrupt handler out of the queue while it is modified
+	if ((dmaCopyQueueCount >= DMA_COPY_QUEUE_LENGTH) || __dmaCopyQueued(request)) {
+		// Queue full, or the request is already queued/in progress (queuing it twice would corrupt the queue)
+		nvicEnableInterrupt(irqn);
+		return 0;
+	}
+	if (request->dataSize == 0) {
+		// Nothing to copy (the DMA will not start with a zero count), complete immediately
+		nvicEnableInterrupt(irqn);
+		request->status = DMA_COPY_COMPLETE;
+		if (request->callback) {
+			request->callback(request);
+		}
+		return 1;
+	}
+	request->status = DMA_COPY_PENDING; // Only once accepted, a rejected request keeps its previous status
+	dmaCopyQueueBuffer[(dmaCopyQueueHead + dmaCopyQueueCount) % DMA_COPY_QUEUE_LENGTH] = request; // Add to the back of the queue
+	dmaCopyQueueCount++;
+	if (dmaCopyQueueCount == 1) {
+		// Channel was idle, start straight away
+		__dmaCopyStart(request);
+	}
+	nvicEnableInterrupt(irqn);
+	return 1;
+}
 
+int __dmaCopyQueued(DMACopyRequest_TypeDef* request) {
+	// Returns whether a request is waiting in the copy queue or in progress (call with the copy interrupt disabled)
+	for (uint8_t i = 0; i < dmaCopyQueueCount; i++) {
+		if (dmaCopyQueueBuffer[(dmaCopyQueueHead + i) % DMA_COPY_QUEUE_LENGTH] == request) {
+			return 1;
+		}
+	}
+	return 0;
+}
 
-	// Memory transaction size
-	DMACH->CCR &= ~DMA_CCR_MSIZE; // Reset memory transaction size bits
-	DMACH->CCR |= (transferSize << 10); // Set memory transaction size bits
+int __dmaCopyAvailable(DMACopyRequest_TypeDef* request) {
+	// Returns whether a request can be (re)filled and queued: the engine is initialised and the request is not queued or in progress
+	if (dmaCopyChannel == 0) {
+		return 0; // Copy engine not initialised
+	}
+	int irqn = __dmaChannelIRQn(dmaCopyChannel);
+	nvicDisableInterrupt(irqn); // The queue is scanned while the handler could be removing the active request
+	int queued = __dmaCopyQueued(request);
+	nvicEnableInterrupt(irqn);
+	return !queued;
+}
 
-	// Peripheral transaction size
-	DMACH->CCR &= ~DMA_CCR_PSIZE; // Reset peripheral transaction size bits
-	DMACH->CCR |= (transferSize << 8); // Set peripheral transaction size bits
+uint8_t dmaCopyStatus(DMACopyRequest_TypeDef* request) {
+	// Returns the status of a copy request
+	return request->status;
+}
 
-	DMACH->CCR |= DMA_CCR_MEM2MEM; // Enable memory-to-memory copy mode
+int dmaCopyPending() {
+	// Returns the number of copy requests queued or in progress
+	return dmaCopyQueueCount;
+}
 
-	DMACH->CCR |= DMA_CCR_EN; // Enable the DMA channel
+uint32_t dmaCopyErrorCount() {
+	// Returns the number of copy requests that ended in a transfer error
+	return dmaCopyErrors;
 }
 
-void dmaInterruptConfig(uint8_t channel, uint8_t interruptSource, uint8_t priority) {
-	// Configures DMA interrupts for a channel
-	// Set the interrupt source/s in the channel configuration register
-	DMA_Channel_TypeDef* DMACH = __dmaChannelAddress(channel); // Get the channel configuration address
-	DMACH->CCR &= ~0x0000000E; // Disable interrupts
-	DMACH->CCR |= (0x0000000E & (interruptSource << 1)); // Enable the relevant interrupt sources
+void __dmaCopyStart(DMACopyRequest_TypeDef* request) {
+	// Programs the copy channel with a request
+	DMADescriptor_TypeDef descriptor; // Peripheral side is the source, memory side is the destination
+	uint8_t incrementMode = (request->fill ? DMA_INCREMENT_MEMORY : (DMA_INCREMENT_MEMORY | DMA_INCREMENT_PERIPHERAL)); // Fills read the same source word every time
+	dmaBuildDescriptor(&descriptor, request->fromAddress, request->toAddress, request->dataSize, dmaCopyPriority, DMA_TRANSFERDIRECTION_P2M, DMA_TRANSFERMODE_SINGLE, incrementMode, request->transferSize, request->transferSize);
+	descriptor.CCR |= (DMA_CCR_MEM2MEM | DMA_CCR_TCIE | DMA_CCR_TEIE); // Memory-to-memory copy, interrupt on completion/error
+	request->status = DMA_COPY_ACTIVE;
+	dmaApplyDescriptor(dmaCopyChannel, &descriptor);
+}
 
-	if (channel == 1) {
-		// DMA Channel 1 interrupt
-		nvicSetPriority(9, priority);
-		nvicEnableInterrupt(9);
+void __dmaCopyEvent(uint8_t channel, uint8_t events) {
+	// Channel handler for the copy engine: completes the active request and starts the next queued one
+	if ((channel != dmaCopyChannel) || (dmaCopyQueueCount == 0) || !(events & (DMA_EVENT_TRANSFERCOMPLETE | DMA_EVENT_ERROR))) {
+		return; // Nothing in progress
 	}
-	else if ((channel == 2) || (channel == 3)) {
-		// DMA Channel 2/3 interrupt
-		nvicSetPriority(10, priority);
-		nvicEnableInterrupt(10);
+	__dmaChannelAddress(channel)->CCR = 0; // Disable the channel
+
+	DMACopyRequest_TypeDef* request = dmaCopyQueueBuffer[dmaCopyQueueHead]; // The request that just finished
+	dmaCopyQueueHead = (dmaCopyQueueHead + 1) % DMA_COPY_QUEUE_LENGTH;
+	dmaCopyQueueCount--;
+	if (dmaCopyQueueCount) {
+		// Chain the next request before running the callback to keep the channel busy
+		__dmaCopyStart(dmaCopyQueueBuffer[dmaCopyQueueHead]);
+	}
+
+	if (events & DMA_EVENT_ERROR) {
+		request->status = DMA_COPY_ERROR;
+		dmaCopyErrors++;
 	}
-	else if ((channel == 4) || (channel == 5)) {
-		// DMA Channel 4/5 interrupt
-		nvicSetPriority(11, priority);
-		nvicEnableInterrupt(11);
+	else {
+		request->status = DMA_COPY_COMPLETE;
+	}
+	if (request->callback) {
+		request->callback(request);
+	}
+}
+
+
+// Interrupt dispatch
+void dmaSetChannelHandler(uint8_t channel, void (*handler)(uint8_t channel, uint8_t events)) {
+	// Registers the function called from the DMA interrupt for a channel
+	if ((channel < 1) || (channel > DMA_CHANNEL_COUNT)) {
+		return; // Invalid channel
 	}
+	// Order matters: the interrupt only calls a handler once its flags are in the mask, so the handler is set before and cleared after the mask
+	if (handler) {
+		dmaChannelHandlers[channel] = handler;
+		dmaHandledFlags |= (0xF << (4 * (channel - 1))); // Acknowledge this channel's flags in the interrupt
+	}
+	else {
+		dmaHandledFlags &= ~(0xF << (4 * (channel - 1))); // Leave this channel's flags for polling
+		dmaChannelHandlers[channel] = 0;
+	}
+}
+
+uint32_t __dmaUnhandledFlags(uint32_t flags) {
+	// Returns the flags of channels without a handler that are raising an interrupt
+	uint32_t raised = 0;
+	for (uint8_t channel = 1; channel <= DMA_CHANNEL_COUNT; channel++) {
+		uint32_t channelFlags = (flags >> (4 * (channel - 1))) & 0xF;
+		if (channelFlags & (__dmaChannelAddress(channel)->CCR & (DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE))) {
+			raised |= (channelFlags << (4 * (channel - 1))); // Interrupt source enabled (CCR bits line up with the channel's ISR bits), acknowledge it
+		}
+	}
+	return raised;
+}
+
+void __dmaDispatch(uint32_t lineFlags) {
+	// Acknowledges and dispatches the DMA events of one interrupt line
+	uint32_t pending = (DMA1->ISR & lineFlags); // Read the status once
+	uint32_t flags = (pending & dmaHandledFlags);
+	if (pending & ~dmaHandledFlags) {
+		flags |= __dmaUnhandledFlags(pending & ~dmaHandledFlags); // Channels with interrupts enabled but no handler would keep the line pending forever
+	}
+	if (!flags) {
+		return;
+	}
+	DMA1->IFCR = flags; // Acknowledge everything that will be dispatched in a single write
+
+	for (uint8_t channel = 1; flags; channel++, flags >>= 4) {
+		uint8_t events = (flags & (DMA_EVENT_TRANSFERCOMPLETE | DMA_EVENT_HALFTRANSFER | DMA_EVENT_ERROR)); // This channel's events
+		if (!events) {
+			continue;
+		}
+#ifdef DMA_STATISTICS
+		__dmaStatisticsEvent(channel, events); // Handler or not, before the handler, which may start the next transfer
+#endif
+		if (dmaChannelHandlers[channel]) {
+			dmaChannelHandlers[channel](channel, events);
+		}
+	}
+}
+
+#ifdef DMA_STATISTICS
+// Transfer statistics
+void dmaStatisticsTimebase(TIM_TypeDef* timer) {
+	// Sets the free-running timer used to measure transfer latency
+	dmaStatisticsTimer = timer;
+}
+
+void dmaStatisticsEnable(uint8_t channel, uint8_t interruptPriority) {
+	// Counts the completions/errors of a channel from the DMA interrupt, whether or not it has a handler
+	if ((channel < 1) || (channel > DMA_CHANNEL_COUNT)) {
+		return; // Invalid channel
+	}
+	dmaStatisticsChannels |= (1 << channel);
+	__dmaChannelAddress(channel)->CCR |= (DMA_CCR_TCIE | DMA_CCR_TEIE); // Interrupt on completion/error (kept when the channel is reconfigured)
+	int irqn = __dmaChannelIRQn(channel);
+	nvicSetPriority(irqn, interruptPriority);
+	nvicEnableInterrupt(irqn);
+}
+
+void dmaStatisticsDisable(uint8_t channel) {
+	// Stops counting the completions/errors of a channel without a handler
+	if ((channel < 1) || (channel > DMA_CHANNEL_COUNT)) {
+		return; // Invalid channel
+	}
+	dmaStatisticsChannels &= ~(1 << channel);
+	if (!dmaChannelHandlers[channel]) {
+		__dmaChannelAddress(channel)->CCR &= ~(DMA_CCR_TCIE | DMA_CCR_TEIE); // Leave the flags for polling again
+	}
+}
+
+uint32_t __dmaStatisticsInterrupts(uint8_t channel) {
+	// Returns the interrupt enables a channel needs for its statistics
+	return ((dmaStatisticsChannels & (1 << channel)) ? (DMA_CCR_TCIE | DMA_CCR_TEIE) : 0);
+}
+
+void dmaStatisticsReset(uint8_t channel) {
+	// Clears the counters of a channel
+	if ((channel >= 1) && (channel <= DMA_CHANNEL_COUNT)) {
+		dmaStatistics[channel] = (DMAStatistics_TypeDef){ 0 };
+	}
+}
+
+void dmaStatisticsGet(uint8_t channel, DMAStatistics_TypeDef* statistics) {
+	// Copies the counters of a channel
+	if ((channel >= 1) && (channel <= DMA_CHANNEL_COUNT)) {
+		*statistics = dmaStatistics[channel];
+	}
+}
+
+uint8_t dmaStatisticsUtilisation(uint8_t channel, uint32_t windowTicks) {
+	// Returns the percentage of a measurement window the channel spent with a transfer in progress (start to complete, not bus occupancy)
+	if ((channel < 1) || (channel > DMA_CHANNEL_COUNT) || (windowTicks == 0)) {
+		return 0;
+	}
+	uint32_t busyTicks = dmaStatistics[channel].busyTicks;
+	if (busyTicks >= windowTicks) {
+		return 100;
+	}
+	if (busyTicks < (0xFFFFFFFF / 100)) {
+		return (uint8_t)((busyTicks * 100) / windowTicks);
+	}
+	return (uint8_t)(busyTicks / (windowTicks / 100)); // Avoid overflowing the multiply (and a 64 bit divide on the M0)
+}
+
+void __dmaStatisticsStart(uint8_t channel, uint32_t dataSize, uint32_t ccr) {
+	// Records the start of a transfer
+	dmaStatistics[channel].transfersStarted++;
+	dmaStatisticsTransferBytes[channel] = (dataSize << ((ccr & DMA_CCR_MSIZE) >> 10)); // Data count scaled by the memory data size
+	if (dmaStatisticsTimer) {
+		dmaStatisticsStartTick[channel] = (uint16_t)dmaStatisticsTimer->CNT;
+	}
+}
+
+void __dmaStatisticsEvent(uint8_t channel, uint8_t events) {
+	// Records the completion/error of a transfer
+	DMAStatistics_TypeDef* statistics = &dmaStatistics[channel];
+	if (events & DMA_EVENT_ERROR) {
+		statistics->errors++;
+		return;
+	}
+	if (!(events & DMA_EVENT_TRANSFERCOMPLETE)) {
+		return; // Half transfers are not counted
+	}
+	statistics->transfersCompleted++;
+	statistics->bytesMoved += dmaStatisticsTransferBytes[channel];
+	if (dmaStatisticsTimer) {
+		uint16_t now = (uint16_t)dmaStatisticsTimer->CNT;
+		uint16_t latency = (uint16_t)(now - dmaStatisticsStartTick[channel]); // Wraps correctly for 16 bit counters
+		statistics->lastLatency = latency;
+		if (latency > statistics->maxLatency) {
+			statistics->maxLatency = latency;
+		}
+		statistics->busyTicks += latency;
+		dmaStatisticsStartTick[channel] = now; // A circular channel has already started its next pass
+	}
+}
+#endif
+
+// Interrupt handlers
+void DMA1_Channel1_IRQHandler() {
+	// Interrupt handler for DMA channel 1
+	__dmaDispatch(0x0000000F);
+}
+
+void DMA1_Channel2_3_IRQHandler() {
+	// Interrupt handler for DMA channels 2-3
+	__dmaDispatch(0x00000FF0);
+}
+
+void DMA1_Channel4_5_IRQHandler() {
+	// Interrupt handler for DMA channels 4-5 (4-7 on larger STM32F0 parts)
+	__dmaDispatch(0x0FFFF000);
 }
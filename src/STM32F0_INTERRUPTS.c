@@ -45,7 +45,7 @@ void nvicEnableInterrupt(int irqn) {
 void nvicDisableInterrupt(int irqn) {
 	// Disable an interrupt in the NVIC
 	if (irqn >= 0) { // // Handle only the maskable interrupts
-		NVIC->ICER[0] |= (1 << irqn); // Set the corresponding bit in the NVIC Interrupt Clear Enable Register
+		NVIC->ICER[0] = (1 << irqn); // Set the corresponding bit in the NVIC Interrupt Clear Enable Register (write-1-to-clear, reading it back would disable every enabled interrupt)
 	}
 }
 
@@ -213,6 +213,57 @@ void timerInterruptEnable(TIM_TypeDef* timer, uint8_t priority) {
 }
 
 
+// Rate functions
+uint32_t timerCalculateRate(uint32_t frequency, uint16_t* prescaler, uint16_t* ticks) {
+	// Calculates the prescaler and auto-reload (ticks) values closest to an update rate
+	if (frequency == 0) {
+		return 0; // Invalid rate
+	}
+	uint32_t divider = (TIMER_CLOCK_FREQUENCY + (frequency / 2)) / frequency; // Total clock division needed (rounded)
+	if (divider < 2) {
+		return 0; // Faster than the timer can update (an auto-reload value of 0 never produces an update)
+	}
+	uint32_t prescalerDivider = (divider + 0xFFFF) / 0x10000; // Smallest prescaler that keeps the auto-reload value within 16 bits
+	if (prescalerDivider > 0x10000) {
+		prescalerDivider = 0x10000; // Slower than the timer can go, use the slowest setting
+	}
+	uint32_t reloadDivider = (divider + (prescalerDivider / 2)) / prescalerDivider; // Rounded auto-reload division
+	if (reloadDivider > 0x10000) {
+		reloadDivider = 0x10000;
+	}
+	else if (reloadDivider < 2) {
+		reloadDivider = 2; // Auto-reload value of at least 1
+	}
+	*prescaler = (uint16_t)(prescalerDivider - 1);
+	*ticks = (uint16_t)(reloadDivider - 1);
+
+	uint32_t achievedDivider = prescalerDivider * reloadDivider;
+	uint64_t achievedRate = (((uint64_t)TIMER_CLOCK_FREQUENCY * 1000) + (achievedDivider / 2)) / achievedDivider; // Rate in millihertz (configuration time only, so the 64 bit divide is acceptable)
+	if (achievedRate > 0xFFFFFFFF) {
+		return 0xFFFFFFFF; // Too fast to express in millihertz
+	}
+	return (uint32_t)achievedRate;
+}
+
+uint32_t startRateTimer(TIM_TypeDef* timer, uint32_t frequency) {
+	// Initialises and starts a timer to repeatedly update at (close to) a rate in Hz
+	uint16_t prescaler;
+	uint16_t ticks;
+	uint32_t achievedRate = timerCalculateRate(frequency, &prescaler, &ticks);
+	if (achievedRate == 0) {
+		return 0; // Rate can not be reached, do not start the timer
+	}
+	init_timer(timer, prescaler); // Initialise the timer with the calculated prescaler
+	startRepeatingTimer(timer, ticks); // Update every (ticks + 1) prescaled clocks
+	return achievedRate;
+}
+
+void timerTriggerOutput(TIM_TypeDef* timer, uint8_t source) {
+	// Selects the event a timer drives on its trigger output (TRGO)
+	timer->CR2 = ((timer->CR2 & ~TIM_CR2_MMS) | ((source << 4) & TIM_CR2_MMS)); // Set the master mode selection bits
+}
+
+
 // PWM functions
 void pwmEnable(TIM_TypeDef* timer, uint8_t channel) {
 	// Enables output capture/compare (PWM) on a timer channel
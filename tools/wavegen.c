@@ -0,0 +1,640 @@
+/*
+STM32F0 Utilities
+A Collection of utilities for STM32F0 microcontrollers, primarily targeted at the STM32F051C6-based UCT development board
+
+Author: Jonah Swain (SWNJON003)
+Date created: 26/05/2018
+Date modified: 26/05/2018
+
+Tool: wavegen
+Host-side waveform table tool (not part of the firmware library)
+
+Build: cc -O2 -o wavegen tools/wavegen.c -lm
+
+Usage:
+	wavegen gen -w sine|square|saw|triangle|csv|wav [-i input] [-l length] [-b 8|12] [-a right|left] [-d duty] [-f frequency] [-c clock] [-p auto|quarter|delta] -n NAME > output.h
+		Generates a waveform header already in the DAC_MODE_* format, so it can be DMA'd straight into DHR8R/DHR12R/DHR12L
+		csv reads comma/whitespace separated values, wav reads the first channel of an 8/16 bit PCM file, both are scaled to full range
+		and resampled (linear, periodic) to -l samples if given
+		-f emits the sample rate, the best TIM prescaler/ARR pair (for init_timer/startRepeatingTimer) and the dacDMAWaveGen period for that output frequency
+		-p emits a packed table instead (see pack)
+
+	wavegen pack [-f auto|quarter|delta] [-e maxError] -n NAME input > output.h
+		Packs a sample table (a C array such as waveforms/WAVE_SINE256.h, or comma/whitespace separated values) into a
+		DACPackedWave_TypeDef table for dacPackedWaveDecode/dacPackedWaveStart (see STM32F0_DAC.h for the formats)
+		auto uses quarter wave symmetry when it is within maxError (default 0, lossless) and the delta/run length format otherwise
+
+*/
+
+/* INCLUDES */
+
+#ifndef STDINT_H
+#include <stdint.h>
+#define STDINT_H
+#endif
+
+#ifndef STDIO_H
+#include <stdio.h>
+#define STDIO_H
+#endif
+
+#ifndef STDLIB_H
+#include <stdlib.h>
+#define STDLIB_H
+#endif
+
+#ifndef STRING_H
+#include <string.h>
+#define STRING_H
+#endif
+
+#ifndef MATH_H
+#include <math.h>
+#define MATH_H
+#endif
+
+/* CONSTANT DEFINITIONS */
+#define MAX_SAMPLES 65535
+
+// Packed formats and tokens (must match STM32F0_DAC.h)
+#define PACKED_AUTO 0x0
+#define PACKED_QUARTERWAVE 0x1
+#define PACKED_DELTA 0x2
+#define PACKED_TOKEN_RUN 0x80
+#define PACKED_TOKEN_ABSOLUTE 0xC0
+#define PACKED_RUN_MAX 64 // Samples per run token
+#define PACKED_DELTA_MIN -64
+#define PACKED_DELTA_MAX 63
+
+// Sample formats (must match DAC_MODE_* in STM32F0_DAC.h)
+#define MODE_RESOLUTION 0x1
+#define MODE_DATAALIGNMENT 0x2
+
+#define TIMER_CLOCK_FREQUENCY 48000000 // Default timer clock (-c to change)
+#define DEFAULT_LENGTH 256
+#define PI 3.14159265358979323846
+
+/* GLOBAL VARIABLES */
+static uint16_t samples[MAX_SAMPLES];
+static uint8_t tokens[3 * MAX_SAMPLES]; // Worst case every sample is absolute
+static double shape[MAX_SAMPLES]; // Generated/imported waveform, 0.0 to 1.0 of full scale
+
+/* FUNCTIONS */
+static void usage() {
+	// Prints the command line usage and exits
+	fprintf(stderr, "usage: wavegen pack [-f auto|quarter|delta] [-e maxError] -n NAME input > output.h\n");
+	fprintf(stderr, "       wavegen gen -w sine|square|saw|triangle|csv|wav [-i input] [-l length] [-b 8|12] [-a right|left] [-d duty] [-f frequency] [-c clock] [-p auto|quarter|delta] -n NAME > output.h\n");
+	exit(1);
+}
+
+static uint32_t readSamples(const char* path, uint16_t* values) {
+	// Reads a sample table from a C array (between the first braces) or a list of separated values, returns the number of samples
+	FILE* file = fopen(path, "r");
+	if (file == 0) {
+		perror(path);
+		exit(1);
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char* text = malloc(size + 1);
+	size = (long)fread(text, 1, size, file);
+	text[size] = 0;
+	fclose(file);
+
+	char* start = strchr(text, '{');
+	char* end = 0;
+	if (start) {
+		start++; // C array: only the initialiser holds samples
+		end = strchr(start, '}');
+	}
+	else {
+		start = text; // Plain list of values
+	}
+	if (end) {
+		*end = 0;
+	}
+
+	uint32_t count = 0;
+	char* position = start;
+	while (*position) {
+		if ((*position >= '0') && (*position <= '9')) {
+			char* next;
+			unsigned long value = strtoul(position, &next, 0); // Decimal or 0x hexadecimal
+			if (count == MAX_SAMPLES) {
+				fprintf(stderr, "%s: more than %d samples\n", path, MAX_SAMPLES);
+				exit(1);
+			}
+			if (value > 0xFFFF) {
+				fprintf(stderr, "%s: sample %u does not fit in 16 bits\n", path, count);
+				exit(1);
+			}
+			values[count++] = (uint16_t)value;
+			position = next;
+		}
+		else {
+			position++;
+		}
+	}
+	free(text);
+	return count;
+}
+
+static uint32_t quarterWaveError(const uint16_t* values, uint32_t length, uint16_t reflect) {
+	// Returns the largest error of reconstructing a table from its first quarter and a reflect value
+	uint32_t quarterLength = length / 4;
+	uint32_t halfLength = 2 * quarterLength;
+	uint32_t maxError = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		uint32_t j = (i < halfLength) ? i : (i - halfLength);
+		uint16_t value = values[(j <= quarterLength) ? j : (halfLength - j)];
+		if (i >= halfLength) {
+			value = (uint16_t)(reflect - value);
+		}
+		uint32_t error = (value > values[i]) ? (value - values[i]) : (values[i] - value);
+		if (error > maxError) {
+			maxError = error;
+		}
+	}
+	return maxError;
+}
+
+static uint32_t quarterWaveFit(const uint16_t* values, uint32_t length, uint16_t* reflect) {
+	// Finds the reflect value with the smallest quarter wave error, returns the error (0xFFFFFFFF if the length does not split into quarters)
+	if ((length < 4) || (length % 4)) {
+		return 0xFFFFFFFF;
+	}
+	uint32_t bestError = 0xFFFFFFFF;
+	uint32_t centre = (uint32_t)values[0] + values[length / 2]; // The half period starts mirror each other
+	for (int32_t offset = -2; offset <= 2; offset++) {
+		uint16_t candidate = (uint16_t)(centre + offset);
+		uint32_t error = quarterWaveError(values, length, candidate);
+		if (error < bestError) {
+			bestError = error;
+			*reflect = candidate;
+		}
+	}
+	return bestError;
+}
+
+static uint32_t deltaEncode(const uint16_t* values, uint32_t length, uint8_t* output) {
+	// Encodes a table as delta/run length tokens, returns the number of bytes
+	uint32_t size = 0;
+	uint16_t current = 0;
+	uint32_t i = 0;
+	while (i < length) {
+		if ((i > 0) && (values[i] == current)) {
+			// Run of the previous sample
+			uint32_t run = 0;
+			while ((i + run < length) && (values[i + run] == current) && (run < PACKED_RUN_MAX)) {
+				run++;
+			}
+			output[size++] = (uint8_t)(PACKED_TOKEN_RUN | (run - 1));
+			i += run;
+			continue;
+		}
+		int32_t delta = (int32_t)values[i] - (int32_t)current;
+		if ((i > 0) && (delta >= PACKED_DELTA_MIN) && (delta <= PACKED_DELTA_MAX)) {
+			output[size++] = (uint8_t)(delta & 0x7F);
+		}
+		else {
+			output[size++] = PACKED_TOKEN_ABSOLUTE; // First sample, or too far to step
+			output[size++] = (uint8_t)(values[i] & 0xFF);
+			output[size++] = (uint8_t)(values[i] >> 8);
+		}
+		current = values[i];
+		i++;
+	}
+	return size;
+}
+
+static int deltaCheck(const uint16_t* values, uint32_t length, const uint8_t* input) {
+	// Decodes a token stream the same way as dacPackedWaveDecode, returns whether it matches the table
+	uint16_t current = 0;
+	uint8_t repeat = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		if (repeat) {
+			repeat--;
+		}
+		else {
+			uint8_t token = *input++;
+			if (!(token & PACKED_TOKEN_RUN)) {
+				current += (uint16_t)((int8_t)(token << 1) >> 1);
+			}
+			else if ((token & PACKED_TOKEN_ABSOLUTE) == PACKED_TOKEN_RUN) {
+				repeat = (token & 0x3F);
+			}
+			else {
+				current = (uint16_t)(input[0] | (input[1] << 8));
+				input += 2;
+			}
+		}
+		if (current != values[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void writePreamble() {
+	// Writes the include guard and stdint include of a waveform header
+	printf("#ifndef STDINT_H\n#include <stdint.h>\n#define STDINT_H\n#endif\n\n");
+}
+
+static void writeHeader(const char* name, const char* source, uint8_t format, const uint16_t* values, uint32_t length, uint16_t reflect, uint32_t error, const uint8_t* data, uint32_t dataSize, const char* defines) {
+	// Writes a packed waveform header in the style of the waveforms directory
+	printf("#pragma once\n");
+	if (format == PACKED_QUARTERWAVE) {
+		printf("// %s packed as a quarter wave (%u of %u samples, max error %u LSB)\n", name, (length / 4) + 1, length, error);
+	}
+	else {
+		printf("// %s packed as delta/run length tokens (%u bytes for %u samples)\n", name, dataSize, length);
+	}
+	printf("// Generated by tools/wavegen.c from %s\n\n", source);
+	writePreamble();
+	printf("#define %s_PACKED_LENGTH %u\n", name, length);
+	printf("%s\n", defines);
+
+	if (format == PACKED_QUARTERWAVE) {
+		printf("const uint16_t %s_PACKED_DATA[] = {", name);
+		for (uint32_t i = 0; i <= length / 4; i++) {
+			printf("%s%s0x%03x", (i ? "," : ""), ((i % 16) ? " " : "\n\t"), values[i]);
+		}
+		printf(" };\n\n");
+		printf("#define %s_PACKED { DAC_PACKED_QUARTERWAVE, %u, 0x%03x, %s_PACKED_DATA } // DACPackedWave_TypeDef initialiser\n", name, length, reflect, name);
+	}
+	else {
+		printf("const uint8_t %s_PACKED_DATA[] = {", name);
+		for (uint32_t i = 0; i < dataSize; i++) {
+			printf("%s%s0x%02x", (i ? "," : ""), ((i % 16) ? " " : "\n\t"), data[i]);
+		}
+		printf(" };\n\n");
+		printf("#define %s_PACKED { DAC_PACKED_DELTA, %u, 0, %s_PACKED_DATA } // DACPackedWave_TypeDef initialiser\n", name, length, name);
+	}
+}
+
+static uint32_t packTable(const char* name, const char* source, uint8_t format, uint32_t maxError, const uint16_t* values, uint32_t length, const char* defines) {
+	// Packs a sample table and writes it as a header, returns 0 on success
+	uint16_t reflect = 0;
+	uint32_t error = quarterWaveFit(values, length, &reflect);
+	if (format == PACKED_AUTO) {
+		format = (error <= maxError) ? PACKED_QUARTERWAVE : PACKED_DELTA;
+	}
+	if (format == PACKED_QUARTERWAVE) {
+		if (error == 0xFFFFFFFF) {
+			fprintf(stderr, "%s: %u samples do not split into quarters\n", source, length);
+			return 1;
+		}
+		if (error > maxError) {
+			fprintf(stderr, "warning: quarter wave error is %u LSB\n", error);
+		}
+		writeHeader(name, source, format, values, length, reflect, error, 0, 0, defines);
+		fprintf(stderr, "%s: %u bytes -> %u bytes (quarter wave, max error %u LSB)\n", name, 2 * length, 2 * ((length / 4) + 1), error);
+	}
+	else {
+		uint32_t size = deltaEncode(values, length, tokens);
+		if (!deltaCheck(values, length, tokens)) {
+			fprintf(stderr, "%s: delta encoding does not decode to the table\n", source);
+			return 1;
+		}
+		writeHeader(name, source, format, values, length, 0, 0, tokens, size, defines);
+		fprintf(stderr, "%s: %u bytes -> %u bytes (delta/run length, lossless)\n", name, 2 * length, size);
+	}
+	return 0;
+}
+
+static int pack(int argc, char** argv) {
+	// Packs a sample table into a packed waveform header
+	uint8_t format = PACKED_AUTO;
+	uint32_t maxError = 0;
+	const char* name = 0;
+	const char* input = 0;
+
+	for (int i = 0; i < argc; i++) {
+		if (!strcmp(argv[i], "-f") && (i + 1 < argc)) {
+			i++;
+			if (!strcmp(argv[i], "auto")) {
+				format = PACKED_AUTO;
+			}
+			else if (!strcmp(argv[i], "quarter")) {
+				format = PACKED_QUARTERWAVE;
+			}
+			else if (!strcmp(argv[i], "delta")) {
+				format = PACKED_DELTA;
+			}
+			else {
+				usage();
+			}
+		}
+		else if (!strcmp(argv[i], "-e") && (i + 1 < argc)) {
+			maxError = (uint32_t)strtoul(argv[++i], 0, 0);
+		}
+		else if (!strcmp(argv[i], "-n") && (i + 1 < argc)) {
+			name = argv[++i];
+		}
+		else if (input == 0) {
+			input = argv[i];
+		}
+		else {
+			usage();
+		}
+	}
+	if ((name == 0) || (input == 0)) {
+		usage();
+	}
+
+	uint32_t length = readSamples(input, samples);
+	if (length == 0) {
+		fprintf(stderr, "%s: no samples\n", input);
+		return 1;
+	}
+
+	return (int)packTable(name, input, format, maxError, samples, length, "");
+}
+
+static uint8_t* readFile(const char* path, long* size) {
+	// Reads a whole file into memory (zero terminated), exits on failure
+	FILE* file = fopen(path, "rb");
+	if (file == 0) {
+		perror(path);
+		exit(1);
+	}
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t* data = malloc(*size + 1);
+	*size = (long)fread(data, 1, *size, file);
+	data[*size] = 0;
+	fclose(file);
+	return data;
+}
+
+static uint32_t importCSV(const char* path, double* values) {
+	// Reads comma/whitespace separated values, returns the number of values
+	long size;
+	char* text = (char*)readFile(path, &size);
+	uint32_t count = 0;
+	char* position = text;
+	while (*position) {
+		char* next = position;
+		double value = 0;
+		if (((*position >= '0') && (*position <= '9')) || (*position == '-') || (*position == '+') || (*position == '.')) {
+			value = strtod(position, &next);
+		}
+		if (next == position) {
+			position++; // Separator or text, skip
+			continue;
+		}
+		if (count == MAX_SAMPLES) {
+			fprintf(stderr, "%s: more than %d values\n", path, MAX_SAMPLES);
+			exit(1);
+		}
+		values[count++] = value;
+		position = next;
+	}
+	free(text);
+	return count;
+}
+
+static uint32_t importWAV(const char* path, double* values) {
+	// Reads the first channel of an 8 bit (unsigned) or 16 bit (signed) PCM WAV file, returns the number of samples
+	long size;
+	uint8_t* data = readFile(path, &size);
+	if ((size < 12) || memcmp(data, "RIFF", 4) || memcmp(data + 8, "WAVE", 4)) {
+		fprintf(stderr, "%s: not a WAV file\n", path);
+		exit(1);
+	}
+	uint16_t channels = 0;
+	uint16_t bits = 0;
+	uint32_t count = 0;
+	long position = 12;
+	while (position + 8 <= size) {
+		// Walk the chunks: fmt describes the samples, data holds them
+		uint32_t chunkSize = (uint32_t)(data[position + 4] | (data[position + 5] << 8) | (data[position + 6] << 16) | ((uint32_t)data[position + 7] << 24));
+		uint8_t* chunk = data + position + 8;
+		if (chunkSize > (uint32_t)(size - position - 8)) {
+			chunkSize = (uint32_t)(size - position - 8); // Truncated file
+		}
+		if (!memcmp(data + position, "fmt ", 4) && (chunkSize >= 16)) {
+			if ((chunk[0] | (chunk[1] << 8)) != 1) {
+				fprintf(stderr, "%s: only PCM WAV files are supported\n", path);
+				exit(1);
+			}
+			channels = (uint16_t)(chunk[2] | (chunk[3] << 8));
+			bits = (uint16_t)(chunk[14] | (chunk[15] << 8));
+		}
+		else if (!memcmp(data + position, "data", 4) && channels && ((bits == 8) || (bits == 16))) {
+			uint32_t frameSize = channels * (bits / 8);
+			for (uint32_t offset = 0; (offset + frameSize <= chunkSize) && (count < MAX_SAMPLES); offset += frameSize) {
+				if (bits == 8) {
+					values[count++] = ((double)chunk[offset] - 128.0) / 128.0;
+				}
+				else {
+					values[count++] = (double)(int16_t)(chunk[offset] | (chunk[offset + 1] << 8)) / 32768.0;
+				}
+			}
+		}
+		position += 8 + chunkSize + (chunkSize & 1); // Chunks are padded to even sizes
+	}
+	free(data);
+	if ((bits != 8) && (bits != 16)) {
+		fprintf(stderr, "%s: only 8 and 16 bit WAV files are supported\n", path);
+		exit(1);
+	}
+	return count;
+}
+
+static void normalise(double* values, uint32_t count) {
+	// Scales values so they span 0.0 to 1.0
+	double minimum = values[0];
+	double maximum = values[0];
+	for (uint32_t i = 1; i < count; i++) {
+		minimum = (values[i] < minimum) ? values[i] : minimum;
+		maximum = (values[i] > maximum) ? values[i] : maximum;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		values[i] = (maximum > minimum) ? ((values[i] - minimum) / (maximum - minimum)) : 0.5;
+	}
+}
+
+static void resample(double* values, uint32_t count, uint32_t length) {
+	// Linearly resamples one period of count values to length values (in place)
+	double* original = malloc(count * sizeof(double));
+	memcpy(original, values, count * sizeof(double));
+	for (uint32_t i = 0; i < length; i++) {
+		double position = ((double)i * count) / length;
+		uint32_t index = (uint32_t)position;
+		double fraction = position - index;
+		values[i] = (original[index] * (1.0 - fraction)) + (original[(index + 1) % count] * fraction); // Periodic: the last sample leads back to the first
+	}
+	free(original);
+}
+
+static void bestTimer(double rate, uint32_t clock, uint32_t* prescaler, uint32_t* reload) {
+	// Finds the prescaler/auto-reload pair with the closest update rate (searching every prescaler, unlike the firmware's timerCalculateRate)
+	double bestError = -1;
+	for (uint32_t psc = 0; psc <= 0xFFFF; psc++) {
+		double divider = (double)clock / (rate * (psc + 1));
+		uint32_t arr = (uint32_t)llround(divider);
+		if (arr < 2) {
+			arr = 2; // An auto-reload value of 0 never produces an update
+		}
+		if (arr > 0x10000) {
+			continue; // Prescaler too small for this rate
+		}
+		double error = fabs(((double)clock / ((double)(psc + 1) * arr)) - rate);
+		if ((bestError < 0) || (error < bestError)) {
+			bestError = error;
+			*prescaler = psc;
+			*reload = arr - 1;
+		}
+		if (error == 0) {
+			break; // Exact, the smallest prescaler keeps the most resolution
+		}
+	}
+}
+
+static int gen(int argc, char** argv) {
+	// Generates a waveform header in a DAC_MODE_* format
+	const char* wave = 0;
+	const char* input = 0;
+	const char* name = 0;
+	uint32_t length = 0;
+	uint32_t bits = 12;
+	uint8_t leftAlign = 0;
+	double duty = 50;
+	double frequency = 0;
+	uint32_t clock = TIMER_CLOCK_FREQUENCY;
+	int packed = -1;
+	char command[1024] = "wavegen gen";
+
+	for (int i = 0; i < argc; i++) {
+		if ((strlen(command) + strlen(argv[i]) + 2) < sizeof(command)) {
+			strcat(command, " ");
+			strcat(command, argv[i]); // Record how the table was produced
+		}
+	}
+	for (int i = 0; i < argc; i++) {
+		if ((argv[i][0] != '-') || (i + 1 >= argc)) {
+			usage();
+		}
+		const char* value = argv[++i];
+		switch (argv[i - 1][1]) {
+			case 'w': wave = value; break;
+			case 'i': input = value; break;
+			case 'n': name = value; break;
+			case 'l': length = (uint32_t)strtoul(value, 0, 0); break;
+			case 'b': bits = (uint32_t)strtoul(value, 0, 0); break;
+			case 'a': leftAlign = !strcmp(value, "left"); break;
+			case 'd': duty = strtod(value, 0); break;
+			case 'f': frequency = strtod(value, 0); break;
+			case 'c': clock = (uint32_t)strtoul(value, 0, 0); break;
+			case 'p': packed = !strcmp(value, "quarter") ? PACKED_QUARTERWAVE : (!strcmp(value, "delta") ? PACKED_DELTA : PACKED_AUTO); break;
+			default: usage();
+		}
+	}
+	if ((wave == 0) || (name == 0) || ((bits != 8) && (bits != 12)) || (length > MAX_SAMPLES)) {
+		usage();
+	}
+	if (leftAlign && (bits == 8)) {
+		fprintf(stderr, "warning: 8 bit data is always right aligned\n");
+		leftAlign = 0;
+	}
+
+	uint32_t count;
+	if (!strcmp(wave, "csv") || !strcmp(wave, "wav")) {
+		if (input == 0) {
+			usage();
+		}
+		count = !strcmp(wave, "csv") ? importCSV(input, shape) : importWAV(input, shape);
+		if (count == 0) {
+			fprintf(stderr, "%s: no samples\n", input);
+			return 1;
+		}
+		normalise(shape, count);
+		if (length && (length != count)) {
+			resample(shape, count, length);
+			count = length;
+		}
+	}
+	else {
+		count = length ? length : DEFAULT_LENGTH;
+		for (uint32_t i = 0; i < count; i++) {
+			double phase = (double)i / count;
+			if (!strcmp(wave, "sine")) {
+				shape[i] = 0.5 + (0.5 * sin(2 * PI * phase));
+			}
+			else if (!strcmp(wave, "square")) {
+				shape[i] = (phase < (duty / 100)) ? 1.0 : 0.0;
+			}
+			else if (!strcmp(wave, "saw")) {
+				shape[i] = (double)i / (count - 1 ? count - 1 : 1);
+			}
+			else if (!strcmp(wave, "triangle")) {
+				shape[i] = (phase < 0.5) ? (2 * phase) : (2 - (2 * phase));
+			}
+			else {
+				usage();
+			}
+		}
+	}
+
+	// Quantise to the DAC data holding register format
+	uint32_t fullScale = (bits == 8) ? 0xFF : 0xFFF;
+	for (uint32_t i = 0; i < count; i++) {
+		long code = lround(shape[i] * fullScale);
+		code = (code < 0) ? 0 : ((code > (long)fullScale) ? (long)fullScale : code);
+		samples[i] = (uint16_t)(leftAlign ? (code << 4) : code);
+	}
+
+	// Mode and timing definitions
+	char defines[1024];
+	int used = snprintf(defines, sizeof(defines), "#define %s_MODE (%s | %s)\n", name, ((bits == 8) ? "DAC_MODE_8BIT" : "DAC_MODE_12BIT"), (leftAlign ? "DAC_MODE_LEFTALIGN" : "DAC_MODE_RIGHTALIGN"));
+	if (frequency > 0) {
+		double rate = frequency * count;
+		uint32_t prescaler = 0;
+		uint32_t reload = 0;
+		bestTimer(rate, clock, &prescaler, &reload);
+		double achieved = ((double)clock / ((double)(prescaler + 1) * (reload + 1))) / count;
+		long period = lround(1000000.0 / rate);
+		used += snprintf(defines + used, sizeof(defines) - used, "\n// Timing for %g Hz output with a %u Hz timer clock\n", frequency, clock);
+		used += snprintf(defines + used, sizeof(defines) - used, "#define %s_SAMPLE_RATE %ld // Hz, for dacDMATriggeredWaveGen/dacStreamStart/startRateTimer\n", name, lround(rate));
+		used += snprintf(defines + used, sizeof(defines) - used, "#define %s_PRESCALER %u // init_timer prescaler\n", name, prescaler);
+		used += snprintf(defines + used, sizeof(defines) - used, "#define %s_ARR %u // startRepeatingTimer ticks (%.4f Hz output, %+.1f ppm)\n", name, reload, achieved, 1e6 * (achieved - frequency) / frequency);
+		if ((period >= 1) && (period <= 0xFFFF)) {
+			used += snprintf(defines + used, sizeof(defines) - used, "#define %s_PERIOD %ld // dacDMAWaveGen period in uS (%.4f Hz output)\n", name, period, 1000000.0 / ((double)period * count));
+		}
+		else {
+			used += snprintf(defines + used, sizeof(defines) - used, "// Sample period is outside the 1 to 65535 uS range of dacDMAWaveGen\n");
+		}
+	}
+
+	if (packed >= 0) {
+		return (int)packTable(name, command, (uint8_t)packed, 0, samples, count, defines);
+	}
+
+	printf("#pragma once\n");
+	printf("// A generated %u-sample %s waveform (%u bit%s)\n", count, wave, bits, (leftAlign ? " left aligned" : ""));
+	printf("// Generated by tools/wavegen.c: %s\n\n", command);
+	writePreamble();
+	printf("#define %s_LENGTH %u\n", name, count);
+	printf("%s\n", defines);
+	printf("const uint16_t %s[] = {", name);
+	for (uint32_t i = 0; i < count; i++) {
+		printf("%s%s0x%03x", (i ? "," : ""), ((i % 16) ? " " : "\n\t"), samples[i]);
+	}
+	printf(" };\n");
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	// Dispatches the tool's commands
+	if ((argc >= 2) && !strcmp(argv[1], "pack")) {
+		return pack(argc - 2, argv + 2);
+	}
+	if ((argc >= 2) && !strcmp(argv[1], "gen")) {
+		return gen(argc - 2, argv + 2);
+	}
+	usage();
+	return 1;
+}
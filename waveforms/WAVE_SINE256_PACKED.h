@@ -0,0 +1,19 @@
+#pragma once
+// WAVE_SINE256 packed as a quarter wave (65 of 256 samples, max error 1 LSB)
+// Generated by tools/wavegen.c from waveforms/WAVE_SINE256.h
+
+#ifndef STDINT_H
+#include <stdint.h>
+#define STDINT_H
+#endif
+
+#define WAVE_SINE256_PACKED_LENGTH 256
+
+const uint16_t WAVE_SINE256_PACKED_DATA[] = {
+	0x7ff, 0x831, 0x863, 0x895, 0x8c7, 0x8f9, 0x92b, 0x95c, 0x98e, 0x9bf, 0x9f0, 0xa20, 0xa51, 0xa81, 0xab0, 0xadf,
+	0xb0e, 0xb3c, 0xb6a, 0xb97, 0xbc3, 0xbef, 0xc1b, 0xc46, 0xc70, 0xc99, 0xcc2, 0xcea, 0xd11, 0xd38, 0xd5d, 0xd82,
+	0xda6, 0xdc9, 0xdeb, 0xe0d, 0xe2d, 0xe4c, 0xe6b, 0xe88, 0xea5, 0xec0, 0xeda, 0xef4, 0xf0c, 0xf23, 0xf39, 0xf4e,
+	0xf62, 0xf74, 0xf86, 0xf96, 0xfa5, 0xfb3, 0xfc0, 0xfcc, 0xfd6, 0xfdf, 0xfe7, 0xfee, 0xff4, 0xff8, 0xffb, 0xffd,
+	0xffe };
+
+#define WAVE_SINE256_PACKED { DAC_PACKED_QUARTERWAVE, 256, 0xffe, WAVE_SINE256_PACKED_DATA } // DACPackedWave_TypeDef initialiser
@@ -0,0 +1,41 @@
+#pragma once
+// WAVE_TABLE_MOUNTAIN packed as delta/run length tokens (430 bytes for 778 samples)
+// Generated by tools/wavegen.c from waveforms/WAVE_TABLE_MOUNTAIN.h
+
+#ifndef STDINT_H
+#include <stdint.h>
+#define STDINT_H
+#endif
+
+#define WAVE_TABLE_MOUNTAIN_PACKED_LENGTH 778
+
+const uint8_t WAVE_TABLE_MOUNTAIN_PACKED_DATA[] = {
+	0xc0, 0x00, 0x00, 0xbf, 0xbf, 0xbf, 0x86, 0x10, 0xc0, 0x60, 0x00, 0x80, 0xc0, 0xb0, 0x00, 0x80,
+	0xc0, 0x01, 0x01, 0x81, 0xc0, 0x51, 0x01, 0x08, 0x21, 0x18, 0x38, 0x70, 0x80, 0x28, 0x08, 0x28,
+	0x19, 0x28, 0xc0, 0x9b, 0x02, 0x39, 0x10, 0x30, 0x20, 0x80, 0x10, 0x28, 0x29, 0x10, 0x10, 0x30,
+	0x28, 0x18, 0x19, 0x20, 0x08, 0xc0, 0xae, 0x04, 0xc0, 0xef, 0x04, 0x18, 0x38, 0x38, 0x21, 0x30,
+	0x18, 0x10, 0x20, 0x20, 0x08, 0xc0, 0x79, 0x06, 0xc0, 0xb9, 0x06, 0xc0, 0x2a, 0x07, 0xc0, 0xe3,
+	0x07, 0xc0, 0x6c, 0x08, 0xc0, 0xec, 0x08, 0xc0, 0x4d, 0x09, 0xc0, 0x9d, 0x09, 0xc0, 0xe6, 0x09,
+	0x28, 0xc0, 0x4e, 0x0a, 0x08, 0x19, 0x10, 0x10, 0x18, 0x08, 0x38, 0xc0, 0x30, 0x0b, 0xc0, 0x78,
+	0x0b, 0xc0, 0xd9, 0x0b, 0xc0, 0x29, 0x0c, 0x28, 0x28, 0x19, 0x18, 0x18, 0x10, 0x60, 0x78, 0x28,
+	0xc0, 0x8b, 0x0d, 0xc0, 0x44, 0x0e, 0xc0, 0xb5, 0x0e, 0xc0, 0x45, 0x0f, 0xc0, 0xb6, 0x0f, 0xc0,
+	0xff, 0x0f, 0x67, 0x70, 0x10, 0x80, 0x78, 0x40, 0x78, 0x40, 0x67, 0x70, 0x40, 0x80, 0x50, 0x70,
+	0x80, 0xc0, 0x5c, 0x0e, 0xc0, 0x04, 0x0e, 0xc0, 0x8b, 0x0d, 0xc0, 0x2a, 0x0d, 0x60, 0x80, 0x70,
+	0x80, 0x78, 0x70, 0x68, 0x80, 0x68, 0x4f, 0x68, 0x40, 0xc0, 0xd9, 0x0b, 0x77, 0xc0, 0x71, 0x0c,
+	0xc0, 0x12, 0x0d, 0xc0, 0xd3, 0x0d, 0xc0, 0xe5, 0x0e, 0xc0, 0x4e, 0x0f, 0x18, 0x10, 0x86, 0x08,
+	0x20, 0x87, 0x68, 0x8f, 0x18, 0x8e, 0x60, 0x20, 0xb5, 0xc0, 0xc5, 0x0e, 0xc0, 0xbb, 0x0d, 0x48,
+	0xc0, 0x1a, 0x0d, 0x08, 0x08, 0x80, 0x50, 0x48, 0x68, 0x4f, 0x11, 0x47, 0xc0, 0xf1, 0x0b, 0x68,
+	0x77, 0x09, 0xc0, 0x88, 0x0b, 0x68, 0xc0, 0x46, 0x0a, 0xc0, 0x3d, 0x09, 0xc0, 0xc4, 0x08, 0xc0,
+	0x7c, 0x08, 0x80, 0x10, 0x70, 0x68, 0x81, 0x47, 0x10, 0x21, 0x08, 0x08, 0x10, 0x80, 0x47, 0x29,
+	0x20, 0x28, 0x80, 0x10, 0x81, 0x08, 0x68, 0x70, 0x40, 0xc0, 0x23, 0x08, 0x70, 0xc0, 0xc3, 0x07,
+	0xc0, 0xe9, 0x06, 0x40, 0x58, 0x18, 0x68, 0x18, 0x80, 0x20, 0x18, 0x80, 0x18, 0x80, 0x21, 0x18,
+	0x80, 0x68, 0x70, 0xc0, 0x99, 0x06, 0x80, 0x10, 0x68, 0x70, 0x68, 0x47, 0x81, 0x70, 0x70, 0x20,
+	0xc0, 0x81, 0x06, 0xc0, 0xd1, 0x06, 0xc0, 0x22, 0x07, 0xc0, 0xc3, 0x07, 0xc0, 0x13, 0x08, 0xc0,
+	0xa4, 0x08, 0x18, 0xc0, 0x15, 0x09, 0xc0, 0x5d, 0x09, 0xc0, 0xbe, 0x09, 0x38, 0x10, 0x70, 0xc0,
+	0x7d, 0x09, 0xc0, 0xf4, 0x08, 0xc0, 0x3b, 0x08, 0xc0, 0xc3, 0x07, 0xc0, 0x5a, 0x07, 0xc0, 0xf1,
+	0x06, 0x40, 0x58, 0x50, 0x5f, 0x40, 0x78, 0xc0, 0x98, 0x05, 0x77, 0x40, 0x70, 0x68, 0x58, 0x70,
+	0xc0, 0x9e, 0x04, 0xc0, 0x4e, 0x04, 0x78, 0x70, 0x47, 0x40, 0x70, 0x58, 0x57, 0x81, 0x50, 0xc0,
+	0xbb, 0x02, 0xc0, 0x33, 0x02, 0xc0, 0xca, 0x01, 0x80, 0x58, 0x68, 0x70, 0x57, 0x58, 0x58, 0x58,
+	0x70, 0x80, 0x67, 0x68, 0x70, 0x82, 0x58, 0x58, 0x80, 0x48, 0xbf, 0xbf, 0xbf, 0x86 };
+
+#define WAVE_TABLE_MOUNTAIN_PACKED { DAC_PACKED_DELTA, 778, 0, WAVE_TABLE_MOUNTAIN_PACKED_DATA } // DACPackedWave_TypeDef initialiser